@@ -0,0 +1,227 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConBenchmark.h"
+
+#include "JoyConController.h"
+#include "JoyConReportLog.h"
+#include "JoyConSimulatedDevice.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static constexpr int32 ReportLen = 49;
+
+// Keeps the optimizer from discarding the benchmarked work
+static volatile float BenchmarkSink = 0.0f;
+
+/** Times Body over the whole corpus, Body returns the number of operations it performed */
+template<typename FunctionType>
+static FJoyConBenchmarkResult Measure(const TCHAR* Name, const int32 Iterations, FunctionType&& Body) {
+	// Warm up caches and branch predictors before measuring
+	int64 Operations = Body();
+	double BestSeconds = TNumericLimits<double>::Max();
+	for (int32 i = 0; i < Iterations; ++i) {
+		const uint64 Start = FPlatformTime::Cycles64();
+		Operations = Body();
+		const double Seconds = (FPlatformTime::Cycles64() - Start) * FPlatformTime::GetSecondsPerCycle64();
+		BestSeconds = FMath::Min(BestSeconds, Seconds);
+	}
+
+	FJoyConBenchmarkResult Result;
+	Result.Name = Name;
+	Result.Operations = Operations;
+	Result.NsPerOperation = Operations > 0 ? BestSeconds * 1e9 / Operations : 0.0;
+	Result.OperationsPerSecond = BestSeconds > 0.0 ? Operations / BestSeconds : 0.0;
+	return Result;
+}
+
+bool FJoyConBenchmark::Run(const FJoyConBenchmarkSettings& Settings, FOutputDevice& Ar) {
+	TArray<uint8> Corpus;
+	bool bIsLeft = true;
+	if (!LoadCorpus(Settings, Corpus, bIsLeft)) {
+		Ar.Logf(TEXT("Failed to load the JoyCon benchmark corpus %s."), *Settings.CorpusFilename);
+		return false;
+	}
+	const int32 NumReports = Corpus.Num() / ReportLen;
+	const int32 Iterations = FMath::Max(1, Settings.Iterations);
+
+	// The device is never read, it only satisfies the controller's constructor
+	FJoyConSimulatedDeviceSettings DeviceSettings;
+	DeviceSettings.bIsLeft = bIsLeft;
+	FJoyConController Controller(FJoyConInformation(), new FJoyConSimulatedDevice(DeviceSettings), true, true, 0.05f, bIsLeft);
+	Controller.State = EJoyConState::Imu_Data_OK;
+	Controller.bStopPolling = false;
+	// The basis filter keeps ProcessImu and GetVector comparable with earlier runs, the quaternion filter has its own rows
+	Controller.Imu.SetFilterType(JoyCon::OrientationFilterType::Basis);
+	Controller.Imu.SetFilterGain(0.05f);
+	JoyCon::StickCalibration& StickCalibration = Controller.Calibration.Stick;
+	StickCalibration.DeadZone = 0xae;
+	for (int32 i = 0; i < 2; ++i) {
+		StickCalibration.Max[i] = 0x5a0;
+		StickCalibration.Center[i] = 0x800;
+		StickCalibration.Min[i] = 0x5a0;
+	}
+
+	// Raw stick values for CenterSticks, decoded once up front
+	TArray<uint16> StickValues;
+	StickValues.SetNumUninitialized(NumReports * 2);
+	for (int32 i = 0; i < NumReports; ++i) {
+		JoyCon::DecodeStick(&Corpus[i * ReportLen], bIsLeft, &StickValues[i * 2]);
+	}
+
+	TArray<FJoyConBenchmarkResult> Results;
+	Results.Add(Measure(TEXT("ProcessButtonsAndStick"), Iterations, [&]() {
+		for (int32 i = 0; i < NumReports; ++i) {
+			Controller.ProcessButtonsAndStick(&Corpus[i * ReportLen]);
+		}
+		BenchmarkSink = BenchmarkSink + Controller.Input.Stick[0];
+		return static_cast<int64>(NumReports);
+	}));
+	Results.Add(Measure(TEXT("ExtractImuValues"), Iterations, [&]() {
+		for (int32 i = 0; i < NumReports; ++i) {
+			for (int32 n = 0; n < 3; ++n) {
+				Controller.Imu.ExtractSample(&Corpus[i * ReportLen], n, Controller.Calibration.Imu);
+			}
+		}
+		BenchmarkSink = BenchmarkSink + Controller.GetGyroscope().X;
+		return static_cast<int64>(NumReports);
+	}));
+	Results.Add(Measure(TEXT("ProcessImu"), Iterations, [&]() {
+		JoyCon::TimedImuSample Samples[JoyCon::ImuSamplesPerReport];
+		for (int32 i = 0; i < NumReports; ++i) {
+			Controller.ProcessImu(&Corpus[i * ReportLen], -1.0, Samples);
+		}
+		BenchmarkSink = BenchmarkSink + Controller.Imu.Filter.K.Z;
+		return static_cast<int64>(NumReports);
+	}));
+	JoyCon::ImuProcessor QuaternionImu;
+	QuaternionImu.SetFilterGain(0.1f);
+	Results.Add(Measure(TEXT("ProcessImuMadgwick"), Iterations, [&]() {
+		for (int32 i = 0; i < NumReports; ++i) {
+			QuaternionImu.ProcessReport(&Corpus[i * ReportLen], Controller.Calibration.Imu);
+		}
+		BenchmarkSink = BenchmarkSink + QuaternionImu.GetOrientation().W;
+		return static_cast<int64>(NumReports);
+	}));
+	Results.Add(Measure(TEXT("CenterSticks"), Iterations, [&]() {
+		for (int32 i = 0; i < NumReports; ++i) {
+			JoyCon::CenterStick(&StickValues[i * 2], StickCalibration, Controller.Input.Stick);
+		}
+		BenchmarkSink = BenchmarkSink + Controller.Input.Stick[1];
+		return static_cast<int64>(NumReports);
+	}));
+	Results.Add(Measure(TEXT("CalculateRumbleData"), Iterations, [&]() {
+		FRumble Rumble;
+		for (int32 i = 0; i < NumReports; ++i) {
+			// Sweep the amplitude so every branch of the encoder is exercised
+			Rumble.SetValues(160.0f + (i & 0xff), 320.0f + (i & 0x1ff), (i & 0x3f) / 63.0f, 0);
+			Rumble.CalculateRumbleData();
+			BenchmarkSink = BenchmarkSink + Rumble.RumbleData[3];
+		}
+		return static_cast<int64>(NumReports);
+	}));
+	Results.Add(Measure(TEXT("GetVector"), Iterations, [&]() {
+		for (int32 i = 0; i < NumReports; ++i) {
+			// Perturb the orientation basis so each call takes real input
+			Controller.Imu.Filter.I.X = 1.0f - (i & 0xf) * 0.01f;
+			BenchmarkSink = BenchmarkSink + Controller.GetVector().Yaw;
+		}
+		return static_cast<int64>(NumReports);
+	}));
+	Results.Add(Measure(TEXT("GetVectorMadgwick"), Iterations, [&]() {
+		for (int32 i = 0; i < NumReports; ++i) {
+			const JoyCon::Quaternion Orientation = QuaternionImu.GetOrientation();
+			BenchmarkSink = BenchmarkSink + FRotator(FQuat(Orientation.X, Orientation.Y, Orientation.Z, Orientation.W)).Yaw;
+		}
+		return static_cast<int64>(NumReports);
+	}));
+
+	for (const FJoyConBenchmarkResult& Result : Results) {
+		Ar.Logf(TEXT("%-24s %10.1f ns/report %14.0f reports/s"), *Result.Name, Result.NsPerOperation, Result.OperationsPerSecond);
+	}
+
+	const FString OutputFilename = Settings.OutputFilename.IsEmpty()
+		? FPaths::ProjectSavedDir() / TEXT("JoyConBenchmark") / FDateTime::Now().ToString() + TEXT(".json")
+		: Settings.OutputFilename;
+	if (!FFileHelper::SaveStringToFile(ToJson(Settings, NumReports, Results), *OutputFilename)) {
+		Ar.Logf(TEXT("Failed to write JoyCon benchmark results to %s."), *OutputFilename);
+		return false;
+	}
+	Ar.Logf(TEXT("JoyCon benchmark results written to %s."), *OutputFilename);
+	return true;
+}
+
+bool FJoyConBenchmark::LoadCorpus(const FJoyConBenchmarkSettings& Settings, TArray<uint8>& OutReports, bool& bOutIsLeft) {
+	if (Settings.CorpusFilename.IsEmpty()) {
+		BuildSyntheticCorpus(FMath::Max(1, Settings.NumReports), Settings.RandomSeed, OutReports);
+		bOutIsLeft = true;
+		return true;
+	}
+	const TUniquePtr<FJoyConReportLog> Log = FJoyConReportLog::Open(Settings.CorpusFilename);
+	if (!Log.IsValid()) return false;
+	bOutIsLeft = Log->IsLeft();
+	for (int32 i = 0; i < Log->Num(); ++i) {
+		const FJoyConReportLogRecord& Record = (*Log)[i];
+		if (Record.Data[0] != 0x30) continue;
+		OutReports.Append(Record.Data, ReportLen);
+	}
+	return OutReports.Num() > 0;
+}
+
+void FJoyConBenchmark::BuildSyntheticCorpus(const int32 NumReports, const int32 RandomSeed, TArray<uint8>& OutReports) {
+	FRandomStream Random(RandomSeed);
+	OutReports.SetNumZeroed(NumReports * ReportLen);
+	for (int32 i = 0; i < NumReports; ++i) {
+		uint8* Report = &OutReports[i * ReportLen];
+		Report[0] = 0x30;
+		// Three IMU samples per report, the device timer advances by three 5 ms ticks
+		Report[1] = static_cast<uint8>(i * 3);
+		Report[2] = 0x8e;
+		for (int32 j = 3; j < 6; ++j) {
+			Report[j] = static_cast<uint8>(Random.RandRange(0, 255));
+		}
+		for (int32 j = 6; j < 12; j += 3) {
+			const uint16 X = static_cast<uint16>(Random.RandRange(0x200, 0xe00));
+			const uint16 Y = static_cast<uint16>(Random.RandRange(0x200, 0xe00));
+			Report[j] = static_cast<uint8>(X & 0xff);
+			Report[j + 1] = static_cast<uint8>(((X >> 8) & 0xf) | ((Y & 0xf) << 4));
+			Report[j + 2] = static_cast<uint8>(Y >> 4);
+		}
+		for (int32 n = 0; n < 3; ++n) {
+			uint8* Sample = &Report[13 + n * 12];
+			// Accelerometer near 1 g on Z, gyroscope noise around zero
+			const int16 Values[6] = {
+				static_cast<int16>(Random.RandRange(-400, 400)),
+				static_cast<int16>(Random.RandRange(-400, 400)),
+				static_cast<int16>(4096 + Random.RandRange(-400, 400)),
+				static_cast<int16>(Random.RandRange(-2000, 2000)),
+				static_cast<int16>(Random.RandRange(-2000, 2000)),
+				static_cast<int16>(Random.RandRange(-2000, 2000))
+			};
+			for (int32 k = 0; k < 6; ++k) {
+				Sample[k * 2] = static_cast<uint8>(Values[k] & 0xff);
+				Sample[k * 2 + 1] = static_cast<uint8>((Values[k] >> 8) & 0xff);
+			}
+		}
+	}
+}
+
+FString FJoyConBenchmark::ToJson(const FJoyConBenchmarkSettings& Settings, const int32 NumReports, const TArray<FJoyConBenchmarkResult>& Results) {
+	FString Json = TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"timestamp\": \"%s\",\n"), *FDateTime::UtcNow().ToIso8601());
+	Json += FString::Printf(TEXT("\t\"platform\": \"%s\",\n"), ANSI_TO_TCHAR(FPlatformProperties::IniPlatformName()));
+	Json += FString::Printf(TEXT("\t\"corpus\": \"%s\",\n"), Settings.CorpusFilename.IsEmpty() ? TEXT("synthetic") : *Settings.CorpusFilename.ReplaceCharWithEscapedChar());
+	Json += FString::Printf(TEXT("\t\"reports\": %d,\n"), NumReports);
+	Json += FString::Printf(TEXT("\t\"iterations\": %d,\n"), Settings.Iterations);
+	Json += TEXT("\t\"benchmarks\": [\n");
+	for (int32 i = 0; i < Results.Num(); ++i) {
+		const FJoyConBenchmarkResult& Result = Results[i];
+		Json += FString::Printf(TEXT("\t\t{ \"name\": \"%s\", \"operations\": %lld, \"ns_per_report\": %.3f, \"reports_per_second_per_core\": %.1f }%s\n"),
+			*Result.Name, Result.Operations, Result.NsPerOperation, Result.OperationsPerSecond, i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+	}
+	Json += TEXT("\t]\n}\n");
+	return Json;
+}
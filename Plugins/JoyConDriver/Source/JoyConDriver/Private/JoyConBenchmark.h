@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FJoyConBenchmarkSettings {
+	/** Report log to use as the corpus, a synthetic corpus is generated when empty */
+	FString CorpusFilename;
+
+	/** Size of the synthetic corpus */
+	int32 NumReports;
+
+	/** Each benchmark runs over the whole corpus this many times, the fastest pass is reported */
+	int32 Iterations;
+
+	int32 RandomSeed;
+
+	/** Where the JSON results are written, defaults to Saved/JoyConBenchmark/<date>.json */
+	FString OutputFilename;
+
+	FJoyConBenchmarkSettings() :
+		NumReports(20000),
+		Iterations(5),
+		RandomSeed(0) {
+	}
+};
+
+struct FJoyConBenchmarkResult {
+	FString Name;
+	int64 Operations;
+	double NsPerOperation;
+	double OperationsPerSecond;
+};
+
+/**
+ * Micro-benchmarks for the report decode and IMU fusion hot paths of FJoyConController. Every benchmark runs
+ * single-threaded over a corpus of 49 byte reports and measures time. Heap allocations are counted by the standalone
+ * JoyConCoreBench, which can replace operator new without touching the engine's allocator.
+ */
+class FJoyConBenchmark {
+
+public:
+	static bool Run(const FJoyConBenchmarkSettings& Settings, FOutputDevice& Ar);
+
+private:
+	static bool LoadCorpus(const FJoyConBenchmarkSettings& Settings, TArray<uint8>& OutReports, bool& bOutIsLeft);
+	static void BuildSyntheticCorpus(int32 NumReports, int32 RandomSeed, TArray<uint8>& OutReports);
+	static FString ToJson(const FJoyConBenchmarkSettings& Settings, int32 NumReports, const TArray<FJoyConBenchmarkResult>& Results);
+};
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConCalibrationCache.h"
+
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/BufferArchive.h"
+#include "Serialization/MemoryReader.h"
+
+// Guards against reading garbage as an entry count
+static constexpr int32 MaxCachedControllers = 1024;
+
+static void SerializeCalibration(FArchive& Ar, JoyCon::Calibration& Calibration) {
+	for (int32 i = 0; i < 2; ++i) {
+		Ar << Calibration.Stick.Max[i];
+		Ar << Calibration.Stick.Center[i];
+		Ar << Calibration.Stick.Min[i];
+	}
+	Ar << Calibration.Stick.DeadZone;
+	for (int32 i = 0; i < 3; ++i) {
+		Ar << Calibration.GyroNeutral[i];
+		Ar << Calibration.AccelNeutral[i];
+		Ar << Calibration.GyroSensitivity[i];
+		Ar << Calibration.AccelSensitivity[i];
+	}
+	Ar << Calibration.bUserStickCalibration;
+	Ar << Calibration.bUserGyroCalibration;
+	if (Ar.IsLoading()) JoyCon::ComputeImuConversion(Calibration);
+}
+
+FJoyConCalibrationCache::FJoyConCalibrationCache(const FString& InFilename) : Filename(InFilename) {
+}
+
+FString FJoyConCalibrationCache::GetDefaultFilename() {
+	return FPaths::ProjectSavedDir() / TEXT("JoyConDriver") / TEXT("CalibrationCache.bin");
+}
+
+void FJoyConCalibrationCache::Load() {
+	Entries.Reset();
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Filename, FILEREAD_Silent)) return;
+	FMemoryReader Reader(Data);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int32 Count = 0;
+	Reader << Magic;
+	Reader << Version;
+	Reader << Count;
+	if (Reader.IsError() || Magic != MagicValue || Version != CurrentVersion || Count < 0 || Count > MaxCachedControllers) {
+		UE_LOG(LogTemp, Display, TEXT("Ignoring JoyCon calibration cache %s, it was written by another version."), *Filename);
+		return;
+	}
+	for (int32 i = 0; i < Count; ++i) {
+		FString SerialNumber;
+		FEntry Entry = {};
+		Reader << SerialNumber;
+		Reader << Entry.bIsLeft;
+		SerializeCalibration(Reader, Entry.Calibration);
+		if (Reader.IsError()) {
+			UE_LOG(LogTemp, Warning, TEXT("JoyCon calibration cache %s is truncated."), *Filename);
+			Entries.Reset();
+			return;
+		}
+		Entries.Add(SerialNumber, Entry);
+	}
+	UE_LOG(LogTemp, Display, TEXT("Loaded calibration of %d JoyCons from the cache."), Entries.Num());
+}
+
+bool FJoyConCalibrationCache::Find(const FString& SerialNumber, const bool bIsLeft, JoyCon::Calibration& Out) const {
+	const FEntry* Entry = Entries.Find(SerialNumber);
+	if (Entry == nullptr || Entry->bIsLeft != bIsLeft) return false;
+	Out = Entry->Calibration;
+	return true;
+}
+
+void FJoyConCalibrationCache::Store(const FString& SerialNumber, const bool bIsLeft, const JoyCon::Calibration& Calibration) {
+	if (SerialNumber.IsEmpty()) return;
+	if (const FEntry* Existing = Entries.Find(SerialNumber)) {
+		if (Existing->bIsLeft == bIsLeft && Existing->Calibration == Calibration) return;
+	}
+	FEntry& Entry = Entries.FindOrAdd(SerialNumber);
+	Entry.bIsLeft = bIsLeft;
+	Entry.Calibration = Calibration;
+	if (!Save()) {
+		UE_LOG(LogTemp, Warning, TEXT("Failed to write JoyCon calibration cache %s."), *Filename);
+	}
+}
+
+bool FJoyConCalibrationCache::Save() const {
+	FBufferArchive Writer;
+	uint32 Magic = MagicValue;
+	uint32 Version = CurrentVersion;
+	int32 Count = Entries.Num();
+	Writer << Magic;
+	Writer << Version;
+	Writer << Count;
+	for (const TPair<FString, FEntry>& Pair : Entries) {
+		FString SerialNumber = Pair.Key;
+		FEntry Entry = Pair.Value;
+		Writer << SerialNumber;
+		Writer << Entry.bIsLeft;
+		SerializeCalibration(Writer, Entry.Calibration);
+	}
+	return FFileHelper::SaveArrayToFile(Writer, *Filename);
+}
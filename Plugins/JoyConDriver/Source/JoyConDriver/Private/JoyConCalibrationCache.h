@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JoyConCore/JoyConCalibration.h"
+
+/**
+ * Calibration read from the SPI flash of each controller, persisted by serial number so re-attaching a known
+ * controller skips the flash reads. The cache is a single small file, a file written by another version is ignored.
+ */
+class FJoyConCalibrationCache {
+
+public:
+	explicit FJoyConCalibrationCache(const FString& InFilename);
+
+	/** Saved/JoyConDriver/CalibrationCache.bin */
+	static FString GetDefaultFilename();
+
+	/** Replaces the entries with the file contents, a missing or mismatched file leaves the cache empty */
+	void Load();
+
+	bool Find(const FString& SerialNumber, bool bIsLeft, JoyCon::Calibration& Out) const;
+
+	/** Adds or updates an entry and rewrites the file if anything changed */
+	void Store(const FString& SerialNumber, bool bIsLeft, const JoyCon::Calibration& Calibration);
+
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	struct FEntry {
+		bool bIsLeft;
+		JoyCon::Calibration Calibration;
+	};
+
+	bool Save() const;
+
+	static constexpr uint32 MagicValue = 0x4343434a; // "JCCC"
+	static constexpr uint32 CurrentVersion = 2;
+
+	FString Filename;
+	TMap<FString, FEntry> Entries;
+};
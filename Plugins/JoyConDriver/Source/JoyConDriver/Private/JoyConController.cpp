@@ -2,467 +2,602 @@
 
 
 #include "JoyConController.h"
+#include "CoreGlobals.h"
 #include "Engine/Engine.h"
 //#include "Windows/AllowWindowsPlatformTypes.h"
 //#include <map>
 
 #include "JoyConState.h"
+#include "JoyConCore/JoyConImuKernel.h"
 #include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
 //#include "Windows/HideWindowsPlatformTypes.h"
 
-FJoyConController::FJoyConController(const FJoyConInformation TempJoyConInformation, hid_device* Device, const bool UseImu, const bool UseLocalize, float Alpha, const bool IsLeft) :
-	GlobalCount(0),
-	DeadZone(0),
-	Timestamp(0),
-	TsDequeue(0),
-	TsEnqueue(0),
-	FilterWeight(0),
-	Err(0),
+// A Joy-Con in mode 0x30 sends a report roughly every 15 ms
+static constexpr float NominalReportPeriod = 0.015f;
+// Reads wait about two report periods, so rumble and drop checks still run during a gap
+static constexpr int32 MinReadTimeoutMs = 4;
+static constexpr int32 MaxReadTimeoutMs = 50;
+// Unchanged rumble is only re-sent to recover from lost output reports, more often while the motors run
+static constexpr double ActiveRumbleKeepAlive = 0.1;
+static constexpr double IdleRumbleKeepAlive = 1.0;
+// Orientation prediction never extrapolates further than this past the newest sample
+static constexpr float MaxPredictionSeconds = 0.1f;
+
+static_assert(JoyCon::ButtonCount == static_cast<int32>(EJoyConControllerButton::TotalButtonCount), "JoyCon core buttons must match EJoyConControllerButton");
+
+static FVector ToFVector(const JoyCon::Vector3& Vector) {
+	return FVector(Vector.X, Vector.Y, Vector.Z);
+}
+
+FJoyConController::FJoyConController(const FJoyConInformation TempJoyConInformation, IJoyConDevice* TempDevice, const bool UseImu, const bool UseLocalize, float Alpha, const bool IsLeft) :
+	LastReportTime(0.0),
+	ReportPeriod(NominalReportPeriod),
+	DropTimeout(2.0f),
+	Channel(this, this),
+	Calibration{},
+	Input{},
+	bHasCachedCalibration(false),
+	bCalibrationChanged(false),
+	CachedCalibration{},
+	ValidatedCalibration{},
+	bValidatedCalibrationReady(false),
+	bDetectGestures(false),
+	RumbleObj(160, 320, 0, 0),
+	PublishedRumbleData{},
+	bPublishedRumbleActive(false),
+	bRumbleDirty(false),
+	RumbleData{},
+	bRumbleActive(false),
+	SentRumbleData{},
+	LastRumbleSendTime(0.0),
 	Thread(nullptr),
-    Buttons{},
-    RumbleObj(160, 320, 0, 0) {
-	HidHandle = Device;
+	RecoveryCount(0),
+	LastRecoverySeconds(0.0f),
+	Buttons{} {
+	Device = TempDevice;
 	JoyConInformation = TempJoyConInformation;
 	bIsLeft = IsLeft;
+	Decoders = &JoyCon::GetControllerDecoders(JoyCon::GetJoyConType(bIsLeft));
 	bImuEnabled = UseImu;
 	bDoLocalize = UseLocalize;
 	bStopPolling = true;
 	State = EJoyConState::Not_Attached;
+	PublishRumble();
 }
 
 FJoyConController::~FJoyConController() {
+	StopCapture();
 	delete Thread;
 	Thread = nullptr;
-	if (HidHandle != nullptr) {
-		hid_close(HidHandle);
-	}
+	delete Device;
+	Device = nullptr;
 }
 
-void FJoyConController::Attach(const uint8 Leds) {
-	if (State > EJoyConState::No_JoyCons) return;
+bool FJoyConController::Attach(const uint8 Leds) {
+	if (State > EJoyConState::No_JoyCons) return false;
 	State = EJoyConState::Attached;
+	const double StartTime = FPlatformTime::Seconds();
+	// The channel sends the subcommands one after another and pipelines only the calibration reads, nothing here waits
+	// for a reply before the flush
+
 	// Subcommand 0x03: Set input report mode
     // 0x3f - Simple HID mode. Pushes updates with every button press
-	uint8 a[] = { 0x3f };
-	SendSubCommand(0x3, a, 1);
+	SendSubCommand(JoyCon::SubCommand::SetInputReportMode, JoyCon::ReportId::SimpleInput);
 	
-	DumpCalibrationData();
+	if (!bHasCachedCalibration) DumpCalibrationData();
 	
 	// Subcommand 0x01: Bluetooth manual pairing
 	// Send host MAC and acquire Joy-Con MAC
-	a[0] = 0x01;
-	SendSubCommand(0x1, a, 1);
+	SendSubCommand(JoyCon::SubCommand::BluetoothPairing, 0x01);
 	
 	// Acquire the XORed LTK hash
-	a[0] = 0x02;
-	SendSubCommand(0x1, a, 1);
+	SendSubCommand(JoyCon::SubCommand::BluetoothPairing, 0x02);
 	
 	// Saves pairing info in Joy-Con
-	a[0] = 0x03;
-	SendSubCommand(0x1, a, 1);
+	SendSubCommand(JoyCon::SubCommand::BluetoothPairing, 0x03);
 
 	// Subcommand 0x30: Set player lights
-	a[0] = Leds;
-	SendSubCommand(0x30, a, 1);
+	SendSubCommand(JoyCon::SubCommand::SetPlayerLights, Leds);
 	
 	// Subcommand 0x40: Enable IMU (6-Axis sensor)
-	a[0] = bImuEnabled ? 0x1 : 0x0;
-	SendSubCommand(0x40, a, 1);
+	SendSubCommand(JoyCon::SubCommand::EnableImu, bImuEnabled ? 0x1 : 0x0);
 	
 	// Subcommand 0x03: Set input report mode
     // 0x30 - Standard full mode. Pushes current state @60Hz
-	SendSubCommand(0x3, new uint8[1]{ 0x30 }, 1);
+	const uint8 FullInputMode = JoyCon::ReportId::FullInput;
+	const JoyCon::SubCommandChannel::Ticket FullInputTicket = Channel.Submit(JoyCon::SubCommand::SetInputReportMode, &FullInputMode, 1);
 	
 	// Subcommand 0x48: Enable vibration
-	SendSubCommand(0x48, new uint8[1]{ 0x1 }, 1);
+	SendSubCommand(JoyCon::SubCommand::EnableVibration, 0x1);
+
+	const JoyCon::FlushResult Result = Channel.Flush();
+	const double Elapsed = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	// Individual subcommands may go unanswered on a noisy radio, a controller that answers none is not there
+	if (Result.Posted == 0 || Result.Failed == Result.Posted) {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon %d did not answer the attach handshake after %.1f ms."), JoyConInformation.ControllerId, Elapsed);
+		State = EJoyConState::Not_Attached;
+		return false;
+	}
+	if (Result.Failed > 0) {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon %d did not acknowledge %d of %d attach subcommands."), JoyConInformation.ControllerId, Result.Failed, Result.Posted);
+	}
+	// Without the full report mode the controller keeps sending simple HID reports, which carry no stick or IMU data
+	if (FullInputTicket == 0 || Channel.Wait(FullInputTicket, nullptr) != JoyCon::SubCommandStatus::Succeeded) {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon %d did not switch to the full input report mode after %.1f ms."), JoyConInformation.ControllerId, Elapsed);
+		State = EJoyConState::Not_Attached;
+		return false;
+	}
+	// The cached calibration is used right away and compared with the flash once polling runs
+	if (bHasCachedCalibration) CalibrationValidation.Start(Channel, bIsLeft);
+	UE_LOG(LogTemp, Display, TEXT("JoyCon %d attached in %.1f ms."), JoyConInformation.ControllerId, Elapsed);
+	return true;
 }
 
 void FJoyConController::Update() {
 	if (bStopPolling || State <= EJoyConState::No_JoyCons) return;
-	const auto ReportBuf = new uint8[ReportLen];
-	ReportBuf[0] = 0x00;
-	while (!Reports.IsEmpty()) {
-		Mutex.Lock();
-		FReport Rep;
-		Reports.Dequeue(Rep);
-		Rep.CopyBuffer(ReportBuf);
-		Mutex.Unlock();
+	if (bValidatedCalibrationReady.Exchange(false)) {
+		Calibration = ValidatedCalibration;
+		CachedCalibration = ValidatedCalibration;
+		bCalibrationChanged = true;
+	}
+	FReport Rep;
+	uint8* ReportBuf = Rep.ReportData;
+	bool bReceived = false;
+	while (Reports.Dequeue(Rep)) {
+		bReceived = true;
 		if (bImuEnabled) {
+			// Keep all three samples of the report, not only the one GetAccelerometer() shows
+			JoyCon::TimedImuSample Samples[JoyCon::ImuSamplesPerReport];
 			if (bDoLocalize) {
-				ProcessImu(ReportBuf);
+				BufferImuSamples(Samples, ProcessImu(ReportBuf, Rep.HostSeconds, Samples));
 			} else {
-				ExtractImuValues(ReportBuf, 0);
+				BufferImuSamples(Samples, Imu.DecodeReport(ReportBuf, Calibration.Imu, Samples, Rep.HostSeconds));
 			}
 		}
-		if (TsDequeue == ReportBuf[1]) {
-			UE_LOG(LogTemp, Display, TEXT("Duplicate timestamp dequeued."));
-		}
-		TsDequeue = ReportBuf[1];
-		TsPrevious = Rep.GetTime();
 	}
+	if (bReceived && bImuEnabled) PublishMotion(Rep.HostSeconds);
 	ProcessButtonsAndStick(ReportBuf);
 	if (!RumbleObj.TimedRumble) return;
 	if (RumbleObj.Time < 0) {
 		RumbleObj.SetValues(160, 320, 0, 0);
+		PublishRumble();
 	} else {
 		RumbleObj.Time -= FApp::GetDeltaTime();
 	}
 }
 
 void FJoyConController::Pool() {
+	LastReportTime = FPlatformTime::Seconds();
 	while (!bStopPolling && State > EJoyConState::No_JoyCons) {
-		SendRumbleData();
-		int32 a = ReceiveRaw();
-		a = ReceiveRaw();
-		if (a > 0) {
-			State = EJoyConState::Imu_Data_OK;
-			ReadAttempts = 0;
-		} else if (ReadAttempts > 1000) {
+		// Block until the next report arrives, so input after a gap is picked up immediately
+		const int32 Ret = ReceiveRaw(GetReadTimeoutMs());
+		if (Ret > 0) {
+			if (DrainReports(1) < 0) return;
+		} else if (Ret < 0) {
+			UE_LOG(LogTemp, Warning, TEXT("JoyCon %d read failed, marking it as dropped."), JoyConInformation.ControllerId);
 			State = EJoyConState::Dropped;
 			return;
+		} else if (CheckReportTimeout()) {
+			return;
 		} else {
-			FPlatformProcess::Sleep(0.05);
+			// Keep the output stream alive while no input arrives
+			SendRumbleData();
 		}
-		ReadAttempts++;
 	}
 }
 
 void FJoyConController::Detach() {
-	bStopPolling = true;
+	// The channel reads replies itself from here on, so the listen thread has to be gone
+	StopListenThread();
+	CalibrationValidation.Cancel(Channel);
 	if (State > EJoyConState::No_JoyCons) {
 		// Subcommand 0x30: Set player lights
-		uint8 a[] = { 0x0 };
-		SendSubCommand(0x30, a, 1);
+		SendSubCommand(JoyCon::SubCommand::SetPlayerLights, 0x0);
 
 		// Subcommand 0x40: Enable IMU (6-Axis sensor)
-		a[0] = 0x0;
-		SendSubCommand(0x40, a, 1);
+		SendSubCommand(JoyCon::SubCommand::EnableImu, 0x0);
 
 		// Subcommand 0x48: Enable vibration
-		a[0] = 0x0;
-		SendSubCommand(0x48, a, 1);
+		SendSubCommand(JoyCon::SubCommand::EnableVibration, 0x0);
 
 		// Subcommand 0x03: Set input report mode
         // 0x3f - Simple HID mode. Pushes updates with every button press
-		a[0] = 0x3f;
-		SendSubCommand(0x3, a, 1);
+		SendSubCommand(JoyCon::SubCommand::SetInputReportMode, JoyCon::ReportId::SimpleInput);
+		Channel.Flush();
 	}
 	State = EJoyConState::Not_Attached;
 }
 
 FVector2D FJoyConController::GetStick() {
-	return FVector2D(Stick[0], Stick[1]);
+	return FVector2D(Input.Stick[0], Input.Stick[1]);
 }
 
 FVector FJoyConController::GetGyroscope() const {
-	return GyrG;
+	return ToFVector(Imu.GetLatestSample().Gyroscope);
 }
 
 FVector FJoyConController::GetAccelerometer() const {
-	return AccG;
+	return ToFVector(Imu.GetLatestSample().Accelerometer);
 }
 
 FRotator FJoyConController::GetVector() const {
-	FVector forward = FVector(J_B.X, I_B.X, K_B.X);
-	FVector up = -FVector(J_B.Z, I_B.Z, K_B.Z);;
-
-	forward = forward.GetSafeNormal();
-	up = up - (forward * FVector::DotProduct(up, forward));
-	up = up.GetSafeNormal();
-
-	FVector vector = forward.GetSafeNormal();
-	FVector vector2 = FVector::CrossProduct(up, vector);
-	FVector vector3 = FVector::CrossProduct(vector, vector2);
-	float m00 = vector.X;
-	float m01 = vector.Y;
-	float m02 = vector.Z;
-	float m10 = vector2.X;
-	float m11 = vector2.Y;
-	float m12 = vector2.Z;
-	float m20 = vector3.X;
-	float m21 = vector3.Y;
-	float m22 = vector3.Z;
-
-	float num8 = (m00 + m11) + m22;
-	FQuat quaternion = FQuat();
-
-	if (num8 > 0.0f) {
-		float num = (float)FMath::Sqrt(num8 + 1.0f);
-		quaternion.W = num * 0.5f;
-		num = 0.5f / num;
-		quaternion.X = (m12 - m21) * num;
-		quaternion.Y = (m20 - m02) * num;
-		quaternion.Z = (m01 - m10) * num;
-		return FRotator(quaternion);
-	}
+	const JoyCon::Quaternion Orientation = Imu.GetOrientation();
+	return FRotator(FQuat(Orientation.X, Orientation.Y, Orientation.Z, Orientation.W));
+}
 
-	if ((m00 >= m11) && (m00 >= m22)) {
-		float num7 = (float)FMath::Sqrt(((1.0f + m00) - m11) - m22);
-		float num4 = 0.5f / num7;
-		quaternion.X = 0.5f * num7;
-		quaternion.Y = (m01 + m10) * num4;
-		quaternion.Z = (m02 + m20) * num4;
-		quaternion.W = (m12 - m21) * num4;
-		return FRotator(quaternion);
-	}
+FQuat FJoyConMotionState::GetPredictedOrientation(const float ExtraSeconds) const {
+	const float Waited = static_cast<float>(FPlatformTime::Seconds() - SampleSeconds);
+	const float AheadSeconds = FMath::Clamp(Waited + ExtraSeconds, 0.0f, MaxPredictionSeconds);
+	const JoyCon::Quaternion Predicted = JoyCon::PredictOrientation(Orientation, Rate, AheadSeconds);
+	return FQuat(Predicted.X, Predicted.Y, Predicted.Z, Predicted.W);
+}
 
-	if (m11 > m22) {
-		float num6 = (float)FMath::Sqrt(((1.0f + m11) - m00) - m22);
-		float num3 = 0.5f / num6;
-		quaternion.X = (m10 + m01) * num3;
-		quaternion.Y = 0.5f * num6;
-		quaternion.Z = (m21 + m12) * num3;
-		quaternion.W = (m20 - m02) * num3;
-		return FRotator(quaternion);
-	}
+FQuat FJoyConMotionState::GetOrientation() const {
+	return FQuat(Orientation.X, Orientation.Y, Orientation.Z, Orientation.W);
+}
 
-	float num5 = (float)FMath::Sqrt(((1.0f + m22) - m00) - m11);
-	float num2 = 0.5f / num5;
-	quaternion.X = (m20 + m02) * num2;
-	quaternion.Y = (m21 + m12) * num2;
-	quaternion.Z = 0.5f * num5;
-	quaternion.W = (m01 - m10) * num2;
+void FJoyConController::PublishMotion(const double ArrivalSeconds) {
+	// The fitted sample time also covers the transport delay, the arrival time is the fallback before the first IMU report
+	Motion.SampleSeconds = Imu.Clock.HasHostFit() ? Imu.GetLatestHostSeconds() : ArrivalSeconds;
+	Motion.Orientation = Imu.GetOrientation();
+	Motion.Rate = Imu.GetLatestSample().Gyroscope;
+}
 
-	return FRotator(quaternion);
+FJoyConMotionState FJoyConController::GetMotionState() const {
+	FJoyConMotionState Result = Motion;
+	Result.bTracking = bImuEnabled && State >= EJoyConState::Imu_Data_OK;
+	return Result;
+}
+
+int32 FJoyConController::DrainImuSamples(TArray<FJoyConImuSample>& Out) {
+	const int32 Start = Out.Num();
+	FJoyConImuSample Sample;
+	while (ImuSamples.Dequeue(Sample)) {
+		Out.Add(Sample);
+	}
+	return Out.Num() - Start;
+}
+
+void FJoyConController::BufferImuSamples(const JoyCon::TimedImuSample* Samples, const int32 Count) {
+	for (int32 n = 0; n < Count; ++n) {
+		FJoyConImuSample Sample;
+		Sample.Timestamp = static_cast<float>(static_cast<double>(Samples[n].Tick) * JoyCon::DeviceTimerPeriod);
+		Sample.HostTime = Samples[n].HostSeconds > 0.0 ? static_cast<float>(Samples[n].HostSeconds - GStartTime) : 0.0f;
+		Sample.Accelerometer = ToFVector(Samples[n].Sample.Accelerometer);
+		Sample.Gyroscope = ToFVector(Samples[n].Sample.Gyroscope);
+		ImuSamples.Enqueue(Sample);
+	}
 }
 
 void FJoyConController::ReCenter() {
-	FirstImuPacket = true;
+	Imu.ResetOrientation();
 }
 
 void FJoyConController::SetRumble(const float LowFrequency, const float HighFrequency, const float Amplitude, const int Time) {
 	if (State <= Attached) return;
 	if (RumbleObj.TimedRumble == false || RumbleObj.Time < 0) {
 		RumbleObj.SetValues(LowFrequency, HighFrequency, Amplitude, Time);
+		PublishRumble();
 	}
 }
 
 void FJoyConController::SetFilterCoefficient(const float Coefficient) {
-	FilterWeight = Coefficient;
+	Imu.SetFilterGain(Coefficient);
+}
+
+void FJoyConController::SetOrientationFilter(const JoyCon::OrientationFilterType Type) {
+	Imu.SetFilterType(Type);
+}
+
+void FJoyConController::SetGyroBiasEstimation(const bool bEnabled) {
+	Imu.SetGyroBiasEstimation(bEnabled);
+}
+
+void FJoyConController::GetGyroBias(FVector& OutBias, float& OutConfidence) const {
+	OutBias = ToFVector(Imu.GyroBias.GetBias());
+	OutConfidence = Imu.IsGyroBiasEstimationEnabled() ? Imu.GyroBias.GetConfidence() : 0.0f;
+}
+
+void FJoyConController::SetGestureDetection(const bool bEnabled) {
+	bDetectGestures = bEnabled;
+}
+
+bool FJoyConController::DequeueGesture(JoyCon::GestureEvent& OutGesture) {
+	return GestureEvents.Dequeue(OutGesture);
+}
+
+void FJoyConController::GetClockStats(int32& OutLostReports, int32& OutDuplicateReports, float& OutTickPeriod) const {
+	OutLostReports = static_cast<int32>(FMath::Min<uint64>(Imu.Clock.GetLostReports(), MAX_int32));
+	OutDuplicateReports = static_cast<int32>(FMath::Min<uint64>(Imu.Clock.GetDuplicateReports(), MAX_int32));
+	OutTickPeriod = static_cast<float>(Imu.Clock.GetTickPeriod());
 }
 
 bool FJoyConController::StartListenThread() {
-	if (FPlatformProcess::SupportsMultithreading() && HidHandle != nullptr) {
-		if(Thread != nullptr) {
-			bStopPolling = true;
-			Thread->Kill(true);
-			delete Thread;
-			Thread = nullptr;
-		}
+	if (FPlatformProcess::SupportsMultithreading() && Device != nullptr) {
+		StopListenThread();
+		ResetGestureState();
 		bStopPolling = false;
+		LastReportTime = FPlatformTime::Seconds();
+		Channel.SetExternalReader(true);
 		Thread = FRunnableThread::Create(this, TEXT("FJoyConInput"), 0, EThreadPriority::TPri_Normal);
 		return true;
 	} else {
-		UE_LOG(LogTemp, Fatal, TEXT("Failed to start thread, the platform does not support multithreading or HidHandle null pointer exception."));
+		UE_LOG(LogTemp, Fatal, TEXT("Failed to start thread, the platform does not support multithreading or Device null pointer exception."));
 		return false;
 	}
 }
 
-void FJoyConController::DumpCalibrationData() {
-	auto Buf = ReadSpi(0x80, (bIsLeft ? static_cast<uint8>(0x12) : static_cast<uint8>(0x1d)), 9);
-	auto Found = false;
-	for (auto i = 0; i < 9; ++i) {
-		if (Buf[i] == 0xff) continue;
-		UE_LOG(LogTemp, Display, TEXT("Using user stick calibration data."));
-		Found = true;
-		break;
-	}
-	if (!Found) {
-		UE_LOG(LogTemp, Display, TEXT("Using factory stick calibration data."));
-		Buf = ReadSpi(0x60, (bIsLeft ? static_cast<uint8>(0x3d) : static_cast<uint8>(0x46)), 9);
-	}
-	StickCalibration[bIsLeft ? 0 : 2] = static_cast<uint16>((Buf[1] << 8) & 0xF00 | Buf[0]); // X Axis Max above center
-	StickCalibration[bIsLeft ? 1 : 3] = static_cast<uint16>((Buf[2] << 4) | (Buf[1] >> 4));  // Y Axis Max above center
-	StickCalibration[bIsLeft ? 2 : 4] = static_cast<uint16>((Buf[4] << 8) & 0xF00 | Buf[3]); // X Axis Center
-	StickCalibration[bIsLeft ? 3 : 5] = static_cast<uint16>((Buf[5] << 4) | (Buf[4] >> 4));  // Y Axis Center
-	StickCalibration[bIsLeft ? 4 : 0] = static_cast<uint16>((Buf[7] << 8) & 0xF00 | Buf[6]); // X Axis Min below center
-	StickCalibration[bIsLeft ? 5 : 1] = static_cast<uint16>((Buf[8] << 4) | (Buf[7] >> 4));  // Y Axis Min below center
+bool FJoyConController::StartReactorPolling() {
+	if (Device == nullptr) return false;
+	StopListenThread();
+	ResetGestureState();
+	bStopPolling = false;
+	LastReportTime = FPlatformTime::Seconds();
+	Channel.SetExternalReader(true);
+	return true;
+}
+
+void FJoyConController::StopListenThread() {
+	bStopPolling = true;
+	Channel.SetExternalReader(false);
+	if (Thread == nullptr) return;
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+}
 
-	Buf = ReadSpi(0x60, (bIsLeft ? static_cast<uint8>(0x86) : static_cast<uint8>(0x98)), 16);
-	DeadZone = static_cast<uint16>((Buf[4] << 8) & 0xF00 | Buf[3]);
+int32 FJoyConController::PumpReports() {
+	if (bStopPolling || State <= EJoyConState::No_JoyCons) return 0;
+	return DrainReports(0);
+}
 
-	Buf = ReadSpi(0x80, 0x34, 10);
-	GyrNeutral[0] = static_cast<uint16>(Buf[0] | ((Buf[1] << 8) & 0xff00));
-	GyrNeutral[1] = static_cast<uint16>(Buf[2] | ((Buf[3] << 8) & 0xff00));
-	GyrNeutral[2] = static_cast<uint16>(Buf[4] | ((Buf[5] << 8) & 0xff00));
+void FJoyConController::SetDropTimeout(const float Seconds) {
+	DropTimeout = Seconds;
+}
 
-	// This is an extremely messy way of checking to see whether there is user stick calibration data present, but I've seen conflicting user calibration data on blank Joy-Cons. Worth another look eventually.
-	if (GyrNeutral[0] + GyrNeutral[1] + GyrNeutral[2] != -3 && FGenericPlatformMath::Abs(GyrNeutral[0]) <= 100 && FGenericPlatformMath::Abs(GyrNeutral[1]) <= 100 && FGenericPlatformMath::Abs(GyrNeutral[2]) <= 100) return;
-	Buf = ReadSpi(0x60, 0x29, 10);
-	GyrNeutral[0] = static_cast<uint16>(Buf[3] | ((Buf[4] << 8) & 0xff00));
-	GyrNeutral[1] = static_cast<uint16>(Buf[5] | ((Buf[6] << 8) & 0xff00));
-	GyrNeutral[2] = static_cast<uint16>(Buf[7] | ((Buf[8] << 8) & 0xff00));
+bool FJoyConController::CheckReportTimeout() {
+	if (bStopPolling || State <= EJoyConState::No_JoyCons || DropTimeout <= 0.0f) return false;
+	if (FPlatformTime::Seconds() - LastReportTime <= DropTimeout) return false;
+	UE_LOG(LogTemp, Warning, TEXT("JoyCon %d sent no report for %.1f seconds, marking it as dropped."), JoyConInformation.ControllerId, DropTimeout);
+	State = EJoyConState::Dropped;
+	return true;
 }
 
-void FJoyConController::SendRumbleData() {
-	RumbleObj.CalculateRumbleData();
-	const auto Buf = new uint8[ReportLen];
-	Buf[0] = 0x10;
-	Buf[1] = GlobalCount;
-	if (GlobalCount == 0xf) GlobalCount = 0;
-	else ++GlobalCount;
-	ArrayCopy(RumbleObj.RumbleData, 0, Buf, 2, 8);
-	hid_write(HidHandle, Buf, ReportLen);
+bool FJoyConController::IsDropped() const {
+	return State == EJoyConState::Dropped;
 }
 
+void FJoyConController::ReplaceDevice(IJoyConDevice* NewDevice) {
+	StopListenThread();
+	CalibrationValidation.Cancel(Channel);
+	State = EJoyConState::Not_Attached;
+	delete Device;
+	Device = NewDevice;
+	SetCachedCalibration(Calibration);
+	// The new connection's timer starts over and the controller may have moved while it was gone
+	Imu.ResetClock();
+	Imu.ResetOrientation();
+}
 
-int FJoyConController::ReceiveRaw() {
-	if (HidHandle == nullptr) return -2;
-	hid_set_nonblocking(HidHandle, 0);
-	const auto RawBuf = new uint8[ReportLen];
-	if (bStopPolling) return 0;
-	const auto Ret = hid_read(HidHandle, RawBuf, ReportLen);
-	if (Ret <= 0) return Ret;
-	Mutex.Lock();
-	FReport Report;
-	Report.ReportData = RawBuf;
-	Report.Time = FDateTime::Now();
-	Reports.Enqueue(Report);
-	Mutex.Unlock();
-	if (TsEnqueue == RawBuf[1]) {
-		UE_LOG(LogTemp, Display, TEXT("Duplicate timestamp enqueued."));
+void FJoyConController::ClearInput() {
+	Input = JoyCon::InputState{};
+	FMemory::Memzero(Buttons, sizeof(Buttons));
+}
+
+void FJoyConController::RecordRecovery(const float Seconds) {
+	RecoveryCount++;
+	LastRecoverySeconds = Seconds;
+}
+
+int32 FJoyConController::GetRecoveryCount() const {
+	return RecoveryCount;
+}
+
+float FJoyConController::GetLastRecoverySeconds() const {
+	return LastRecoverySeconds;
+}
+
+IJoyConDevice* FJoyConController::GetDevice() const {
+	return Device;
+}
+
+uint32 FJoyConController::GetReportQueueHighWaterMark() const {
+	return Reports.GetHighWaterMark();
+}
+
+uint64 FJoyConController::GetReportQueueOverflowCount() const {
+	return Reports.GetOverflowCount();
+}
+
+void FJoyConController::SetCachedCalibration(const JoyCon::Calibration& InCalibration) {
+	Calibration = InCalibration;
+	CachedCalibration = InCalibration;
+	bHasCachedCalibration = true;
+}
+
+bool FJoyConController::ConsumeCalibrationChange(JoyCon::Calibration& Out) {
+	if (!bCalibrationChanged) return false;
+	bCalibrationChanged = false;
+	Out = Calibration;
+	return true;
+}
+
+bool FJoyConController::DumpCalibrationRegion(TArray<uint8>& Out) {
+	if (Device == nullptr) {
+		Out.Reset();
+		return false;
 	}
-	TsEnqueue = RawBuf[1];
-	return Ret;
+	// Chunks that fail are filled with 0xff like blank flash, so a partial dump never holds uninitialized bytes
+	Out.SetNumUninitialized(JoyCon::CalibrationDumpLength);
+	return JoyCon::DumpCalibrationRegion(Channel, Out.GetData());
 }
 
-void FJoyConController::ExtractImuValues(uint8 ReportBuf[], int32 N) {
-	GyrR[0] = static_cast<int16_t>(ReportBuf[19 + N * 12] | ((ReportBuf[20 + N * 12] << 8) & 0xff00));
-	GyrR[1] = static_cast<int16_t>(ReportBuf[21 + N * 12] | ((ReportBuf[22 + N * 12] << 8) & 0xff00));
-	GyrR[2] = static_cast<int16_t>(ReportBuf[23 + N * 12] | ((ReportBuf[24 + N * 12] << 8) & 0xff00));
-	AccR[0] = static_cast<int16_t>(ReportBuf[13 + N * 12] | ((ReportBuf[14 + N * 12] << 8) & 0xff00));
-	AccR[1] = static_cast<int16_t>(ReportBuf[15 + N * 12] | ((ReportBuf[16 + N * 12] << 8) & 0xff00));
-	AccR[2] = static_cast<int16_t>(ReportBuf[17 + N * 12] | ((ReportBuf[18 + N * 12] << 8) & 0xff00));
-	for (auto i = 0; i < 3; ++i) {
-		AccG[i] = AccR[i] * 0.00025f;
-		GyrG[i] = (GyrR[i] - GyrNeutral[i]) * 0.00122187695f;
-		if (FGenericPlatformMath::Abs(AccG[i]) > FGenericPlatformMath::Abs(Max[i])) Max[i] = AccG[i];
+bool FJoyConController::StartCapture(const FString& Filename) {
+	TUniquePtr<FJoyConReportLogWriter> Writer = FJoyConReportLogWriter::Open(Filename, bIsLeft);
+	if (!Writer.IsValid()) return false;
+	FScopeLock Lock(&CaptureMutex);
+	CaptureLog = MoveTemp(Writer);
+	return true;
+}
+
+void FJoyConController::StopCapture() {
+	FScopeLock Lock(&CaptureMutex);
+	if (!CaptureLog.IsValid()) return;
+	UE_LOG(LogTemp, Display, TEXT("Captured %llu JoyCon reports."), CaptureLog->Num());
+	CaptureLog.Reset();
+}
+
+void FJoyConController::CaptureReport(const uint8* Data, const int32 Length) {
+	FScopeLock Lock(&CaptureMutex);
+	if (CaptureLog.IsValid()) CaptureLog->Append(Data, Length, FJoyConReportLogWriter::NowNs());
+}
+
+void FJoyConController::DumpCalibrationData() {
+	if (JoyCon::LoadCalibration(Channel, bIsLeft, Calibration)) {
+		bCalibrationChanged = true;
+	} else {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon %d did not return all calibration data, using defaults for the missing parts."), JoyConInformation.ControllerId);
+	}
+	if (Calibration.bUserStickCalibration) {
+		UE_LOG(LogTemp, Display, TEXT("Using user stick calibration data."));
+	} else {
+		UE_LOG(LogTemp, Display, TEXT("Using factory stick calibration data."));
 	}
 }
 
-int32 FJoyConController::ProcessImu(uint8 ReportBuf[]) {
-	if (!bImuEnabled || State < EJoyConState::Imu_Data_OK) return -1;
-	if (ReportBuf[0] != 0x30) return -1; // no gyro data
-	// read raw IMU values
-	auto DT = (ReportBuf[1] - Timestamp);
-	if (ReportBuf[1] < Timestamp) DT += 0x100;
-	for (auto n = 0; n < 3; ++n) {
-		ExtractImuValues(ReportBuf, n);
-		const auto DT_Sec = 0.005f * DT;
-		Sum[0] += GyrG.X * DT_Sec;
-		Sum[1] += GyrG.Y * DT_Sec;
-		Sum[2] += GyrG.Z * DT_Sec;
-		if (bIsLeft) {
-			GyrG.Y *= -1;
-			GyrG.Z *= -1;
-			GyrG.Y *= -1;
-			GyrG.Z *= -1;
-		}
-		if (FirstImuPacket) {
-			I_B.Set(1, 0, 0);
-			J_B.Set(0, 1, 0);
-			K_B.Set(0, 0, 1);
-			FirstImuPacket = false;
-		} else {
-			K_Acc = -AccG.GetSafeNormal();
-			Wa = FVector::CrossProduct(K_B, K_Acc);
-			Wg = -GyrG * DT_Sec;
-			DTheta = (FilterWeight * Wa + Wg) / (1.f + FilterWeight);
-			K_B += FVector::CrossProduct(DTheta, K_B);
-			I_B += FVector::CrossProduct(DTheta, I_B);
-			J_B += FVector::CrossProduct(DTheta, J_B);
-			//Correction, ensure new axes are orthogonal
-			Err = FVector::DotProduct(I_B, J_B) * 0.5f;
-			IB2 = (I_B - Err * J_B).GetSafeNormal();
-			J_B = (J_B - Err * I_B).GetSafeNormal();
-			I_B = IB2;
-			K_B = FVector::CrossProduct(I_B, J_B);
-		}
-		DT = 1;
+void FJoyConController::ValidateCalibration() {
+	if (!CalibrationValidation.IsActive() || !CalibrationValidation.Poll(Channel, ValidatedCalibration)) return;
+	if (!CalibrationValidation.Succeeded()) {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon %d could not validate its cached calibration data."), JoyConInformation.ControllerId);
+		return;
 	}
-	Timestamp = ReportBuf[1] + 2;
-	return 0;
+	if (ValidatedCalibration == CachedCalibration) return;
+	UE_LOG(LogTemp, Display, TEXT("JoyCon %d cached calibration data is stale, using the data read from the controller."), JoyConInformation.ControllerId);
+	GestureConversion = ValidatedCalibration.Imu;
+	bValidatedCalibrationReady = true;
 }
 
-int32 FJoyConController::ProcessButtonsAndStick(uint8 ReportBuf[]) {
-	if (ReportBuf[0] == 0x00) return -1;
+void FJoyConController::PublishRumble() {
+	RumbleObj.CalculateRumbleData();
+	{
+		FScopeLock Lock(&RumbleMutex);
+		FMemory::Memcpy(PublishedRumbleData, RumbleObj.RumbleData, sizeof(PublishedRumbleData));
+		bPublishedRumbleActive = RumbleObj.Amplitude > 0.0f;
+	}
+	bRumbleDirty = true;
+}
 
-	StickRaw[0] = ReportBuf[6 + (bIsLeft ? 0 : 3)];
-	StickRaw[1] = ReportBuf[7 + (bIsLeft ? 0 : 3)];
-	StickRaw[2] = ReportBuf[8 + (bIsLeft ? 0 : 3)];
+void FJoyConController::SendRumbleData() {
+	// Only pick up the bytes when the rumble changed, and only transmit new bytes or a keep-alive
+	if (bRumbleDirty.Exchange(false)) {
+		FScopeLock Lock(&RumbleMutex);
+		FMemory::Memcpy(RumbleData, PublishedRumbleData, sizeof(RumbleData));
+		bRumbleActive = bPublishedRumbleActive;
+	}
+	const double Now = FPlatformTime::Seconds();
+	const bool bChanged = FMemory::Memcmp(RumbleData, SentRumbleData, sizeof(SentRumbleData)) != 0;
+	const double KeepAlive = bRumbleActive ? ActiveRumbleKeepAlive : IdleRumbleKeepAlive;
+	if (!bChanged && Now - LastRumbleSendTime < KeepAlive) return;
+	if (Channel.SendRumble(RumbleData) < 0) return;
+	FMemory::Memcpy(SentRumbleData, RumbleData, sizeof(SentRumbleData));
+	LastRumbleSendTime = Now;
+}
 
-	StickPreCalibration[0] = static_cast<uint16>(StickRaw[0] | ((StickRaw[1] & 0xf) << 8));
-	StickPreCalibration[1] = static_cast<uint16>((StickRaw[1] >> 4) | (StickRaw[2] << 4));
-	CenterSticks(StickPreCalibration);
+void FJoyConController::SendSubCommand(const uint8 SubCommand, const uint8 Argument) {
+	if (!Channel.Post(SubCommand, &Argument, 1)) {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon %d failed to queue subcommand 0x%02x."), JoyConInformation.ControllerId, SubCommand);
+	}
+}
 
-	Buttons[EJoyConControllerButton::DPad_Up] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & (bIsLeft ? 0x02 : 0x02)) != 0;
-	Buttons[EJoyConControllerButton::DPad_Left] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & (bIsLeft ? 0x08 : 0x01)) != 0;
-	Buttons[EJoyConControllerButton::DPad_Right] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & (bIsLeft ? 0x04 : 0x08)) != 0;
-	Buttons[EJoyConControllerButton::DPad_Down] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & (bIsLeft ? 0x01 : 0x04)) != 0;
+int32 FJoyConController::DrainReports(int32 Received) {
+	int32 Ret;
+	while ((Ret = ReceiveRaw(0)) > 0) {
+		Received++;
+	}
+	if (Ret < 0) {
+		State = EJoyConState::Dropped;
+		return -1;
+	}
+	if (Received > 0) {
+		OnReportsReceived();
+		ValidateCalibration();
+		SendRumbleData();
+	}
+	return Received;
+}
 
-	Buttons[EJoyConControllerButton::Minus] = (ReportBuf[4] & 0x01) != 0;
-	Buttons[EJoyConControllerButton::Plus] = (ReportBuf[4] & 0x02) != 0;
-	Buttons[EJoyConControllerButton::Home] = (ReportBuf[4] & 0x10) != 0;
-	//Buttons[EButton::JoyCon_Capture].Update((ReportBuf[4] & 0x02) != 0);
-	
-    Buttons[EJoyConControllerButton::Left_ThumbStick] = (ReportBuf[4] & (bIsLeft ? 0x08 : 0x04)) != 0;
-	
-	Buttons[EJoyConControllerButton::Sr] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & 0x10) != 0;
-	Buttons[EJoyConControllerButton::Sl] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & 0x20) != 0;
+void FJoyConController::OnReportsReceived() {
+	const double Now = FPlatformTime::Seconds();
+	const float Gap = static_cast<float>(Now - LastReportTime);
+	// Gaps longer than a few periods are dropouts, not the report rate
+	if (Gap < NominalReportPeriod * 4) ReportPeriod += (Gap - ReportPeriod) * 0.1f;
+	LastReportTime = Now;
+	State = EJoyConState::Imu_Data_OK;
+}
 
-	Buttons[EJoyConControllerButton::L] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & 0x40) != 0;
-	Buttons[EJoyConControllerButton::Zl] = (ReportBuf[3 + (bIsLeft ? 2 : 0)] & 0x80) != 0;
+int32 FJoyConController::GetReadTimeoutMs() const {
+	return FMath::Clamp(FMath::CeilToInt(ReportPeriod * 2000.0f), MinReadTimeoutMs, MaxReadTimeoutMs);
+}
 
-	return 0;
+int FJoyConController::ReceiveRaw(const int32 Milliseconds) {
+	if (Device == nullptr) return -2;
+	if (bStopPolling) return 0;
+	uint8 Data[JoyCon::ReportLength];
+	const int32 Ret = Read(Data, ReportLen, Milliseconds);
+	if (Ret <= 0) return Ret;
+	// Replies to pending subcommands are consumed by the channel, everything else is input
+	if (!Channel.HandleReport(Data, Ret)) OnInputReport(Data, Ret);
+	return Ret;
 }
 
-void FJoyConController::CenterSticks(uint16 Values[]) {
-	for (uint32 i = 0; i < 2; ++i) {
-		const float Diff = Values[i] - StickCalibration[2 + i];
-		if (FGenericPlatformMath::Abs(Diff) < DeadZone) Stick[i] = 0;
-		else if (Diff > 0) Stick[i] = Diff / StickCalibration[i];
-		else Stick[i] = Diff / StickCalibration[4 + i];
-	}
+void FJoyConController::OnInputReport(const uint8* Data, const size_t Length) {
+	FReport Report;
+	FMemory::Memcpy(Report.ReportData, Data, FMath::Min<size_t>(Length, sizeof(Report.ReportData)));
+	Report.HostSeconds = FPlatformTime::Seconds();
+	Reports.Enqueue(Report);
+	if (bDetectGestures) RecognizeGestures(Data, Length, Report.HostSeconds);
 }
 
-uint8* FJoyConController::SendSubCommand(const uint8 Sc, uint8 TempBuf[], const uint8 Len) {
-	const auto Buf = new uint8[ReportLen];
-	const auto Response = new uint8[ReportLen];
-	ArrayCopy(DefaultBuf, 0, Buf, 2, 8);
-	ArrayCopy(TempBuf, 0, Buf, 11, Len);
-	Buf[10] = Sc;
-	Buf[1] = GlobalCount;
-	Buf[0] = 0x1;
-	if (GlobalCount == 0xf) GlobalCount = 0;
-	else ++GlobalCount;
-	hid_write(HidHandle, Buf, Len + 11);
-	int Result = hid_read_timeout(HidHandle, Response, ReportLen, 50);
-	return Response;
-}
-
-uint8* FJoyConController::ReadSpi(const uint8 Address1, const uint8 Address2, const uint32_t Len) {
-	uint8 TBuf[5] = { Address2, Address1, 0x00, 0x00, static_cast<uint8>(Len) };
-	const auto ReadBuf = new uint8[Len];
-	auto Buf = new uint8[Len + 20];
-
-	for (auto i = 0; i < 100; ++i) {
-		Buf = SendSubCommand(0x10, TBuf, 5);
-		if (Buf[15] == Address2 && Buf[16] == Address1) {
-			break;
-		}
+void FJoyConController::RecognizeGestures(const uint8* Data, const size_t Length, const double HostSeconds) {
+	if (!bImuEnabled || Length < JoyCon::ReportLength || Data[0] != JoyCon::ReportId::FullInput) return;
+	const uint64 Tick = GestureClock.Observe(Data[1], HostSeconds);
+	float Values[6][JoyCon::ImuSamplesPerReport];
+	const JoyCon::ImuSampleArrays Arrays = { { Values[0], Values[1], Values[2] }, { Values[3], Values[4], Values[5] } };
+	JoyCon::ConvertImuReport(Data, GestureConversion, Arrays);
+	JoyCon::GestureEvent Events[JoyCon::MaxGestureEventsPerSample];
+	for (int32 n = 0; n < JoyCon::ImuSamplesPerReport; ++n) {
+		const JoyCon::ImuSample Sample = { JoyCon::Vector3(Values[0][n], Values[1][n], Values[2][n]), JoyCon::Vector3(Values[3][n], Values[4][n], Values[5][n]) };
+		const int32 Count = Gestures.Update(Sample, Tick + n, Events);
+		for (int32 e = 0; e < Count; ++e) GestureEvents.Enqueue(Events[e]);
 	}
-	ArrayCopy(Buf, 20, ReadBuf, 0, Len);
-	return ReadBuf;
 }
 
-void FJoyConController::ArrayCopy(uint8* SourceArray, const int SourceIndex, uint8* DestinationArray, const int DestinationIndex, const int Length) {
-	memcpy(DestinationArray + DestinationIndex, SourceArray + SourceIndex, Length);
-	//std::copy(SourceArray + SourceIndex, SourceArray + SourceIndex + Length, DestinationArray + DestinationIndex);
+void FJoyConController::ResetGestureState() {
+	GestureConversion = Calibration.Imu;
+	GestureClock.Reset();
+	Gestures.Reset();
+}
+
+int32 FJoyConController::ProcessImu(uint8 ReportBuf[], const double HostSeconds, JoyCon::TimedImuSample Out[JoyCon::ImuSamplesPerReport]) {
+	if (!bImuEnabled || State < EJoyConState::Imu_Data_OK) return 0;
+	return Imu.ProcessReport(ReportBuf, Calibration.Imu, Out, HostSeconds);
+}
+
+int32 FJoyConController::ProcessButtonsAndStick(uint8 ReportBuf[]) {
+	if (!Decoders->DecodeInput(ReportBuf, Calibration.Stick, Input)) return -1;
+	FMemory::Memcpy(Buttons, Input.Buttons, sizeof(Input.Buttons));
+	return 0;
+}
+
+int32 FJoyConController::Read(uint8* Data, const size_t Length, const int32 Milliseconds) {
+	const int32 Result = Device->Read(Data, Length, Milliseconds);
+	if (Result > 0) CaptureReport(Data, Result);
+	return Result;
 }
 
-void FJoyConController::ArrayCopy(const uint8* SourceArray, const int SourceIndex, uint8* DestinationArray, const int DestinationIndex, const int Length) {
-	memcpy(DestinationArray + DestinationIndex, SourceArray + SourceIndex, Length);
-	//std::copy(SourceArray + SourceIndex, SourceArray + SourceIndex + Length, DestinationArray + DestinationIndex);
+int32 FJoyConController::Write(const uint8* Data, const size_t Length) {
+	return Device->Write(Data, Length);
 }
 
 bool FJoyConController::Init() {
@@ -476,4 +611,5 @@ uint32 FJoyConController::Run() {
 
 void FJoyConController::Stop() {
 	bStopPolling = true;
+	Channel.SetExternalReader(false);
 }
\ No newline at end of file
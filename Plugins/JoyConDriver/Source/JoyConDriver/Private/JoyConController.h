@@ -3,11 +3,20 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "hidapi.h"
+#include "JoyConDevice.h"
+#include "JoyConCore/JoyConCalibration.h"
+#include "JoyConCore/JoyConGesture.h"
+#include "JoyConCore/JoyConImuFusion.h"
+#include "JoyConCore/JoyConLayout.h"
+#include "JoyConCore/JoyConProtocol.h"
+#include "JoyConCore/JoyConRumble.h"
+#include "JoyConCore/JoyConSpiFlash.h"
 #include "InputCoreTypes.h"
+#include "JoyConImuSample.h"
 #include "JoyConInformation.h"
 #include "JoyConState.h"
-#include "Containers/Queue.h"
+#include "JoyConReportLog.h"
+#include "JoyConReportRing.h"
 #include "GenericPlatform/GenericApplicationMessageHandler.h"
 #include "HAL/Runnable.h"
 
@@ -20,29 +29,35 @@ enum EJoyConState {
 	Imu_Data_OK,
 };
 
-struct FReport {
-	uint8* ReportData;
-	FDateTime Time;
-
-	FReport() {
-		ReportData = nullptr;
-	}
+/** Motion of a controller as Update() published it, a copy other threads can use without touching the controller */
+struct FJoyConMotionState {
+	JoyCon::Quaternion Orientation;
+	JoyCon::Vector3 Rate;
+	/** FPlatformTime::Seconds() of the newest sample */
+	double SampleSeconds;
+	/** True once the controller streams IMU reports */
+	bool bTracking;
+
+	FJoyConMotionState() : SampleSeconds(0.0), bTracking(false) {}
+
+	/**
+	 * Orientation carried forward from the newest sample to ExtraSeconds past now, so the time the report has been
+	 * waiting is compensated too. The horizon is capped, a stalled controller stops turning after a moment.
+	 */
+	FQuat GetPredictedOrientation(float ExtraSeconds) const;
+	FQuat GetOrientation() const;
+};
 
-	FReport(uint8_t* TempReportData, const FDateTime TempTime) {
-		ReportData = TempReportData;
-		Time = TempTime;
-	}
+struct FReport {
+	uint8 ReportData[49];
+	/** FPlatformTime::Seconds() when the report was read, monotonic and much cheaper than a wall clock */
+	double HostSeconds;
 
-	FDateTime GetTime() const {
-		return Time;
+	FReport(): ReportData{}, HostSeconds(0.0) {
 	}
 
 	void CopyBuffer(uint8* DestinationArray) const {
-		// Replace for with memcpy and report length(49)
 		memcpy(DestinationArray, ReportData, 49);
-		/*for (auto i = 0; i < 49; ++i) {
-			DestinationArray[i] = ReportData[i];
-		}*/
 	}
 };
 
@@ -81,65 +96,20 @@ struct FRumble {
 		}
 	}
 	
-	static float Clamp(const float X, const float Min, const float Max) {
-		if (X < Min) return Min;
-		if (X > Max) return Max;
-		return X;
-	}
-
 	void CalculateRumbleData() {
-		//uint8 *RumbleData = static_cast<uint8*>(calloc(8, sizeof(uint8)));
-		if (Amplitude == 0.0f) {
-			RumbleData[0] = 0x0;
-			RumbleData[1] = 0x1;
-			RumbleData[2] = 0x40;
-			RumbleData[3] = 0x40;
-		} else {
-			LowFrequency = Clamp(LowFrequency, 40.875885f, 626.286133f);
-			Amplitude = Clamp(Amplitude, 0.0f, 1.0f);
-			HighFrequency = Clamp(HighFrequency, 81.75177f, 1252.572266f);
-			
-			const uint16 HighFrequencyLocal = static_cast<uint16>((FMath::RoundToInt(32.0f * FMath::LogX(2, HighFrequency * 0.1f)) - 0x60) * 4);
-			const uint8 LowFrequencyLocal = static_cast<uint8>(FMath::RoundToInt(32.0f * FMath::LogX(2, LowFrequency * 0.1f)) - 0x40);
-			
-			uint8 HighFrequencyAmplitude;
-			if (Amplitude == 0) HighFrequencyAmplitude = 0;
-			else if (Amplitude < 0.117) HighFrequencyAmplitude = static_cast<uint8>(((FMath::LogX(2, Amplitude * 1000) * 32) - 0x60) / (5 - FMath::Pow(Amplitude, 2)) - 1);
-			else if (Amplitude < 0.23) HighFrequencyAmplitude = static_cast<uint8>(((FMath::LogX(2, Amplitude * 1000) * 32) - 0x60) - 0x5c);
-			else HighFrequencyAmplitude = static_cast<uint8>((((FMath::LogX(2, Amplitude * 1000) * 32) - 0x60) * 2) - 0xf6);
-
-			uint16 LowFrequencyAmplitude = static_cast<uint16>(FMath::RoundToInt(HighFrequencyAmplitude) * .5);
-			const uint8 Parity = static_cast<uint8>(LowFrequencyAmplitude % 2);
-			if (Parity > 0) {
-				--LowFrequencyAmplitude;
-			}
-
-			LowFrequencyAmplitude = static_cast<uint16>(LowFrequencyAmplitude >> 1);
-			LowFrequencyAmplitude += 0x40;
-			if (Parity > 0) LowFrequencyAmplitude |= 0x8000;
-			RumbleData[0] = static_cast<uint8>(HighFrequencyLocal & 0xff);
-			RumbleData[1] = static_cast<uint8>((HighFrequencyLocal >> 8) & 0xff);
-			RumbleData[2] = LowFrequencyLocal;
-			RumbleData[3] = 0;
-			
-			RumbleData[1] += HighFrequencyLocal;
-			RumbleData[2] += static_cast<uint8>((LowFrequencyAmplitude >> 8) & 0xff);
-			RumbleData[3] += static_cast<uint8>(LowFrequencyAmplitude & 0xff);
-		}
-		for (int i = 0; i < 4; ++i) {
-			RumbleData[4 + i] = RumbleData[i];
-		}
-		//return RumbleData;
+		JoyCon::EncodeRumble(LowFrequency, HighFrequency, Amplitude, RumbleData);
 	}
 };
 
-class FJoyConController : public FRunnable {
+class FJoyConController : public FRunnable, private JoyCon::ITransport, private JoyCon::IReportSink {
+	friend class FJoyConBenchmark;
 
 public:
-	FJoyConController(FJoyConInformation TempJoyConInformation, hid_device* Device, const bool UseImu, const bool UseLocalize, float Alpha, const bool IsLeft);
+	FJoyConController(FJoyConInformation TempJoyConInformation, IJoyConDevice* TempDevice, const bool UseImu, const bool UseLocalize, float Alpha, const bool IsLeft);
 	~FJoyConController();
 
-	void Attach(uint8 Leds);
+	/** Runs the attach handshake, blocking until the controller answered it. Returns false if it did not respond. */
+	bool Attach(uint8 Leds);
 	void Update();
 	void Pool();
 	void Detach();
@@ -148,80 +118,175 @@ public:
 	FVector GetGyroscope() const;
 	FVector GetAccelerometer() const;
 	FRotator GetVector() const;
+
+	/** Game thread, the motion the last Update() published and whether the controller streams IMU reports */
+	FJoyConMotionState GetMotionState() const;
+	bool IsLeft() const { return bIsLeft; }
+
+	/** Appends every IMU sample decoded since the last call, three per report, oldest first. Returns how many. */
+	int32 DrainImuSamples(TArray<FJoyConImuSample>& Out);
 	void ReCenter();
 	void SetRumble(float LowFrequency, float HighFrequency, float Amplitude, int Time = 0);
 
+	/** Weight of the accelerometer correction, the basis filter's weight or the quaternion filters' gain */
 	void SetFilterCoefficient(float Coefficient);
+	void SetOrientationFilter(JoyCon::OrientationFilterType Type);
+
+	/** Continuously re-estimate the gyroscope bias while the controller rests, see JoyCon::GyroBiasEstimator */
+	void SetGyroBiasEstimation(bool bEnabled);
+
+	/** Current gyroscope bias in rad/s on top of the factory neutral, and how much it can be trusted from 0 to 1 */
+	void GetGyroBias(FVector& OutBias, float& OutConfidence) const;
+
+	/** Runs the gesture recognizer on the polling thread, only takes effect while polling is stopped */
+	void SetGestureDetection(bool bEnabled);
+
+	/** Next gesture recognized on the polling thread, false once all were taken */
+	bool DequeueGesture(JoyCon::GestureEvent& OutGesture);
+
+	/** Health of the report timeline, see JoyCon::DeviceClock. Only IMU reports are counted. */
+	void GetClockStats(int32& OutLostReports, int32& OutDuplicateReports, float& OutTickPeriod) const;
 
 	bool StartListenThread();
+	bool StartReactorPolling();
+	int32 PumpReports();
+
+	/** Marks the controller dropped once no report arrived for this long, see CheckReportTimeout() */
+	void SetDropTimeout(float Seconds);
+
+	/** Returns true and sets the Dropped state if the controller has been silent for longer than the drop timeout */
+	bool CheckReportTimeout();
+	bool IsDropped() const;
+
+	/**
+	 * Replaces the device after a drop and keeps the calibration already known, so the following Attach() reads no
+	 * flash. Polling has to be stopped by the caller and nothing else may use the device meanwhile.
+	 */
+	void ReplaceDevice(IJoyConDevice* NewDevice);
+
+	/** Game thread, releases every button and centers the stick so a dropped controller stops sending its last input */
+	void ClearInput();
+
+	/** Successful reconnects and how long the last one took from the drop to the end of its handshake */
+	void RecordRecovery(float Seconds);
+	int32 GetRecoveryCount() const;
+	float GetLastRecoverySeconds() const;
+	IJoyConDevice* GetDevice() const;
+	uint32 GetReportQueueHighWaterMark() const;
+	uint64 GetReportQueueOverflowCount() const;
+
+	/** Calibration to use on the next Attach() instead of reading it first, it is validated in the background */
+	void SetCachedCalibration(const JoyCon::Calibration& InCalibration);
+
+	/** Returns true once after calibration was read from the device and differs from the cached one */
+	bool ConsumeCalibrationChange(JoyCon::Calibration& Out);
+
+	/** Reads the factory and user calibration regions of the SPI flash, see JoyCon::DumpCalibrationRegion() */
+	bool DumpCalibrationRegion(TArray<uint8>& Out);
+
+	/** Appends every report read from the device to a report log until StopCapture() */
+	bool StartCapture(const FString& Filename);
+	void StopCapture();
 
 private:
 	void DumpCalibrationData();
+	void ValidateCalibration();
+	/** Game thread, encodes RumbleObj for the polling thread */
+	void PublishRumble();
 	void SendRumbleData();
-	int32 ReceiveRaw();
-	void ExtractImuValues(uint8 ReportBuf[], int32 N);
-	int32 ProcessImu(uint8 ReportBuf[]);
+	void SendSubCommand(uint8 SubCommand, uint8 Argument);
+	int32 ReceiveRaw(int32 Milliseconds = -1);
+	int32 DrainReports(int32 Received);
+	void OnReportsReceived();
+	int32 GetReadTimeoutMs() const;
+	void CaptureReport(const uint8* Data, int32 Length);
+	/** Runs the report's samples through the orientation filter, returns how many were written to Out */
+	int32 ProcessImu(uint8 ReportBuf[], double HostSeconds, JoyCon::TimedImuSample Out[JoyCon::ImuSamplesPerReport]);
+	void BufferImuSamples(const JoyCon::TimedImuSample* Samples, int32 Count);
+	/** Game thread, keeps the newest orientation, rate and sample time of Imu for GetMotionState() */
+	void PublishMotion(double ArrivalSeconds);
+	/** Polling thread, feeds the samples of an input report to the gesture recognizer */
+	void RecognizeGestures(const uint8* Data, size_t Length, double HostSeconds);
+	/** Hands the current calibration to the polling thread's gesture state before polling starts */
+	void ResetGestureState();
 	int32 ProcessButtonsAndStick(uint8 ReportBuf[]);
-	void CenterSticks(uint16 Values[]);
 
-	uint8* SendSubCommand(uint8 Sc, uint8 TempBuf[], uint8 Len);
-	uint8* ReadSpi(uint8 Address1, uint8 Address2, uint32_t Len);
+	void StopListenThread();
 
-	static void ArrayCopy(uint8* SourceArray, int SourceIndex, uint8* DestinationArray, int DestinationIndex, int Length);
-	static void ArrayCopy(const uint8* SourceArray, int SourceIndex, uint8* DestinationArray, int DestinationIndex, int Length);
+	// JoyCon::ITransport, used by the subcommand channel so replies are captured like input reports
+	virtual int32 Read(uint8* Data, size_t Length, int32 Milliseconds) override;
+	virtual int32 Write(const uint8* Data, size_t Length) override;
+
+	// JoyCon::IReportSink, input reports that arrive between subcommand replies
+	virtual void OnInputReport(const uint8* Data, size_t Length) override;
 
 private:
-	hid_device* HidHandle;
+	IJoyConDevice* Device;
 	EJoyConState State;
 
 	bool bStopPolling;
 	bool bImuEnabled;
 	bool bIsLeft;
 	bool bDoLocalize;
+	/** Report decoders of this controller's layout, chosen once so the polling thread never branches on the side */
+	const JoyCon::ControllerDecoders* Decoders;
 
-	uint8 GlobalCount;
-	uint32 ReadAttempts = 0;
+	/** Host time of the last received report, in FPlatformTime::Seconds() */
+	double LastReportTime;
+	/** Running estimate of the time between reports */
+	float ReportPeriod;
+	float DropTimeout;
 
 	const uint32 ReportLen = 49;
-	const uint8 DefaultBuf[8] = { 0x0, 0x1, 0x40, 0x40, 0x0, 0x1, 0x40, 0x40 };
-
-	// Analog Stick Variables
-	float Stick[2] = { 0, 0 };
-	float StickMax[2] = { 0, 0 };
-	uint8 StickRaw[3] = { 0, 0, 0 };
-	uint16 StickCalibration[6] = { 0, 0, 0, 0, 0, 0 };
-	uint16 DeadZone;
-	uint16 StickPreCalibration[2] = { 0, 0 };
-
-	// Accelerometer and Gyroscope Variables
-	int16 GyrNeutral[3] = { 0, 0, 0 };
-	int16 GyrR[3] = { 0, 0, 0 };
-	int16 AccR[3] = { 0, 0, 0 };
-	FVector AccG;
-	FVector GyrG;
-
-	float Max[3] = { 0, 0, 0 };
-	float Sum[3] = { 0, 0, 0 };
-	int Timestamp;
-	TQueue<FReport> Reports;
-	uint8 TsDequeue;
-	uint8 TsEnqueue;
-	FDateTime TsPrevious;
-	float FilterWeight;
-	float Err;
-	bool FirstImuPacket = true;
-	FVector I_B;
-	FVector J_B;
-	FVector K_B;
-	FVector K_Acc;
-	FVector Wa;
-	FVector Wg;
-	FVector DTheta;
-	FVector IB2;
+
+	JoyCon::SubCommandChannel Channel;
+	JoyCon::Calibration Calibration;
+	JoyCon::InputState Input;
+
+	bool bHasCachedCalibration;
+	/** Set when Calibration holds data read from the device that has not been consumed yet */
+	bool bCalibrationChanged;
+	JoyCon::Calibration CachedCalibration;
+	/** Background read of the calibration, driven by the polling thread */
+	JoyCon::CalibrationReader CalibrationValidation;
+	JoyCon::Calibration ValidatedCalibration;
+	TAtomic<bool> bValidatedCalibrationReady;
+	JoyCon::ImuProcessor Imu;
+	/** Owned by the game thread, the tracking flag is filled in by GetMotionState() */
+	FJoyConMotionState Motion;
+	/** Samples decoded by Update() until DrainImuSamples(), about 2.5 s at 200 Hz, the oldest are overwritten */
+	TJoyConSpscRing<FJoyConImuSample, 512> ImuSamples;
+
+	TJoyConSpscRing<FReport, 64> Reports;
+
+	bool bDetectGestures;
+	/** Owned by the polling thread, the conversion is its own copy of the calibration */
+	JoyCon::ImuConversion GestureConversion;
+	JoyCon::DeviceClock GestureClock;
+	JoyCon::GestureRecognizer Gestures;
+	TJoyConSpscRing<JoyCon::GestureEvent, 16> GestureEvents;
+
+	/** Owned by the game thread, PublishRumble() hands its encoded bytes to the polling thread */
 	FRumble RumbleObj;
+	FCriticalSection RumbleMutex;
+	/** Guarded by RumbleMutex */
+	uint8 PublishedRumbleData[8];
+	bool bPublishedRumbleActive;
+	/** Set when new rumble bytes were published */
+	TAtomic<bool> bRumbleDirty;
+	/** Owned by the polling thread, the published bytes it sends and the last ones written to the device */
+	uint8 RumbleData[8];
+	bool bRumbleActive;
+	uint8 SentRumbleData[8];
+	double LastRumbleSendTime;
 
 	FRunnableThread* Thread;
-	FCriticalSection Mutex;
+
+	int32 RecoveryCount;
+	float LastRecoverySeconds;
+
+	FCriticalSection CaptureMutex;
+	TUniquePtr<FJoyConReportLogWriter> CaptureLog;
 
 public:
 	FJoyConInformation JoyConInformation;
@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConCalibration.h"
+
+#include "JoyConLayout.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace JoyCon {
+
+	static int16_t DecodeInt16(const uint8_t* Bytes) {
+		return static_cast<int16_t>(Bytes[0] | ((Bytes[1] << 8) & 0xff00));
+	}
+
+	void DecodeStickCalibration(const uint8_t Block[9], const bool bIsLeft, StickCalibration& Out) {
+		GetControllerDecoders(GetJoyConType(bIsLeft)).DecodeStickCalibration(Block, Out);
+	}
+
+	uint16_t DecodeStickDeadZone(const uint8_t Parameters[5]) {
+		return static_cast<uint16_t>(((Parameters[4] << 8) & 0xf00) | Parameters[3]);
+	}
+
+	bool IsBlank(const uint8_t* Block, const size_t Length) {
+		for (size_t i = 0; i < Length; ++i) {
+			if (Block[i] != 0xff) return false;
+		}
+		return true;
+	}
+
+	bool operator==(const StickCalibration& A, const StickCalibration& B) {
+		for (int i = 0; i < 2; ++i) {
+			if (A.Max[i] != B.Max[i] || A.Center[i] != B.Center[i] || A.Min[i] != B.Min[i]) return false;
+		}
+		return A.DeadZone == B.DeadZone;
+	}
+
+	bool operator==(const Calibration& A, const Calibration& B) {
+		for (int i = 0; i < 3; ++i) {
+			if (A.GyroNeutral[i] != B.GyroNeutral[i] || A.AccelNeutral[i] != B.AccelNeutral[i]) return false;
+			if (A.GyroSensitivity[i] != B.GyroSensitivity[i] || A.AccelSensitivity[i] != B.AccelSensitivity[i]) return false;
+		}
+		return A.Stick == B.Stick && A.bUserStickCalibration == B.bUserStickCalibration && A.bUserGyroCalibration == B.bUserGyroCalibration;
+	}
+
+	// Both IMU blocks hold accelerometer origin, accelerometer sensitivity, gyroscope origin and gyroscope sensitivity
+	static constexpr size_t ImuCalibrationLength = 24;
+	static constexpr size_t ImuAccelSensitivityOffset = 6;
+	static constexpr size_t ImuGyroOriginOffset = 12;
+	static constexpr size_t ImuGyroSensitivityOffset = 18;
+
+	// Sensitivity coefficients of a nominal unit: the accelerometer reads 4 g per (coefficient - origin) counts and
+	// the gyroscope 936 dps per (coefficient - origin) counts
+	static constexpr int NominalAccelSensitivity = 16384;
+	static constexpr int NominalGyroSensitivity = 13371;
+	static constexpr float AccelSensitivityRange = 4.0f;
+	static constexpr float GyroSensitivityRange = 936.0f * 3.14159265f / 180.0f;
+	// Units deviate by a few percent, anything further off is not a calibration
+	static constexpr float SensitivityTolerance = 0.2f;
+	static constexpr int MaxAccelOrigin = 1000;
+
+	void DecodeCalibration(const CalibrationBlocks& Blocks, const bool bIsLeft, Calibration& Out) {
+		Out.bUserStickCalibration = !IsBlank(Blocks.UserStick, 9);
+		DecodeStickCalibration(Out.bUserStickCalibration ? Blocks.UserStick : Blocks.FactoryStick, bIsLeft, Out.Stick);
+		Out.Stick.DeadZone = DecodeStickDeadZone(Blocks.StickParameters);
+
+		for (int i = 0; i < 3; ++i) {
+			Out.GyroNeutral[i] = DecodeInt16(&Blocks.UserImu[ImuGyroOriginOffset + i * 2]);
+		}
+		// Blank Joy-Cons have been seen with conflicting user calibration, so only trust small offsets
+		Out.bUserGyroCalibration = Out.GyroNeutral[0] + Out.GyroNeutral[1] + Out.GyroNeutral[2] != -3
+			&& std::abs(Out.GyroNeutral[0]) <= 100 && std::abs(Out.GyroNeutral[1]) <= 100 && std::abs(Out.GyroNeutral[2]) <= 100;
+		const uint8_t* ImuBlock = Out.bUserGyroCalibration ? Blocks.UserImu : Blocks.FactoryImu;
+		for (int i = 0; i < 3; ++i) {
+			Out.GyroNeutral[i] = DecodeInt16(&ImuBlock[ImuGyroOriginOffset + i * 2]);
+			Out.AccelNeutral[i] = DecodeInt16(&ImuBlock[i * 2]);
+			Out.GyroSensitivity[i] = DecodeInt16(&ImuBlock[ImuGyroSensitivityOffset + i * 2]);
+			Out.AccelSensitivity[i] = DecodeInt16(&ImuBlock[ImuAccelSensitivityOffset + i * 2]);
+		}
+		ComputeImuConversion(Out);
+	}
+
+	static bool IsPlausibleSpan(const int Span, const int Nominal) {
+		return Span > Nominal * (1.0f - SensitivityTolerance) && Span < Nominal * (1.0f + SensitivityTolerance);
+	}
+
+	void ComputeImuConversion(Calibration& Out) {
+		ImuConversion& Conversion = Out.Imu;
+		Conversion = ImuConversion();
+		for (int i = 0; i < 3; ++i) {
+			Conversion.GyroOrigin[i] = Out.GyroNeutral[i];
+			const int GyroSpan = Out.GyroSensitivity[i] - Out.GyroNeutral[i];
+			if (IsPlausibleSpan(GyroSpan, NominalGyroSensitivity)) Conversion.GyroScale[i] = GyroSensitivityRange / GyroSpan;
+
+			if (std::abs(Out.AccelNeutral[i]) > MaxAccelOrigin) continue;
+			const int AccelSpan = Out.AccelSensitivity[i] - Out.AccelNeutral[i];
+			if (!IsPlausibleSpan(AccelSpan, NominalAccelSensitivity)) continue;
+			Conversion.AccelOrigin[i] = Out.AccelNeutral[i];
+			Conversion.AccelScale[i] = AccelSensitivityRange / AccelSpan;
+		}
+	}
+
+	CalibrationReader::CalibrationReader() :
+		Tickets{},
+		Blocks{},
+		bRead{},
+		bIsLeft(false),
+		bActive(false) {
+	}
+
+	void CalibrationReader::Start(SubCommandChannel& Channel, const bool bInIsLeft) {
+		Cancel(Channel);
+		bIsLeft = bInIsLeft;
+		bActive = true;
+		const ControllerDecoders& Decoders = GetControllerDecoders(GetJoyConType(bIsLeft));
+		// Request every block up front so the reads are pipelined, the factory blocks are cheap to fetch even if unused
+		Tickets[UserStick] = Channel.SubmitSpiRead(Decoders.UserStickCalibration, 9);
+		Tickets[FactoryStick] = Channel.SubmitSpiRead(Decoders.FactoryStickCalibration, 9);
+		Tickets[StickParameters] = Channel.SubmitSpiRead(Decoders.StickParameters, 16);
+		Tickets[UserImu] = Channel.SubmitSpiRead(SpiAddress::UserImuCalibration, ImuCalibrationLength);
+		Tickets[FactoryImu] = Channel.SubmitSpiRead(SpiAddress::FactoryImuCalibration, ImuCalibrationLength);
+		for (int i = 0; i < BlockCount; ++i) {
+			bRead[i] = false;
+			// A read that could not be queued behaves like blank flash
+			if (Tickets[i] == 0) std::memset(Blocks[i], 0xff, MaxSpiReadLength);
+		}
+	}
+
+	bool CalibrationReader::Poll(SubCommandChannel& Channel, Calibration& Out) {
+		if (!bActive) return false;
+		uint8_t Reply[ReportLength];
+		for (int i = 0; i < BlockCount; ++i) {
+			if (Tickets[i] == 0) continue;
+			const SubCommandStatus Status = Channel.Poll(Tickets[i], Reply);
+			if (Status == SubCommandStatus::Pending) return false;
+			bRead[i] = Status == SubCommandStatus::Succeeded;
+			if (bRead[i]) std::memcpy(Blocks[i], &Reply[20], MaxSpiReadLength);
+			else std::memset(Blocks[i], 0xff, MaxSpiReadLength);
+			Tickets[i] = 0;
+		}
+		bActive = false;
+		Decode(Out);
+		return true;
+	}
+
+	bool CalibrationReader::Wait(SubCommandChannel& Channel, Calibration& Out) {
+		if (!bActive) return false;
+		for (int i = 0; i < BlockCount; ++i) {
+			if (Tickets[i] == 0) continue;
+			bRead[i] = Channel.WaitSpiRead(Tickets[i], Blocks[i], MaxSpiReadLength);
+			Tickets[i] = 0;
+		}
+		bActive = false;
+		Decode(Out);
+		return Succeeded();
+	}
+
+	void CalibrationReader::Cancel(SubCommandChannel& Channel) {
+		for (SubCommandChannel::Ticket& RequestTicket : Tickets) {
+			if (RequestTicket != 0) Channel.Cancel(RequestTicket);
+			RequestTicket = 0;
+		}
+		bActive = false;
+	}
+
+	bool CalibrationReader::Succeeded() const {
+		for (int i = 0; i < BlockCount; ++i) {
+			if (!bRead[i]) return false;
+		}
+		return true;
+	}
+
+	void CalibrationReader::Decode(Calibration& Out) const {
+		CalibrationBlocks Raw;
+		Raw.UserStick = Blocks[UserStick];
+		Raw.FactoryStick = Blocks[FactoryStick];
+		Raw.StickParameters = Blocks[StickParameters];
+		Raw.UserImu = Blocks[UserImu];
+		Raw.FactoryImu = Blocks[FactoryImu];
+		DecodeCalibration(Raw, bIsLeft, Out);
+	}
+
+	bool LoadCalibration(SubCommandChannel& Channel, const bool bIsLeft, Calibration& Out) {
+		CalibrationReader Reader;
+		Reader.Start(Channel, bIsLeft);
+		return Reader.Wait(Channel, Out);
+	}
+}
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConCoreTypes.h"
+#include "JoyConProtocol.h"
+#include "JoyConReport.h"
+
+namespace JoyCon {
+
+	namespace SpiAddress {
+		constexpr uint32_t FactoryImuCalibration = 0x6020;
+		constexpr uint32_t FactoryLeftStickCalibration = 0x603d;
+		constexpr uint32_t FactoryRightStickCalibration = 0x6046;
+		constexpr uint32_t LeftStickParameters = 0x6086;
+		constexpr uint32_t RightStickParameters = 0x6098;
+		constexpr uint32_t UserLeftStickCalibration = 0x8012;
+		constexpr uint32_t UserRightStickCalibration = 0x801d;
+		constexpr uint32_t UserImuCalibration = 0x8028;
+	}
+
+	struct StickCalibration {
+		/** Range above the center, per axis */
+		uint16_t Max[2];
+		uint16_t Center[2];
+		/** Range below the center, per axis */
+		uint16_t Min[2];
+		uint16_t DeadZone;
+	};
+
+	struct Calibration {
+		StickCalibration Stick;
+		int16_t GyroNeutral[3];
+		/** Accelerometer origin from the same IMU calibration block as the gyroscope origin */
+		int16_t AccelNeutral[3];
+		/** Raw sensitivity coefficients of the IMU block, nominally 16384 and 13371 */
+		int16_t AccelSensitivity[3];
+		int16_t GyroSensitivity[3];
+		bool bUserStickCalibration;
+		bool bUserGyroCalibration;
+		/** Derived from the fields above by ComputeImuConversion(), not stored */
+		ImuConversion Imu;
+	};
+
+	bool operator==(const StickCalibration& A, const StickCalibration& B);
+	bool operator==(const Calibration& A, const Calibration& B);
+	inline bool operator!=(const Calibration& A, const Calibration& B) { return !(A == B); }
+
+	/** Decodes the 9 byte stick calibration block, the left stick stores max/center/min and the right one center/min/max */
+	void DecodeStickCalibration(const uint8_t Block[9], bool bIsLeft, StickCalibration& Out);
+
+	/** Dead zone from the stick parameter block (0x6086 or 0x6098) */
+	uint16_t DecodeStickDeadZone(const uint8_t Parameters[5]);
+
+	/** A calibration block that was never written reads back as 0xff */
+	bool IsBlank(const uint8_t* Block, size_t Length);
+
+	/** Raw calibration blocks as stored in SPI flash, the IMU blocks are the full 24 bytes */
+	struct CalibrationBlocks {
+		const uint8_t* UserStick;
+		const uint8_t* FactoryStick;
+		const uint8_t* StickParameters;
+		const uint8_t* UserImu;
+		const uint8_t* FactoryImu;
+	};
+
+	/** Decodes the blocks, preferring user calibration when present */
+	void DecodeCalibration(const CalibrationBlocks& Blocks, bool bIsLeft, Calibration& Out);
+
+	/**
+	 * Folds origins and sensitivities into Out.Imu. An axis whose sensitivity is implausible, as on blank flash, keeps
+	 * the nominal scale, and so does the accelerometer origin if it is further than 0.25 g from zero.
+	 */
+	void ComputeImuConversion(Calibration& Out);
+
+	/**
+	 * Pipelined read of every calibration block. Wait() blocks like LoadCalibration(), Poll() never blocks so the
+	 * thread that reads the transport can drive the reads alongside input.
+	 */
+	class CalibrationReader {
+
+	public:
+		CalibrationReader();
+
+		/** Submits the SPI reads, any previous reads are cancelled */
+		void Start(SubCommandChannel& Channel, bool bInIsLeft);
+
+		/** Collects finished reads, returns true once all completed and Out has been decoded */
+		bool Poll(SubCommandChannel& Channel, Calibration& Out);
+
+		/** Blocks until all reads completed and decodes Out, returns Succeeded() */
+		bool Wait(SubCommandChannel& Channel, Calibration& Out);
+
+		/** Drops outstanding reads, replies arriving later are treated as input */
+		void Cancel(SubCommandChannel& Channel);
+
+		bool IsActive() const { return bActive; }
+
+		/** True if every block of the last decode was read, otherwise blanks were substituted */
+		bool Succeeded() const;
+
+	private:
+		enum Block {
+			UserStick,
+			FactoryStick,
+			StickParameters,
+			UserImu,
+			FactoryImu,
+			BlockCount
+		};
+
+		void Decode(Calibration& Out) const;
+
+	private:
+		SubCommandChannel::Ticket Tickets[BlockCount];
+		uint8_t Blocks[BlockCount][MaxSpiReadLength];
+		bool bRead[BlockCount];
+		bool bIsLeft;
+		bool bActive;
+	};
+
+	/**
+	 * Reads stick, dead zone and IMU calibration from SPI flash, preferring user calibration when present. Returns false
+	 * if a block could not be read.
+	 */
+	bool LoadCalibration(SubCommandChannel& Channel, bool bIsLeft, Calibration& Out);
+}
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConClock.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace JoyCon {
+
+	/** Host time needed before the period is estimated, shorter baselines are dominated by transport jitter */
+	static constexpr double DriftBaselineSeconds = 5.0;
+	/** Time constant the period follows the measured slope with */
+	static constexpr double DriftSeconds = 10.0;
+	/** Furthest the period may deviate from DeviceTimerPeriod, crystal drift is far below this */
+	static constexpr double MaxDrift = 0.05;
+	/** How fast the envelope rises, in seconds per host second, so a lost low point or a drifting fit is forgotten */
+	static constexpr double OffsetLeak = 0.001;
+
+	DeviceClock::DeviceClock() {
+		Reset();
+	}
+
+	void DeviceClock::Reset() {
+		bStarted = false;
+		LastTimer = 0;
+		Tick = 0;
+		LostReports = 0;
+		DuplicateReports = 0;
+		bHasHost = false;
+		LastHostSeconds = 0.0;
+		FirstTick = 0;
+		FirstHostSeconds = 0.0;
+		BaseTick = 0;
+		BaseHostSeconds = 0.0;
+		Period = DeviceTimerPeriod;
+		Offset = 0.0;
+	}
+
+	uint64_t DeviceClock::Observe(const uint8_t Timer, const double HostSeconds) {
+		if (!bStarted) {
+			bStarted = true;
+			LastTimer = Timer;
+			Tick = Timer;
+			if (HostSeconds >= 0.0) UpdateFit(HostSeconds);
+			return Tick;
+		}
+		int64_t DeltaTicks = static_cast<uint8_t>(Timer - LastTimer);
+		LastTimer = Timer;
+		if (bHasHost && HostSeconds >= 0.0) {
+			// The host clock tells how many times the timer wrapped in between, and whether it stepped back
+			const double ExpectedTicks = (HostSeconds - LastHostSeconds) / Period;
+			DeltaTicks += 0x100 * static_cast<int64_t>(std::floor((ExpectedTicks - static_cast<double>(DeltaTicks)) / 0x100 + 0.5));
+		} else if (DeltaTicks >= 0x80) {
+			DeltaTicks -= 0x100;
+		}
+		if (DeltaTicks == 0) {
+			++DuplicateReports;
+		} else if (DeltaTicks > ImuSamplesPerReport + 1) {
+			LostReports += static_cast<uint64_t>((DeltaTicks + ImuSamplesPerReport / 2) / ImuSamplesPerReport - 1);
+		}
+		// The timer can step back right after wrapping, never let time run backwards
+		if (DeltaTicks > 0) Tick += static_cast<uint64_t>(DeltaTicks);
+		if (HostSeconds >= 0.0) UpdateFit(HostSeconds);
+		return Tick;
+	}
+
+	double DeviceClock::ToHostSeconds(const uint64_t AtTick) const {
+		if (!bHasHost) return 0.0;
+		return BaseHostSeconds + (static_cast<double>(AtTick) - static_cast<double>(BaseTick)) * Period + Offset;
+	}
+
+	void DeviceClock::UpdateFit(const double HostSeconds) {
+		if (!bHasHost) {
+			bHasHost = true;
+			LastHostSeconds = HostSeconds;
+			FirstTick = BaseTick = Tick;
+			FirstHostSeconds = BaseHostSeconds = HostSeconds;
+			Offset = 0.0;
+			return;
+		}
+		const double ElapsedSeconds = std::max(HostSeconds - LastHostSeconds, 0.0);
+		LastHostSeconds = HostSeconds;
+		const double BaselineSeconds = HostSeconds - FirstHostSeconds;
+		if (BaselineSeconds >= DriftBaselineSeconds && Tick > FirstTick) {
+			const double Measured = std::min(std::max(BaselineSeconds / static_cast<double>(Tick - FirstTick),
+				DeviceTimerPeriod * (1.0 - MaxDrift)), DeviceTimerPeriod * (1.0 + MaxDrift));
+			// Rebase at this tick so the line pivots here instead of jumping
+			BaseHostSeconds += (static_cast<double>(Tick) - static_cast<double>(BaseTick)) * Period;
+			BaseTick = Tick;
+			Period += (Measured - Period) * std::min(ElapsedSeconds / DriftSeconds, 1.0);
+		}
+		const double Residual = HostSeconds - (BaseHostSeconds + (static_cast<double>(Tick) - static_cast<double>(BaseTick)) * Period);
+		Offset = std::min(Offset + ElapsedSeconds * OffsetLeak, Residual);
+	}
+}
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConCoreTypes.h"
+
+namespace JoyCon {
+
+	/**
+	 * Timeline of one controller. Unwraps the 8 bit timer of the input reports into a 64 bit tick count and fits
+	 * the host time of every tick as a line, Host = Offset + Tick * Period. Transport delays only ever make a report
+	 * late, so the offset follows the lower envelope of the arrival times instead of their mean, and the period is
+	 * taken from the slope over a long baseline, which absorbs the drift between the device and host clocks.
+	 */
+	class DeviceClock {
+	public:
+		DeviceClock();
+
+		void Reset();
+
+		/**
+		 * Unwraps the timer byte of a report and returns its tick, never less than the previous one. HostSeconds is
+		 * the monotonic host time the report was read at, or negative if unknown. It refines the fit and resolves
+		 * gaps longer than the 1.28 s it takes the timer to wrap.
+		 */
+		uint64_t Observe(uint8_t Timer, double HostSeconds = -1.0);
+
+		/** Tick of the last observed report */
+		uint64_t GetTick() const { return Tick; }
+
+		/** Whether any report came with a host time */
+		bool HasHostFit() const { return bHasHost; }
+
+		/** Host seconds at which the device reached Tick, 0 until a report came with a host time */
+		double ToHostSeconds(uint64_t Tick) const;
+
+		/** Fitted host seconds per device tick, DeviceTimerPeriod until enough host time has been observed */
+		double GetTickPeriod() const { return Period; }
+
+		/** Reports missing from the timeline, each report advances the timer by about ImuSamplesPerReport ticks */
+		uint64_t GetLostReports() const { return LostReports; }
+
+		/** Reports that repeated the timer of the previous one */
+		uint64_t GetDuplicateReports() const { return DuplicateReports; }
+
+	private:
+		void UpdateFit(double HostSeconds);
+
+		bool bStarted;
+		uint8_t LastTimer;
+		uint64_t Tick;
+		uint64_t LostReports;
+		uint64_t DuplicateReports;
+
+		bool bHasHost;
+		double LastHostSeconds;
+		/** First observation with a host time, the baseline of the period estimate */
+		uint64_t FirstTick;
+		double FirstHostSeconds;
+		/** Point the line passes through before Offset, moved whenever the period changes so the fit stays continuous */
+		uint64_t BaseTick;
+		double BaseHostSeconds;
+		double Period;
+		/** Lower envelope of the arrival times around the line */
+		double Offset;
+	};
+}
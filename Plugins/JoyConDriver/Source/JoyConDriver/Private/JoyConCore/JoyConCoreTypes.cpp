@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConCoreTypes.h"
+
+#include <cmath>
+
+namespace JoyCon {
+
+	Vector3 Vector3::GetSafeNormal() const {
+		const float SquareSum = X * X + Y * Y + Z * Z;
+		if (SquareSum == 1.0f) return *this;
+		if (SquareSum < 1.e-8f) return Vector3();
+		const float Scale = 1.0f / std::sqrt(SquareSum);
+		return Vector3(X * Scale, Y * Scale, Z * Scale);
+	}
+}
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Engine-agnostic Joy-Con protocol core. Everything under JoyConCore is plain C++14, the standard Unreal 4.25 builds
+ * the module with, without exceptions or RTTI. It builds both as part of the JoyConDriver module and standalone
+ * through its CMakeLists.txt, which uses the same standard.
+ */
+namespace JoyCon {
+
+	/** Size of every input and output report exchanged with a Joy-Con over Bluetooth */
+	constexpr size_t ReportLength = 49;
+
+	/** Number of IMU samples carried by each 0x30 report, 5 ms apart */
+	constexpr int ImuSamplesPerReport = 3;
+
+	/** Seconds per tick of the device timer in report byte 1 */
+	constexpr float DeviceTimerPeriod = 0.005f;
+
+	/** Same order as EJoyConControllerButton so the adapter can copy states directly */
+	enum class Button : int {
+		DPad_Up,
+		DPad_Left,
+		DPad_Right,
+		DPad_Down,
+
+		Minus,
+		Plus,
+		Home,
+		Capture,
+
+		Left_ThumbStick,
+
+		Sr,
+		Sl,
+
+		L,
+		Zl,
+
+		Count
+	};
+
+	constexpr int ButtonCount = static_cast<int>(Button::Count);
+
+	struct Vector3 {
+		float X;
+		float Y;
+		float Z;
+
+		constexpr Vector3() : X(0.0f), Y(0.0f), Z(0.0f) {
+		}
+
+		constexpr Vector3(const float InX, const float InY, const float InZ) : X(InX), Y(InY), Z(InZ) {
+		}
+
+		Vector3 operator+(const Vector3& V) const { return Vector3(X + V.X, Y + V.Y, Z + V.Z); }
+		Vector3 operator-(const Vector3& V) const { return Vector3(X - V.X, Y - V.Y, Z - V.Z); }
+		Vector3 operator*(const float Scale) const { return Vector3(X * Scale, Y * Scale, Z * Scale); }
+		Vector3 operator/(const float Scale) const { const float Inv = 1.0f / Scale; return Vector3(X * Inv, Y * Inv, Z * Inv); }
+		Vector3 operator-() const { return Vector3(-X, -Y, -Z); }
+		Vector3& operator+=(const Vector3& V) { X += V.X; Y += V.Y; Z += V.Z; return *this; }
+
+		float& operator[](const int Index) { return Index == 0 ? X : (Index == 1 ? Y : Z); }
+		float operator[](const int Index) const { return Index == 0 ? X : (Index == 1 ? Y : Z); }
+
+		static float Dot(const Vector3& A, const Vector3& B) {
+			return A.X * B.X + A.Y * B.Y + A.Z * B.Z;
+		}
+
+		static Vector3 Cross(const Vector3& A, const Vector3& B) {
+			return Vector3(A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X);
+		}
+
+		/** Unit vector, or zero if the vector is too small to normalize (matches FVector::GetSafeNormal) */
+		Vector3 GetSafeNormal() const;
+	};
+
+	inline Vector3 operator*(const float Scale, const Vector3& V) {
+		return V * Scale;
+	}
+
+	struct Quaternion {
+		float X;
+		float Y;
+		float Z;
+		float W;
+
+		constexpr Quaternion() : X(0.0f), Y(0.0f), Z(0.0f), W(1.0f) {
+		}
+
+		constexpr Quaternion(const float InX, const float InY, const float InZ, const float InW) : X(InX), Y(InY), Z(InZ), W(InW) {
+		}
+
+		/** Hamilton product, the rotation Q is applied first */
+		Quaternion operator*(const Quaternion& Q) const {
+			return Quaternion(
+				W * Q.X + X * Q.W + Y * Q.Z - Z * Q.Y,
+				W * Q.Y - X * Q.Z + Y * Q.W + Z * Q.X,
+				W * Q.Z + X * Q.Y - Y * Q.X + Z * Q.W,
+				W * Q.W - X * Q.X - Y * Q.Y - Z * Q.Z);
+		}
+	};
+
+	/**
+	 * Transport for one controller, following the hidapi contract: Read returns the number of bytes read, 0 on
+	 * timeout and -1 on error, a negative timeout blocks, and Write returns the number of bytes written or -1.
+	 */
+	class ITransport {
+
+	public:
+		virtual ~ITransport() {}
+
+		virtual int Read(uint8_t* Data, size_t Length, int Milliseconds) = 0;
+		virtual int Write(const uint8_t* Data, size_t Length) = 0;
+	};
+}
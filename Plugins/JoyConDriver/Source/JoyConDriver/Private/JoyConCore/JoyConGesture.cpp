@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConGesture.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace JoyCon {
+
+	/** Gaps in the stream longer than this abandon the gesture in progress, its peak may have been lost */
+	static constexpr float MaxGapSeconds = 0.1f;
+	/** Time constant of the running acceleration mean shake strokes are measured against */
+	static constexpr float AccelMeanSeconds = 0.5f;
+	/** A swing is reported once the speed fell to this fraction of its peak, without waiting for the arm to stop */
+	static constexpr float SwingReleaseFraction = 0.5f;
+
+	// Out of line definition for C++14, where std::min binding a reference to it needs storage
+	constexpr int GestureRecognizer::ReversalCapacity;
+
+	GestureRecognizer::GestureRecognizer(const GestureSettings& InSettings) : Settings(InSettings) {
+		Reset();
+	}
+
+	void GestureRecognizer::SetSettings(const GestureSettings& InSettings) {
+		Settings = InSettings;
+		Reset();
+	}
+
+	void GestureRecognizer::Reset() {
+		bFirstSample = true;
+		LastTick = 0;
+		Seconds = 0.0;
+		bRotating = false;
+		bSwingSent = false;
+		RotationSeconds = 0.0f;
+		PeakSpeed = 0.0f;
+		Rotation = Vector3();
+		RotationReadyAt = 0.0;
+		AccelMean = Vector3();
+		std::fill(LastStroke, LastStroke + 3, static_cast<int8_t>(0));
+		std::fill(Reversals, Reversals + ReversalCapacity, 0.0);
+		ReversalHead = 0;
+		ReversalCount = 0;
+		ShakePeak = 0.0f;
+		bShaking = false;
+	}
+
+	int GestureRecognizer::Update(const ImuSample& Sample, const uint64_t Tick, GestureEvent Out[MaxGestureEventsPerSample]) {
+		if (bFirstSample) {
+			bFirstSample = false;
+			LastTick = Tick;
+			AccelMean = Sample.Accelerometer;
+			return 0;
+		}
+		if (Tick <= LastTick) return 0;
+		const float DeltaSeconds = DeviceTimerPeriod * static_cast<float>(Tick - LastTick);
+		LastTick = Tick;
+		Seconds += DeltaSeconds;
+		if (DeltaSeconds > MaxGapSeconds) {
+			bRotating = false;
+			bShaking = false;
+			ReversalHead = 0;
+			ReversalCount = 0;
+			std::fill(LastStroke, LastStroke + 3, static_cast<int8_t>(0));
+			AccelMean = Sample.Accelerometer;
+			return 0;
+		}
+		int Count = 0;
+		if (UpdateRotation(Sample.Gyroscope, DeltaSeconds, Tick, Out[Count])) Count++;
+		if (UpdateShake(Sample.Accelerometer, DeltaSeconds, Tick, Out[Count])) Count++;
+		return Count;
+	}
+
+	bool GestureRecognizer::UpdateRotation(const Vector3& Gyroscope, const float DeltaSeconds, const uint64_t Tick, GestureEvent& Out) {
+		const float Speed = std::sqrt(Vector3::Dot(Gyroscope, Gyroscope));
+		if (!bRotating) {
+			if (Speed < Settings.OnsetSpeed || Seconds < RotationReadyAt) return false;
+			bRotating = true;
+			bSwingSent = false;
+			RotationSeconds = 0.0f;
+			PeakSpeed = Speed;
+			Rotation = Gyroscope * DeltaSeconds;
+			return false;
+		}
+		RotationSeconds += DeltaSeconds;
+		Rotation += Gyroscope * DeltaSeconds;
+		PeakSpeed = std::max(PeakSpeed, Speed);
+		Out = { GestureType::Swing, FlickDirection::None, PeakSpeed, Tick };
+		if (Speed >= 0.5f * Settings.OnsetSpeed) {
+			// Past its peak a long rotation can only be a swing, report it while the arm is still moving
+			if (bSwingSent || RotationSeconds <= Settings.FlickMaxSeconds || PeakSpeed < Settings.SwingSpeed || Speed > PeakSpeed * SwingReleaseFraction) return false;
+			bSwingSent = true;
+			return true;
+		}
+		bRotating = false;
+		RotationReadyAt = Seconds + Settings.CooldownSeconds;
+		if (bSwingSent) return false;
+		if (RotationSeconds > Settings.FlickMaxSeconds) return PeakSpeed >= Settings.SwingSpeed;
+		if (PeakSpeed < Settings.FlickSpeed) return false;
+		// A wrist snap pitches or yaws the controller, a twist about its long axis is not a flick
+		const float Pitch = Rotation.Y;
+		const float Yaw = Rotation.Z;
+		if (std::fabs(Rotation.X) > std::max(std::fabs(Pitch), std::fabs(Yaw))) return false;
+		Out.Type = GestureType::Flick;
+		if (std::fabs(Pitch) >= std::fabs(Yaw)) Out.Direction = Pitch > 0.0f ? FlickDirection::Up : FlickDirection::Down;
+		else Out.Direction = Yaw > 0.0f ? FlickDirection::Left : FlickDirection::Right;
+		return true;
+	}
+
+	bool GestureRecognizer::UpdateShake(const Vector3& Accelerometer, const float DeltaSeconds, const uint64_t Tick, GestureEvent& Out) {
+		const Vector3 Deviation = Accelerometer - AccelMean;
+		AccelMean += Deviation * std::min(DeltaSeconds / AccelMeanSeconds, 1.0f);
+		for (int i = 0; i < 3; ++i) {
+			if (std::fabs(Deviation[i]) < Settings.ShakeAcceleration) continue;
+			const int8_t Stroke = Deviation[i] > 0.0f ? 1 : -1;
+			if (LastStroke[i] != 0 && LastStroke[i] != Stroke) {
+				Reversals[ReversalHead] = Seconds;
+				ReversalHead = (ReversalHead + 1) % ReversalCapacity;
+				ReversalCount = std::min(ReversalCount + 1, ReversalCapacity);
+			}
+			LastStroke[i] = Stroke;
+			ShakePeak = std::max(ShakePeak, std::fabs(Deviation[i]));
+		}
+		int Recent = 0;
+		for (int n = 0; n < ReversalCount; ++n) {
+			if (Seconds - Reversals[n] <= Settings.ShakeWindowSeconds) Recent++;
+		}
+		if (Recent == 0) {
+			ShakePeak = 0.0f;
+			bShaking = false;
+		}
+		// Shaking on and on is one gesture, the next one needs a window without reversals first
+		if (bShaking || Recent < Settings.ShakeReversals) return false;
+		Out = { GestureType::Shake, FlickDirection::None, ShakePeak, Tick };
+		bShaking = true;
+		return true;
+	}
+}
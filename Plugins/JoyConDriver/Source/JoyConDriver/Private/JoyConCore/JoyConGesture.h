@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConReport.h"
+
+namespace JoyCon {
+
+	enum class GestureType : uint8_t {
+		/** Long, fast rotation of the whole arm */
+		Swing,
+		/** Back and forth acceleration along one axis */
+		Shake,
+		/** Short snap of the wrist that stops right away */
+		Flick
+	};
+
+	/** Direction of a flick in the controller's own axes, pitch about Y and yaw about Z */
+	enum class FlickDirection : uint8_t {
+		None,
+		Up,
+		Down,
+		Left,
+		Right
+	};
+
+	struct GestureEvent {
+		GestureType Type;
+		/** Flicks only, None for the other gestures */
+		FlickDirection Direction;
+		/** Peak angular speed in rad/s for swings and flicks, peak acceleration off the running mean in g for shakes */
+		float Magnitude;
+		/** Tick of the sample that completed the gesture */
+		uint64_t Tick;
+	};
+
+	/** Thresholds of GestureRecognizer, the defaults suit a Joy-Con held in one hand */
+	struct GestureSettings {
+		/** Angular speed in rad/s that starts a rotation gesture, it ends below half of it */
+		float OnsetSpeed = 5.0f;
+		/** Peak angular speed in rad/s a swing has to reach */
+		float SwingSpeed = 10.0f;
+		/** Peak angular speed in rad/s a flick has to reach */
+		float FlickSpeed = 6.0f;
+		/** Longest rotation still taken as a flick, anything longer is a swing */
+		float FlickMaxSeconds = 0.15f;
+		/** Acceleration in g off the running mean that counts as a shake stroke */
+		float ShakeAcceleration = 1.5f;
+		/** Direction reversals within ShakeWindowSeconds that make a shake */
+		int ShakeReversals = 4;
+		float ShakeWindowSeconds = 0.8f;
+		/** Quiet time after a rotation gesture before the next one, so the wrist springing back is not reported */
+		float CooldownSeconds = 0.2f;
+	};
+
+	/** Most events a single sample can complete, one rotation gesture and one shake */
+	constexpr int MaxGestureEventsPerSample = 2;
+
+	/**
+	 * Recognizes swings, shakes and flicks in the full rate IMU stream of one controller. All state is fixed size,
+	 * so it can run on the polling thread for every sample, and events are reported on the sample that completes
+	 * them rather than when a frame happens to look.
+	 */
+	class GestureRecognizer {
+	public:
+		explicit GestureRecognizer(const GestureSettings& InSettings = GestureSettings());
+
+		void SetSettings(const GestureSettings& InSettings);
+		const GestureSettings& GetSettings() const { return Settings; }
+
+		void Reset();
+
+		/** Feeds the sample taken at Tick, returns the number of events written to Out */
+		int Update(const ImuSample& Sample, uint64_t Tick, GestureEvent Out[MaxGestureEventsPerSample]);
+
+	private:
+		static constexpr int ReversalCapacity = 8;
+
+		bool UpdateRotation(const Vector3& Gyroscope, float DeltaSeconds, uint64_t Tick, GestureEvent& Out);
+		bool UpdateShake(const Vector3& Accelerometer, float DeltaSeconds, uint64_t Tick, GestureEvent& Out);
+
+		GestureSettings Settings;
+		bool bFirstSample;
+		uint64_t LastTick;
+		/** Device seconds since the first sample */
+		double Seconds;
+
+		bool bRotating;
+		bool bSwingSent;
+		float RotationSeconds;
+		float PeakSpeed;
+		/** Rotation integrated since the gesture started, its dominant axis gives a flick's direction */
+		Vector3 Rotation;
+		double RotationReadyAt;
+
+		Vector3 AccelMean;
+		int8_t LastStroke[3];
+		/** Times of the latest stroke reversals, oldest overwritten first */
+		double Reversals[ReversalCapacity];
+		int ReversalHead;
+		int ReversalCount;
+		float ShakePeak;
+		/** Set once a shake was reported until the reversals stop */
+		bool bShaking;
+	};
+}
@@ -0,0 +1,371 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConImuFusion.h"
+
+#include "JoyConImuKernel.h"
+#include "JoyConProtocol.h"
+
+#include <cmath>
+
+namespace JoyCon {
+
+	/**
+	 * Longest step a sample is integrated over. The clock knows how long an outage lasted, but the rates before it are
+	 * unknown, so the first sample after one is stepped like a contiguous sample instead.
+	 */
+	static constexpr float MaxSampleGapSeconds = 0.1f;
+
+	/** Time the sample after DeltaTicks ticks is integrated over, see MaxSampleGapSeconds */
+	static float GetSampleStep(const uint64_t DeltaTicks, const float TickPeriod) {
+		const float DeltaSeconds = TickPeriod * static_cast<float>(DeltaTicks);
+		return DeltaSeconds > MaxSampleGapSeconds ? TickPeriod : DeltaSeconds;
+	}
+
+	BasisOrientationFilter::BasisOrientationFilter() :
+		I(1, 0, 0),
+		J(0, 1, 0),
+		K(0, 0, 1),
+		FilterWeight(0),
+		bFirstSample(true) {
+	}
+
+	void BasisOrientationFilter::Reset() {
+		bFirstSample = true;
+	}
+
+	void BasisOrientationFilter::SetFilterWeight(const float InFilterWeight) {
+		FilterWeight = InFilterWeight;
+	}
+
+	void BasisOrientationFilter::Update(const ImuSample& Sample, const float DeltaSeconds) {
+		if (bFirstSample) {
+			I = Vector3(1, 0, 0);
+			J = Vector3(0, 1, 0);
+			K = Vector3(0, 0, 1);
+			bFirstSample = false;
+			return;
+		}
+		const Vector3 KAcc = -Sample.Accelerometer.GetSafeNormal();
+		const Vector3 Wa = Vector3::Cross(K, KAcc);
+		const Vector3 Wg = -Sample.Gyroscope * DeltaSeconds;
+		const Vector3 DTheta = (FilterWeight * Wa + Wg) / (1.f + FilterWeight);
+		K += Vector3::Cross(DTheta, K);
+		I += Vector3::Cross(DTheta, I);
+		J += Vector3::Cross(DTheta, J);
+		// Correction, ensure new axes are orthogonal
+		const float Err = Vector3::Dot(I, J) * 0.5f;
+		const Vector3 I2 = (I - Err * J).GetSafeNormal();
+		J = (J - Err * I).GetSafeNormal();
+		I = I2;
+		K = Vector3::Cross(I, J);
+	}
+
+	Quaternion BasisOrientationFilter::GetOrientation() const {
+		Vector3 Forward = Vector3(J.X, I.X, K.X);
+		Vector3 Up = -Vector3(J.Z, I.Z, K.Z);
+
+		Forward = Forward.GetSafeNormal();
+		Up = Up - (Forward * Vector3::Dot(Up, Forward));
+		Up = Up.GetSafeNormal();
+
+		const Vector3 AxisX = Forward.GetSafeNormal();
+		const Vector3 AxisY = Vector3::Cross(Up, AxisX);
+		const Vector3 AxisZ = Vector3::Cross(AxisX, AxisY);
+		const float M00 = AxisX.X;
+		const float M01 = AxisX.Y;
+		const float M02 = AxisX.Z;
+		const float M10 = AxisY.X;
+		const float M11 = AxisY.Y;
+		const float M12 = AxisY.Z;
+		const float M20 = AxisZ.X;
+		const float M21 = AxisZ.Y;
+		const float M22 = AxisZ.Z;
+
+		const float Trace = (M00 + M11) + M22;
+		Quaternion Result;
+
+		if (Trace > 0.0f) {
+			float Num = std::sqrt(Trace + 1.0f);
+			Result.W = Num * 0.5f;
+			Num = 0.5f / Num;
+			Result.X = (M12 - M21) * Num;
+			Result.Y = (M20 - M02) * Num;
+			Result.Z = (M01 - M10) * Num;
+			return Result;
+		}
+
+		if ((M00 >= M11) && (M00 >= M22)) {
+			const float Num = std::sqrt(((1.0f + M00) - M11) - M22);
+			const float Inv = 0.5f / Num;
+			Result.X = 0.5f * Num;
+			Result.Y = (M01 + M10) * Inv;
+			Result.Z = (M02 + M20) * Inv;
+			Result.W = (M12 - M21) * Inv;
+			return Result;
+		}
+
+		if (M11 > M22) {
+			const float Num = std::sqrt(((1.0f + M11) - M00) - M22);
+			const float Inv = 0.5f / Num;
+			Result.X = (M10 + M01) * Inv;
+			Result.Y = 0.5f * Num;
+			Result.Z = (M21 + M12) * Inv;
+			Result.W = (M20 - M02) * Inv;
+			return Result;
+		}
+
+		const float Num = std::sqrt(((1.0f + M22) - M00) - M11);
+		const float Inv = 0.5f / Num;
+		Result.X = (M20 + M02) * Inv;
+		Result.Y = (M21 + M12) * Inv;
+		Result.Z = 0.5f * Num;
+		Result.W = (M01 - M10) * Inv;
+		return Result;
+	}
+
+	// The basis filter reports forward as world Y and up as -Z; in quaternion terms that is a half turn about
+	// (1, 1, 0) after mirroring the device frame through its XY plane
+	static constexpr float InvSqrt2 = 0.70710678f;
+	static constexpr Quaternion UnrealAxes(InvSqrt2, InvSqrt2, 0.0f, 0.0f);
+
+	QuaternionOrientationFilter::QuaternionOrientationFilter(const OrientationFilterType InType) :
+		Type(InType),
+		Gain(0),
+		bFirstSample(true) {
+	}
+
+	void QuaternionOrientationFilter::Reset() {
+		bFirstSample = true;
+	}
+
+	void QuaternionOrientationFilter::SetType(const OrientationFilterType InType) {
+		Type = InType;
+	}
+
+	void QuaternionOrientationFilter::SetGain(const float InGain) {
+		Gain = InGain;
+	}
+
+	void QuaternionOrientationFilter::Update(const ImuSample& Sample, const float DeltaSeconds) {
+		if (bFirstSample) {
+			State = Quaternion();
+			bFirstSample = false;
+			return;
+		}
+		float Q0 = State.W, Q1 = State.X, Q2 = State.Y, Q3 = State.Z;
+		float Gx = Sample.Gyroscope.X, Gy = Sample.Gyroscope.Y, Gz = Sample.Gyroscope.Z;
+		// The world Z axis follows the negated acceleration, like K in the basis filter
+		float Ax = -Sample.Accelerometer.X, Ay = -Sample.Accelerometer.Y, Az = -Sample.Accelerometer.Z;
+		const float SquareNorm = Ax * Ax + Ay * Ay + Az * Az;
+		const bool bCorrect = Gain > 0.0f && SquareNorm > 1.e-8f;
+		if (bCorrect) {
+			const float InvNorm = 1.0f / std::sqrt(SquareNorm);
+			Ax *= InvNorm;
+			Ay *= InvNorm;
+			Az *= InvNorm;
+		}
+		if (bCorrect && Type == OrientationFilterType::Mahony) {
+			// Error between measured and estimated world Z, fed back into the rate
+			const float Vx = 2.0f * (Q1 * Q3 - Q0 * Q2);
+			const float Vy = 2.0f * (Q0 * Q1 + Q2 * Q3);
+			const float Vz = Q0 * Q0 - Q1 * Q1 - Q2 * Q2 + Q3 * Q3;
+			Gx += Gain * (Ay * Vz - Az * Vy);
+			Gy += Gain * (Az * Vx - Ax * Vz);
+			Gz += Gain * (Ax * Vy - Ay * Vx);
+		}
+		float Dq0 = 0.5f * (-Q1 * Gx - Q2 * Gy - Q3 * Gz);
+		float Dq1 = 0.5f * (Q0 * Gx + Q2 * Gz - Q3 * Gy);
+		float Dq2 = 0.5f * (Q0 * Gy - Q1 * Gz + Q3 * Gx);
+		float Dq3 = 0.5f * (Q0 * Gz + Q1 * Gy - Q2 * Gx);
+		if (bCorrect && Type != OrientationFilterType::Mahony) {
+			// Gradient of the gravity objective function, one descent step of length Gain
+			const float S0 = 4.0f * Q0 * Q2 * Q2 + 2.0f * Q2 * Ax + 4.0f * Q0 * Q1 * Q1 - 2.0f * Q1 * Ay;
+			const float S1 = 4.0f * Q1 * Q3 * Q3 - 2.0f * Q3 * Ax + 4.0f * Q0 * Q0 * Q1 - 2.0f * Q0 * Ay - 4.0f * Q1 + 8.0f * Q1 * Q1 * Q1 + 8.0f * Q1 * Q2 * Q2 + 4.0f * Q1 * Az;
+			const float S2 = 4.0f * Q0 * Q0 * Q2 + 2.0f * Q0 * Ax + 4.0f * Q2 * Q3 * Q3 - 2.0f * Q3 * Ay - 4.0f * Q2 + 8.0f * Q2 * Q1 * Q1 + 8.0f * Q2 * Q2 * Q2 + 4.0f * Q2 * Az;
+			const float S3 = 4.0f * Q1 * Q1 * Q3 - 2.0f * Q1 * Ax + 4.0f * Q2 * Q2 * Q3 - 2.0f * Q2 * Ay;
+			const float StepNorm = S0 * S0 + S1 * S1 + S2 * S2 + S3 * S3;
+			if (StepNorm > 1.e-12f) {
+				const float Scale = Gain / std::sqrt(StepNorm);
+				Dq0 -= Scale * S0;
+				Dq1 -= Scale * S1;
+				Dq2 -= Scale * S2;
+				Dq3 -= Scale * S3;
+			}
+		}
+		Q0 += Dq0 * DeltaSeconds;
+		Q1 += Dq1 * DeltaSeconds;
+		Q2 += Dq2 * DeltaSeconds;
+		Q3 += Dq3 * DeltaSeconds;
+		const float InvNorm = 1.0f / std::sqrt(Q0 * Q0 + Q1 * Q1 + Q2 * Q2 + Q3 * Q3);
+		State = Quaternion(Q1 * InvNorm, Q2 * InvNorm, Q3 * InvNorm, Q0 * InvNorm);
+	}
+
+	Quaternion QuaternionOrientationFilter::GetOrientation() const {
+		return UnrealAxes * Quaternion(-State.X, -State.Y, State.Z, State.W);
+	}
+
+	// Stillness thresholds, a resting Joy-Con shows a few counts of noise on each axis
+	static constexpr float StillGyroVariance = 4e-4f;
+	static constexpr float StillAccelVariance = 1e-4f;
+	static constexpr float StillAccelTolerance = 0.05f;
+	// A slow steady rotation looks like bias, rates above this are never taken as one
+	static constexpr float MaxGyroBias = 0.05f;
+
+	GyroBiasEstimator::GyroBiasEstimator() {
+		Reset();
+	}
+
+	void GyroBiasEstimator::Reset() {
+		Bias = Vector3();
+		ObservedSeconds = 0.0f;
+		StillSeconds = 0.0f;
+		bFirstSample = true;
+	}
+
+	bool GyroBiasEstimator::Update(const ImuSample& Sample, const float DeltaSeconds) {
+		const Vector3& Gyro = Sample.Gyroscope;
+		const float Accel = std::sqrt(Vector3::Dot(Sample.Accelerometer, Sample.Accelerometer));
+		// Stillness cannot be vouched for across a gap, restart the window
+		if (bFirstSample || DeltaSeconds > WindowSeconds) {
+			GyroMean = Gyro;
+			GyroVariance = Vector3(StillGyroVariance, StillGyroVariance, StillGyroVariance);
+			AccelMean = Accel;
+			AccelVariance = StillAccelVariance;
+			StillSeconds = 0.0f;
+			bFirstSample = false;
+			return false;
+		}
+
+		const float Alpha = DeltaSeconds / WindowSeconds;
+		for (int i = 0; i < 3; ++i) {
+			const float Delta = Gyro[i] - GyroMean[i];
+			GyroMean[i] += Alpha * Delta;
+			GyroVariance[i] = (1.0f - Alpha) * (GyroVariance[i] + Alpha * Delta * Delta);
+		}
+		const float AccelDelta = Accel - AccelMean;
+		AccelMean += Alpha * AccelDelta;
+		AccelVariance = (1.0f - Alpha) * (AccelVariance + Alpha * AccelDelta * AccelDelta);
+
+		const bool bStill = GyroVariance.X < StillGyroVariance && GyroVariance.Y < StillGyroVariance && GyroVariance.Z < StillGyroVariance
+			&& AccelVariance < StillAccelVariance && std::fabs(AccelMean - 1.0f) < StillAccelTolerance
+			&& std::fabs(GyroMean.X) < MaxGyroBias && std::fabs(GyroMean.Y) < MaxGyroBias && std::fabs(GyroMean.Z) < MaxGyroBias;
+		if (!bStill) {
+			StillSeconds = 0.0f;
+			ObservedSeconds *= 1.0f - (DeltaSeconds < ForgetSeconds ? DeltaSeconds / ForgetSeconds : 1.0f);
+			return false;
+		}
+
+		StillSeconds += DeltaSeconds;
+		if (StillSeconds < SettleSeconds) return false;
+		// Plain average over the first observations, then a moving one that follows the drift
+		ObservedSeconds += DeltaSeconds;
+		const float Cumulative = DeltaSeconds / ObservedSeconds;
+		const float Moving = DeltaSeconds / BiasSeconds;
+		Bias += (GyroMean - Bias) * (Cumulative > Moving ? Cumulative : Moving);
+		return true;
+	}
+
+	float GyroBiasEstimator::GetConfidence() const {
+		return ObservedSeconds / (ObservedSeconds + ConfidenceSeconds);
+	}
+
+	ImuProcessor::ImuProcessor() :
+		FilterType(OrientationFilterType::Madgwick),
+		Tick(0),
+		bEstimateGyroBias(true) {
+	}
+
+	bool ImuProcessor::ProcessReport(const uint8_t* Report, const ImuConversion& Conversion) {
+		TimedImuSample Samples[ImuSamplesPerReport];
+		return ProcessReport(Report, Conversion, Samples) > 0;
+	}
+
+	int ImuProcessor::ProcessReport(const uint8_t* Report, const ImuConversion& Conversion, TimedImuSample Out[ImuSamplesPerReport], const double HostSeconds) {
+		uint64_t PreviousTick = Tick;
+		const int Count = DecodeReport(Report, Conversion, Out, HostSeconds);
+		const float TickPeriod = static_cast<float>(Clock.GetTickPeriod());
+		for (int n = 0; n < Count; ++n) {
+			const float DeltaSeconds = GetSampleStep(Out[n].Tick - PreviousTick, TickPeriod);
+			if (FilterType == OrientationFilterType::Basis) Filter.Update(Out[n].Sample, DeltaSeconds);
+			else QuaternionFilter.Update(Out[n].Sample, DeltaSeconds);
+			PreviousTick = Out[n].Tick;
+		}
+		return Count;
+	}
+
+	void ImuProcessor::ResetClock() {
+		Clock.Reset();
+		Tick = 0;
+	}
+
+	void ImuProcessor::SetFilterType(const OrientationFilterType Type) {
+		if (Type == FilterType) return;
+		FilterType = Type;
+		QuaternionFilter.SetType(Type);
+		ResetOrientation();
+	}
+
+	void ImuProcessor::SetFilterGain(const float Gain) {
+		Filter.SetFilterWeight(Gain);
+		QuaternionFilter.SetGain(Gain);
+	}
+
+	void ImuProcessor::ResetOrientation() {
+		Filter.Reset();
+		QuaternionFilter.Reset();
+	}
+
+	Quaternion ImuProcessor::GetOrientation() const {
+		return FilterType == OrientationFilterType::Basis ? Filter.GetOrientation() : QuaternionFilter.GetOrientation();
+	}
+
+	int ImuProcessor::DecodeReport(const uint8_t* Report, const ImuConversion& Conversion, TimedImuSample Out[ImuSamplesPerReport], const double HostSeconds) {
+		if (Report[0] != ReportId::FullInput) return 0;
+		// The timer is the tick of the oldest sample, which overlaps the previous report if the timer stepped back
+		const uint64_t First = Clock.Observe(Report[1], HostSeconds);
+		// Ticks since the last processed sample, the first sample of a report may follow a gap
+		const uint64_t DeltaTicks = First > Tick ? First - Tick : 0;
+		Tick += DeltaTicks;
+		const float TickPeriod = static_cast<float>(Clock.GetTickPeriod());
+		float Values[6][ImuSamplesPerReport];
+		const ImuSampleArrays Arrays = { { Values[0], Values[1], Values[2] }, { Values[3], Values[4], Values[5] } };
+		ConvertImuReport(Report, Conversion, Arrays);
+		for (int n = 0; n < ImuSamplesPerReport; ++n) {
+			Out[n].Tick = Tick + n;
+			Out[n].HostSeconds = Clock.ToHostSeconds(Tick + n);
+			Out[n].Sample.Accelerometer = Vector3(Values[0][n], Values[1][n], Values[2][n]);
+			Out[n].Sample.Gyroscope = Vector3(Values[3][n], Values[4][n], Values[5][n]);
+			if (!bEstimateGyroBias) continue;
+			GyroBias.Update(Out[n].Sample, GetSampleStep(n == 0 ? DeltaTicks : 1, TickPeriod));
+			Out[n].Sample.Gyroscope = Out[n].Sample.Gyroscope - GyroBias.GetBias();
+		}
+		Tick += ImuSamplesPerReport - 1;
+		Latest = Out[ImuSamplesPerReport - 1].Sample;
+		return ImuSamplesPerReport;
+	}
+
+	void ImuProcessor::ExtractSample(const uint8_t* Report, const int N, const ImuConversion& Conversion) {
+		Latest = ConvertImuSample(DecodeImuSample(Report, N), Conversion);
+		if (bEstimateGyroBias) Latest.Gyroscope = Latest.Gyroscope - GyroBias.GetBias();
+	}
+
+	Quaternion PredictOrientation(const Quaternion& Orientation, const Vector3& Rate, const float AheadSeconds) {
+		const float Angle = std::sqrt(Vector3::Dot(Rate, Rate)) * AheadSeconds;
+		if (std::fabs(Angle) < 1.e-6f) return Orientation;
+		// Rotation by the rate in the device frame, mapped to Unreal's convention the same way GetOrientation() maps
+		// the filter state, which turns appending a device rotation into (-x, -y, z, w)
+		const float Scale = std::sin(0.5f * Angle) / (Angle / AheadSeconds);
+		const Quaternion Delta(-Rate.X * Scale, -Rate.Y * Scale, Rate.Z * Scale, std::cos(0.5f * Angle));
+		return Orientation * Delta;
+	}
+
+	Quaternion ImuProcessor::PredictOrientation(const float AheadSeconds) const {
+		return JoyCon::PredictOrientation(GetOrientation(), Latest.Gyroscope, AheadSeconds);
+	}
+
+	void ImuProcessor::SetGyroBiasEstimation(const bool bEnabled) {
+		bEstimateGyroBias = bEnabled;
+		if (!bEnabled) GyroBias.Reset();
+	}
+}
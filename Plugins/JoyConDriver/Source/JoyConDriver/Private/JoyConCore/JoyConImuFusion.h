@@ -0,0 +1,202 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConClock.h"
+#include "JoyConReport.h"
+
+namespace JoyCon {
+
+	enum class OrientationFilterType : uint8_t {
+		/** BasisOrientationFilter */
+		Basis,
+		/** QuaternionOrientationFilter with Madgwick's gradient descent correction */
+		Madgwick,
+		/** QuaternionOrientationFilter with Mahony's proportional feedback on the gyroscope rate */
+		Mahony
+	};
+
+	/**
+	 * Complementary filter that tracks the device axes as three basis vectors. Each sample rotates the basis by the
+	 * integrated gyroscope rate blended with the tilt correction from gravity, then re-orthonormalizes it.
+	 */
+	class BasisOrientationFilter {
+
+	public:
+		BasisOrientationFilter();
+
+		/** The next sample restarts from the identity orientation */
+		void Reset();
+
+		/** Weight of the accelerometer correction against the gyroscope, 0 trusts the gyroscope only */
+		void SetFilterWeight(float InFilterWeight);
+
+		void Update(const ImuSample& Sample, float DeltaSeconds);
+
+		/** Orientation of the basis in Unreal's axis convention */
+		Quaternion GetOrientation() const;
+
+	public:
+		Vector3 I;
+		Vector3 J;
+		Vector3 K;
+
+	private:
+		float FilterWeight;
+		bool bFirstSample;
+	};
+
+	/**
+	 * Integrates the gyroscope directly in quaternion space and pulls the estimate towards gravity with either
+	 * Madgwick's or Mahony's correction. Cheaper per sample than the basis filter and the orientation is available
+	 * without converting a rotation matrix. Uses the same frames as BasisOrientationFilter, so the two are
+	 * interchangeable.
+	 */
+	class QuaternionOrientationFilter {
+
+	public:
+		explicit QuaternionOrientationFilter(OrientationFilterType InType = OrientationFilterType::Madgwick);
+
+		/** The next sample restarts from the identity orientation */
+		void Reset();
+
+		/** Madgwick or Mahony, Basis is treated as Madgwick */
+		void SetType(OrientationFilterType InType);
+
+		/** Madgwick's beta or Mahony's proportional gain, in rad/s of correction, 0 trusts the gyroscope only */
+		void SetGain(float InGain);
+
+		void Update(const ImuSample& Sample, float DeltaSeconds);
+
+		/** Rotation from the device frame to the filter's world frame */
+		const Quaternion& GetState() const { return State; }
+
+		/** Orientation in Unreal's axis convention, matches BasisOrientationFilter::GetOrientation() */
+		Quaternion GetOrientation() const;
+
+	private:
+		Quaternion State;
+		OrientationFilterType Type;
+		float Gain;
+		bool bFirstSample;
+	};
+
+	/**
+	 * Tracks the gyroscope bias left over after the SPI neutral, which drifts with temperature. A sample counts as
+	 * still when the gyroscope and the accelerometer barely vary over a short window and the acceleration is close to
+	 * 1 g. Once the device has been still for a moment the bias is pulled towards the window's mean rate.
+	 */
+	class GyroBiasEstimator {
+
+	public:
+		GyroBiasEstimator();
+
+		/** Forgets the bias and the stillness history */
+		void Reset();
+
+		/** Feeds a sample with only the SPI neutral removed, returns true if the device is considered still */
+		bool Update(const ImuSample& Sample, float DeltaSeconds);
+
+		/** Bias in rad/s, subtract it from the gyroscope rate */
+		const Vector3& GetBias() const { return Bias; }
+
+		/** 0 until the device was seen at rest, approaches 1 the longer it was; fades again while it keeps moving */
+		float GetConfidence() const;
+
+		bool IsStill() const { return StillSeconds >= SettleSeconds; }
+
+	public:
+		/** Window of the running mean and variance */
+		static constexpr float WindowSeconds = 0.25f;
+		/** Continuous stillness needed before the bias is updated */
+		static constexpr float SettleSeconds = 0.5f;
+		/** Time constant the bias follows the mean rate with while still */
+		static constexpr float BiasSeconds = 2.0f;
+		/** Observed still time at which the confidence reaches 0.5 */
+		static constexpr float ConfidenceSeconds = 2.0f;
+		/** Time constant the observed still time decays with while moving */
+		static constexpr float ForgetSeconds = 120.0f;
+
+	private:
+		Vector3 Bias;
+		Vector3 GyroMean;
+		Vector3 GyroVariance;
+		float AccelMean;
+		float AccelVariance;
+		/** Seconds the device has been still without interruption */
+		float StillSeconds;
+		/** Still time that went into the bias, decaying while moving */
+		float ObservedSeconds;
+		bool bFirstSample;
+	};
+
+	/** Orientation in Unreal's axis convention carried forward by the device frame Rate for AheadSeconds */
+	Quaternion PredictOrientation(const Quaternion& Orientation, const Vector3& Rate, float AheadSeconds);
+
+	/** Decodes the IMU samples of consecutive 0x30 reports and feeds them to the orientation filter */
+	class ImuProcessor {
+
+	public:
+		ImuProcessor();
+
+		/** Processes all samples of a report, returns false if the report carries no IMU data */
+		bool ProcessReport(const uint8_t* Report, const ImuConversion& Conversion);
+
+		/** Same as above and also returns the samples like DecodeReport() */
+		int ProcessReport(const uint8_t* Report, const ImuConversion& Conversion, TimedImuSample Out[ImuSamplesPerReport], double HostSeconds = -1.0);
+
+		/**
+		 * Decodes and timestamps every sample of a report, oldest first, without running the filter. Returns the number
+		 * of samples written to Out, 0 if the report carries no IMU data. HostSeconds is the time the report was read
+		 * at, see DeviceClock::Observe().
+		 */
+		int DecodeReport(const uint8_t* Report, const ImuConversion& Conversion, TimedImuSample Out[ImuSamplesPerReport], double HostSeconds = -1.0);
+
+		/** Decodes sample N of a report without running the filter */
+		void ExtractSample(const uint8_t* Report, int N, const ImuConversion& Conversion);
+
+		const ImuSample& GetLatestSample() const { return Latest; }
+
+		/** Starts a new timeline, for reports of a new connection whose timer has no relation to the previous one */
+		void ResetClock();
+
+		/** Host time of the newest decoded sample, 0 unless the reports came with host times */
+		double GetLatestHostSeconds() const { return Clock.ToHostSeconds(Tick); }
+
+		/** Selects the filter ProcessReport() runs, the default is Madgwick */
+		void SetFilterType(OrientationFilterType Type);
+		OrientationFilterType GetFilterType() const { return FilterType; }
+
+		/** Accelerometer correction of the filters, the basis filter's weight and the quaternion filter's gain */
+		void SetFilterGain(float Gain);
+
+		/** The next sample restarts every filter from the identity orientation */
+		void ResetOrientation();
+
+		/** Orientation of the selected filter in Unreal's axis convention */
+		Quaternion GetOrientation() const;
+
+		/**
+		 * GetOrientation() carried forward by the latest angular velocity for AheadSeconds, to hide transport and
+		 * render latency. Only accurate while the rate is steady, so keep the horizon to a few frames.
+		 */
+		Quaternion PredictOrientation(float AheadSeconds) const;
+
+		/** Whether decoded gyroscope rates are corrected by GyroBias, on by default. Disabling also resets it. */
+		void SetGyroBiasEstimation(bool bEnabled);
+		bool IsGyroBiasEstimationEnabled() const { return bEstimateGyroBias; }
+
+		BasisOrientationFilter Filter;
+		QuaternionOrientationFilter QuaternionFilter;
+		GyroBiasEstimator GyroBias;
+		/** Timeline of the decoded reports, its fitted period also spaces the filter updates */
+		DeviceClock Clock;
+
+	private:
+		ImuSample Latest;
+		OrientationFilterType FilterType;
+		/** Tick of the newest decoded sample */
+		uint64_t Tick;
+		bool bEstimateGyroBias;
+	};
+}
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConImuKernel.h"
+
+#include "JoyConReport.h"
+
+#if defined(__AVX2__)
+#define JOYCON_IMU_KERNEL_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JOYCON_IMU_KERNEL_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)) && !defined(__BIG_ENDIAN__)
+#define JOYCON_IMU_KERNEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace JoyCon {
+
+	// The three samples of a report are 18 consecutive little-endian int16 starting at byte 13, ax ay az gx gy gz
+	// per sample. The vector paths widen them in two blocks of eight, subtract the per-axis origin in the integer
+	// domain and apply the per-axis scale, exactly like the scalar code, so the results match bit for bit. The last
+	// two values (gy and gz of the newest sample) would need a load past the end of the report and are converted on
+	// their own.
+#if defined(JOYCON_IMU_KERNEL_AVX2) || defined(JOYCON_IMU_KERNEL_SSE2) || defined(JOYCON_IMU_KERNEL_NEON)
+#define JOYCON_IMU_KERNEL_VECTOR 1
+	static constexpr int ImuValuesPerReport = ImuSamplesPerReport * 6;
+
+	static void ScatterImuValues(const float Values[ImuValuesPerReport], const ImuSampleArrays& Out, const size_t Offset) {
+		for (int n = 0; n < ImuSamplesPerReport; ++n) {
+			for (int i = 0; i < 3; ++i) {
+				Out.Accelerometer[i][Offset + n] = Values[n * 6 + i];
+				Out.Gyroscope[i][Offset + n] = Values[n * 6 + 3 + i];
+			}
+		}
+	}
+
+	static void ConvertImuTail(const uint8_t* Values, const ImuConversion& Conversion, float Out[2]) {
+		for (int i = 0; i < 2; ++i) {
+			const int16_t Raw = static_cast<int16_t>(Values[i * 2] | ((Values[i * 2 + 1] << 8) & 0xff00));
+			Out[i] = (Raw - Conversion.GyroOrigin[i + 1]) * Conversion.GyroScale[i + 1];
+		}
+	}
+#endif
+
+	static inline void ConvertImuReportVector(const uint8_t* Report, const ImuConversion& Conversion, const ImuSampleArrays& Out, const size_t Offset) {
+#if defined(JOYCON_IMU_KERNEL_VECTOR)
+		const uint8_t* Values = &Report[13];
+		const int32_t O0 = Conversion.AccelOrigin[0];
+		const int32_t O1 = Conversion.AccelOrigin[1];
+		const int32_t O2 = Conversion.AccelOrigin[2];
+		const int32_t N0 = Conversion.GyroOrigin[0];
+		const int32_t N1 = Conversion.GyroOrigin[1];
+		const int32_t N2 = Conversion.GyroOrigin[2];
+		const float A0 = Conversion.AccelScale[0];
+		const float A1 = Conversion.AccelScale[1];
+		const float A2 = Conversion.AccelScale[2];
+		const float G0 = Conversion.GyroScale[0];
+		const float G1 = Conversion.GyroScale[1];
+		const float G2 = Conversion.GyroScale[2];
+		alignas(32) float Converted[ImuValuesPerReport];
+#if defined(JOYCON_IMU_KERNEL_AVX2)
+		const __m256i Low = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Values)));
+		const __m256i High = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Values + 16)));
+		const __m256i LowCentered = _mm256_sub_epi32(Low, _mm256_setr_epi32(O0, O1, O2, N0, N1, N2, O0, O1));
+		const __m256i HighCentered = _mm256_sub_epi32(High, _mm256_setr_epi32(O2, N0, N1, N2, O0, O1, O2, N0));
+		_mm256_store_ps(&Converted[0], _mm256_mul_ps(_mm256_cvtepi32_ps(LowCentered), _mm256_setr_ps(A0, A1, A2, G0, G1, G2, A0, A1)));
+		_mm256_store_ps(&Converted[8], _mm256_mul_ps(_mm256_cvtepi32_ps(HighCentered), _mm256_setr_ps(A2, G0, G1, G2, A0, A1, A2, G0)));
+#elif defined(JOYCON_IMU_KERNEL_SSE2)
+		const __m128i Low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Values));
+		const __m128i High = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Values + 16));
+		// Sign extend by duplicating every int16 into both halves of a lane and shifting arithmetically
+		const __m128i Widened[4] = {
+			_mm_srai_epi32(_mm_unpacklo_epi16(Low, Low), 16),
+			_mm_srai_epi32(_mm_unpackhi_epi16(Low, Low), 16),
+			_mm_srai_epi32(_mm_unpacklo_epi16(High, High), 16),
+			_mm_srai_epi32(_mm_unpackhi_epi16(High, High), 16),
+		};
+		const __m128i Origin[4] = {
+			_mm_setr_epi32(O0, O1, O2, N0),
+			_mm_setr_epi32(N1, N2, O0, O1),
+			_mm_setr_epi32(O2, N0, N1, N2),
+			_mm_setr_epi32(O0, O1, O2, N0),
+		};
+		const __m128 Scale[4] = {
+			_mm_setr_ps(A0, A1, A2, G0),
+			_mm_setr_ps(G1, G2, A0, A1),
+			_mm_setr_ps(A2, G0, G1, G2),
+			_mm_setr_ps(A0, A1, A2, G0),
+		};
+		for (int i = 0; i < 4; ++i) {
+			_mm_store_ps(&Converted[i * 4], _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(Widened[i], Origin[i])), Scale[i]));
+		}
+#elif defined(JOYCON_IMU_KERNEL_NEON)
+		const int16x8_t Low = vreinterpretq_s16_u8(vld1q_u8(Values));
+		const int16x8_t High = vreinterpretq_s16_u8(vld1q_u8(Values + 16));
+		const int32x4_t Widened[4] = {
+			vmovl_s16(vget_low_s16(Low)),
+			vmovl_s16(vget_high_s16(Low)),
+			vmovl_s16(vget_low_s16(High)),
+			vmovl_s16(vget_high_s16(High)),
+		};
+		const int32_t Origin[16] = { O0, O1, O2, N0, N1, N2, O0, O1, O2, N0, N1, N2, O0, O1, O2, N0 };
+		const float Scale[16] = { A0, A1, A2, G0, G1, G2, A0, A1, A2, G0, G1, G2, A0, A1, A2, G0 };
+		for (int i = 0; i < 4; ++i) {
+			const int32x4_t Centered = vsubq_s32(Widened[i], vld1q_s32(&Origin[i * 4]));
+			vst1q_f32(&Converted[i * 4], vmulq_f32(vcvtq_f32_s32(Centered), vld1q_f32(&Scale[i * 4])));
+		}
+#endif
+		ConvertImuTail(Values + 32, Conversion, &Converted[16]);
+		ScatterImuValues(Converted, Out, Offset);
+#else
+		ConvertImuReportScalar(Report, Conversion, Out, Offset);
+#endif
+	}
+
+	void ConvertImuReport(const uint8_t* Report, const ImuConversion& Conversion, const ImuSampleArrays& Out, const size_t Offset) {
+		ConvertImuReportVector(Report, Conversion, Out, Offset);
+	}
+
+	void ConvertImuReports(const uint8_t* const* Reports, const ImuConversion* const* Conversions, const size_t Count, const ImuSampleArrays& Out) {
+		for (size_t i = 0; i < Count; ++i) {
+			ConvertImuReportVector(Reports[i], *Conversions[i], Out, i * ImuSamplesPerReport);
+		}
+	}
+
+	void ConvertImuReportScalar(const uint8_t* Report, const ImuConversion& Conversion, const ImuSampleArrays& Out, const size_t Offset) {
+		for (int n = 0; n < ImuSamplesPerReport; ++n) {
+			const ImuSample Sample = ConvertImuSample(DecodeImuSample(Report, n), Conversion);
+			for (int i = 0; i < 3; ++i) {
+				Out.Accelerometer[i][Offset + n] = Sample.Accelerometer[i];
+				Out.Gyroscope[i][Offset + n] = Sample.Gyroscope[i];
+			}
+		}
+	}
+
+	const char* GetImuKernelName() {
+#if defined(JOYCON_IMU_KERNEL_AVX2)
+		return "avx2";
+#elif defined(JOYCON_IMU_KERNEL_SSE2)
+		return "sse2";
+#elif defined(JOYCON_IMU_KERNEL_NEON)
+		return "neon";
+#else
+		return "scalar";
+#endif
+	}
+}
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConReport.h"
+
+namespace JoyCon {
+
+	/**
+	 * Destination of the IMU kernels, one float array per axis. Entry i of every array belongs to the same sample,
+	 * the caller owns the storage and sizes it for ImuSamplesPerReport entries per converted report.
+	 */
+	struct ImuSampleArrays {
+		/** Acceleration in g */
+		float* Accelerometer[3];
+		/** Angular velocity in rad/s */
+		float* Gyroscope[3];
+	};
+
+	/**
+	 * Decodes and scales the three samples of a 0x30 report into entries Offset to Offset + 2 of Out, oldest first.
+	 * The results are bit for bit those of ConvertImuSample(DecodeImuSample()), only computed a report at a time.
+	 */
+	void ConvertImuReport(const uint8_t* Report, const ImuConversion& Conversion, const ImuSampleArrays& Out, size_t Offset = 0);
+
+	/**
+	 * Converts Count reports in one pass, report i landing at entries 3 * i to 3 * i + 2. Conversions[i] belongs to
+	 * Reports[i], so reports of several controllers can share a batch.
+	 */
+	void ConvertImuReports(const uint8_t* const* Reports, const ImuConversion* const* Conversions, size_t Count, const ImuSampleArrays& Out);
+
+	/** Portable reference of ConvertImuReport(), always compiled so the vector paths can be checked against it */
+	void ConvertImuReportScalar(const uint8_t* Report, const ImuConversion& Conversion, const ImuSampleArrays& Out, size_t Offset = 0);
+
+	/** Instruction set ConvertImuReport() was compiled for: "avx2", "sse2", "neon" or "scalar" */
+	const char* GetImuKernelName();
+}
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConLayout.h"
+
+namespace JoyCon {
+
+	// Out of line definitions for C++14, the decoders bind references to these tables
+	constexpr ButtonBit ControllerLayout<ControllerType::LeftJoyCon>::Buttons[ButtonCount];
+	constexpr uint16_t (StickCalibration::* ControllerLayout<ControllerType::LeftJoyCon>::StickCalibrationOrder[3])[2];
+	constexpr ButtonBit ControllerLayout<ControllerType::RightJoyCon>::Buttons[ButtonCount];
+	constexpr uint16_t (StickCalibration::* ControllerLayout<ControllerType::RightJoyCon>::StickCalibrationOrder[3])[2];
+
+	template <ControllerType Type>
+	static constexpr ControllerDecoders MakeDecoders() {
+		return {
+			Type,
+			&DecodeInputFor<Type>,
+			&DecodeStickFor<Type>,
+			&DecodeStickCalibrationFor<Type>,
+			ControllerLayout<Type>::UserStickCalibration,
+			ControllerLayout<Type>::FactoryStickCalibration,
+			ControllerLayout<Type>::StickParameters,
+		};
+	}
+
+	// Indexed by ControllerType
+	static constexpr ControllerDecoders Decoders[] = {
+		MakeDecoders<ControllerType::LeftJoyCon>(),
+		MakeDecoders<ControllerType::RightJoyCon>(),
+	};
+	static_assert(sizeof(Decoders) / sizeof(Decoders[0]) == static_cast<size_t>(ControllerType::Count), "Every controller type needs its decoders.");
+
+	const ControllerDecoders& GetControllerDecoders(const ControllerType Type) {
+		return Decoders[static_cast<size_t>(Type)];
+	}
+}
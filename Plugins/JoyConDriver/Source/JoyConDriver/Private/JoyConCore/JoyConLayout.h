@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConCalibration.h"
+#include "JoyConReport.h"
+
+namespace JoyCon {
+
+	enum class ControllerType : uint8_t {
+		LeftJoyCon,
+		RightJoyCon,
+		Count
+	};
+
+	inline ControllerType GetJoyConType(const bool bIsLeft) {
+		return bIsLeft ? ControllerType::LeftJoyCon : ControllerType::RightJoyCon;
+	}
+
+	/** Bit of a button in an input report */
+	struct ButtonBit {
+		uint8_t Byte;
+		uint8_t Mask;
+	};
+
+	/**
+	 * Where a controller type keeps its buttons, stick and calibration. A new layout is a new specialization, the
+	 * decoders below read everything from these tables.
+	 */
+	template <ControllerType Type>
+	struct ControllerLayout;
+
+	template <>
+	struct ControllerLayout<ControllerType::LeftJoyCon> {
+		/** Indexed by Button. Capture has never been mapped, a zero mask keeps it released. */
+		static constexpr ButtonBit Buttons[ButtonCount] = {
+			{ 5, 0x02 }, { 5, 0x08 }, { 5, 0x04 }, { 5, 0x01 },
+			{ 4, 0x01 }, { 4, 0x02 }, { 4, 0x10 }, { 4, 0x00 },
+			{ 4, 0x08 },
+			{ 5, 0x10 }, { 5, 0x20 },
+			{ 5, 0x40 }, { 5, 0x80 },
+		};
+		static constexpr int StickOffset = 6;
+		/** Order of the three pairs in the stick calibration block */
+		static constexpr uint16_t (StickCalibration::* StickCalibrationOrder[3])[2] = { &StickCalibration::Max, &StickCalibration::Center, &StickCalibration::Min };
+		static constexpr uint32_t UserStickCalibration = SpiAddress::UserLeftStickCalibration;
+		static constexpr uint32_t FactoryStickCalibration = SpiAddress::FactoryLeftStickCalibration;
+		static constexpr uint32_t StickParameters = SpiAddress::LeftStickParameters;
+	};
+
+	template <>
+	struct ControllerLayout<ControllerType::RightJoyCon> {
+		/** Indexed by Button, the face buttons take the D-pad's place */
+		static constexpr ButtonBit Buttons[ButtonCount] = {
+			{ 3, 0x02 }, { 3, 0x01 }, { 3, 0x08 }, { 3, 0x04 },
+			{ 4, 0x01 }, { 4, 0x02 }, { 4, 0x10 }, { 4, 0x00 },
+			{ 4, 0x04 },
+			{ 3, 0x10 }, { 3, 0x20 },
+			{ 3, 0x40 }, { 3, 0x80 },
+		};
+		static constexpr int StickOffset = 9;
+		static constexpr uint16_t (StickCalibration::* StickCalibrationOrder[3])[2] = { &StickCalibration::Center, &StickCalibration::Min, &StickCalibration::Max };
+		static constexpr uint32_t UserStickCalibration = SpiAddress::UserRightStickCalibration;
+		static constexpr uint32_t FactoryStickCalibration = SpiAddress::FactoryRightStickCalibration;
+		static constexpr uint32_t StickParameters = SpiAddress::RightStickParameters;
+	};
+
+	/** 12 bit X and Y packed into three bytes, used by both stick positions and stick calibration */
+	inline void DecodeStickPair(const uint8_t* Bytes, uint16_t& OutX, uint16_t& OutY) {
+		OutX = static_cast<uint16_t>(Bytes[0] | ((Bytes[1] & 0xf) << 8));
+		OutY = static_cast<uint16_t>((Bytes[1] >> 4) | (Bytes[2] << 4));
+	}
+
+	template <ControllerType Type>
+	void DecodeStickFor(const uint8_t* Report, uint16_t Out[2]) {
+		DecodeStickPair(&Report[ControllerLayout<Type>::StickOffset], Out[0], Out[1]);
+	}
+
+	template <ControllerType Type>
+	bool DecodeInputFor(const uint8_t* Report, const StickCalibration& Calibration, InputState& Out) {
+		if (Report[0] == 0x00) return false;
+		DecodeStickFor<Type>(Report, Out.StickRaw);
+		CenterStick(Out.StickRaw, Calibration, Out.Stick);
+		for (int i = 0; i < ButtonCount; ++i) {
+			const ButtonBit& Bit = ControllerLayout<Type>::Buttons[i];
+			Out.Buttons[i] = (Report[Bit.Byte] & Bit.Mask) != 0;
+		}
+		return true;
+	}
+
+	template <ControllerType Type>
+	void DecodeStickCalibrationFor(const uint8_t Block[9], StickCalibration& Out) {
+		for (int i = 0; i < 3; ++i) {
+			uint16_t (&Pair)[2] = Out.*ControllerLayout<Type>::StickCalibrationOrder[i];
+			DecodeStickPair(&Block[i * 3], Pair[0], Pair[1]);
+		}
+	}
+
+	/** The decoders and SPI addresses of one controller type, looked up once when the controller connects */
+	struct ControllerDecoders {
+		ControllerType Type;
+		bool (*DecodeInput)(const uint8_t* Report, const StickCalibration& Calibration, InputState& Out);
+		void (*DecodeStick)(const uint8_t* Report, uint16_t Out[2]);
+		void (*DecodeStickCalibration)(const uint8_t Block[9], StickCalibration& Out);
+		uint32_t UserStickCalibration;
+		uint32_t FactoryStickCalibration;
+		uint32_t StickParameters;
+	};
+
+	const ControllerDecoders& GetControllerDecoders(ControllerType Type);
+}
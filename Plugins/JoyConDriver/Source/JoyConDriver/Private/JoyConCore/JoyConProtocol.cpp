@@ -0,0 +1,334 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConProtocol.h"
+
+#include <cstring>
+
+namespace JoyCon {
+
+	const uint8_t NeutralRumble[8] = { 0x0, 0x1, 0x40, 0x40, 0x0, 0x1, 0x40, 0x40 };
+
+	// Defaults tuned for Bluetooth: a reply normally arrives within one or two report periods
+	static constexpr int DefaultMaxInFlight = 4;
+	static constexpr int DefaultTimeoutMs = 50;
+	static constexpr int DefaultMaxAttempts = 5;
+
+	static bool IsOlder(const uint32_t A, const uint32_t B) {
+		return static_cast<int32_t>(A - B) < 0;
+	}
+
+	SubCommandChannel::SubCommandChannel(ITransport* InTransport, IReportSink* InSink) :
+		Transport(InTransport),
+		Sink(InSink),
+		bExternalReader(false),
+		MaxInFlight(DefaultMaxInFlight),
+		TimeoutMs(DefaultTimeoutMs),
+		MaxAttempts(DefaultMaxAttempts),
+		PacketCounter(0),
+		NextTicket(1),
+		PostedResults{},
+		Requests{} {
+	}
+
+	void SubCommandChannel::SetTransport(ITransport* InTransport) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Transport = InTransport;
+	}
+
+	void SubCommandChannel::SetReportSink(IReportSink* InSink) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Sink = InSink;
+	}
+
+	void SubCommandChannel::SetExternalReader(const bool bInExternalReader) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		bExternalReader = bInExternalReader;
+		Completed.notify_all();
+	}
+
+	void SubCommandChannel::SetMaxInFlight(const int InMaxInFlight) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		MaxInFlight = InMaxInFlight < 1 ? 1 : InMaxInFlight;
+	}
+
+	void SubCommandChannel::SetTimeout(const int InTimeoutMs, const int InMaxAttempts) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		TimeoutMs = InTimeoutMs < 1 ? 1 : InTimeoutMs;
+		MaxAttempts = InMaxAttempts < 1 ? 1 : InMaxAttempts;
+	}
+
+	SubCommandChannel::Ticket SubCommandChannel::Submit(const uint8_t Id, const uint8_t* Args, const size_t ArgsLength) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		return SubmitLocked(Id, Args, ArgsLength, false);
+	}
+
+	bool SubCommandChannel::Post(const uint8_t Id, const uint8_t* Args, const size_t ArgsLength) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		return SubmitLocked(Id, Args, ArgsLength, true) != 0;
+	}
+
+	SubCommandChannel::Ticket SubCommandChannel::SubmitSpiRead(const uint32_t Address, size_t Length) {
+		if (Length > MaxSpiReadLength) Length = MaxSpiReadLength;
+		const uint8_t Args[5] = {
+			static_cast<uint8_t>(Address & 0xff),
+			static_cast<uint8_t>((Address >> 8) & 0xff),
+			static_cast<uint8_t>((Address >> 16) & 0xff),
+			static_cast<uint8_t>((Address >> 24) & 0xff),
+			static_cast<uint8_t>(Length)
+		};
+		return Submit(SubCommand::SpiFlashRead, Args, sizeof(Args));
+	}
+
+	SubCommandStatus SubCommandChannel::Wait(const Ticket InTicket, uint8_t* Reply) {
+		std::unique_lock<std::mutex> Lock(Mutex);
+		for (;;) {
+			const int NextDeadlineMs = ServiceLocked(Clock::now());
+			const SubCommandStatus Status = CollectLocked(InTicket, Reply);
+			if (Status != SubCommandStatus::Pending) return Status;
+			PumpLocked(Lock, NextDeadlineMs);
+		}
+	}
+
+	SubCommandStatus SubCommandChannel::Poll(const Ticket InTicket, uint8_t* Reply) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		ServiceLocked(Clock::now());
+		return CollectLocked(InTicket, Reply);
+	}
+
+	void SubCommandChannel::Cancel(const Ticket InTicket) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		if (PendingRequest* Request = FindLocked(InTicket)) {
+			Request->RequestTicket = 0;
+			Request->bInFlight = false;
+		}
+		ServiceLocked(Clock::now());
+	}
+
+	bool SubCommandChannel::WaitSpiRead(const Ticket InTicket, uint8_t* Out, size_t Length) {
+		if (Length > MaxSpiReadLength) Length = MaxSpiReadLength;
+		uint8_t Reply[ReportLength];
+		if (Wait(InTicket, Reply) != SubCommandStatus::Succeeded) {
+			// Blank flash, so calibration falls back to the factory block or the defaults
+			std::memset(Out, 0xff, Length);
+			return false;
+		}
+		std::memcpy(Out, &Reply[20], Length);
+		return true;
+	}
+
+	FlushResult SubCommandChannel::Flush() {
+		std::unique_lock<std::mutex> Lock(Mutex);
+		for (;;) {
+			const int NextDeadlineMs = ServiceLocked(Clock::now());
+			bool bPending = false;
+			for (const PendingRequest& Request : Requests) {
+				bPending |= Request.RequestTicket != 0 && Request.Status == SubCommandStatus::Pending;
+			}
+			if (!bPending) {
+				const FlushResult Result = PostedResults;
+				PostedResults = FlushResult{};
+				return Result;
+			}
+			PumpLocked(Lock, NextDeadlineMs);
+		}
+	}
+
+	bool SubCommandChannel::HandleReport(const uint8_t* Report, const size_t Length) {
+		if (Length < 15 || Report[0] != ReportId::SubCommandReply) return false;
+		std::lock_guard<std::mutex> Lock(Mutex);
+		PendingRequest* Match = nullptr;
+		for (PendingRequest& Request : Requests) {
+			if (Request.RequestTicket == 0 || !Request.bInFlight || !MatchesReply(Request, Report, Length)) continue;
+			if (Match == nullptr || IsOlder(Request.RequestTicket, Match->RequestTicket)) Match = &Request;
+		}
+		// Late replies to timed out requests go to the input path like any other report
+		if (Match == nullptr) return false;
+		const size_t Copied = Length < ReportLength ? Length : ReportLength;
+		std::memcpy(Match->Reply, Report, Copied);
+		std::memset(Match->Reply + Copied, 0, ReportLength - Copied);
+		CompleteLocked(*Match, SubCommandStatus::Succeeded);
+		// A slot is free, send the next queued request without waiting for the caller
+		ServiceLocked(Clock::now());
+		return true;
+	}
+
+	int SubCommandChannel::SendSubCommand(const uint8_t Id, const uint8_t* Args, const size_t ArgsLength, uint8_t* Reply) {
+		const Ticket RequestTicket = Submit(Id, Args, ArgsLength);
+		if (RequestTicket == 0) {
+			if (Reply != nullptr) std::memset(Reply, 0, ReportLength);
+			return -1;
+		}
+		switch (Wait(RequestTicket, Reply)) {
+		case SubCommandStatus::Succeeded:
+			return static_cast<int>(ReportLength);
+		case SubCommandStatus::TimedOut:
+			return 0;
+		default:
+			return -1;
+		}
+	}
+
+	int SubCommandChannel::SendRumble(const uint8_t Rumble[8]) {
+		std::lock_guard<std::mutex> Lock(Mutex);
+		if (Transport == nullptr) return -1;
+		uint8_t Buf[ReportLength] = {};
+		Buf[0] = ReportId::RumbleOnly;
+		Buf[1] = NextPacketCounter();
+		std::memcpy(&Buf[2], Rumble, 8);
+		return Transport->Write(Buf, ReportLength);
+	}
+
+	bool SubCommandChannel::ReadSpi(const uint32_t Address, uint8_t* Out, const size_t Length) {
+		return WaitSpiRead(SubmitSpiRead(Address, Length), Out, Length);
+	}
+
+	SubCommandChannel::Ticket SubCommandChannel::SubmitLocked(const uint8_t Id, const uint8_t* Args, const size_t ArgsLength, const bool bPosted) {
+		if (Transport == nullptr || ArgsLength > MaxSubCommandArgsLength) return 0;
+		PendingRequest* Free = nullptr;
+		for (PendingRequest& Request : Requests) {
+			if (Request.RequestTicket == 0) {
+				Free = &Request;
+				break;
+			}
+		}
+		if (Free == nullptr) return 0;
+		Free->RequestTicket = NextTicket;
+		NextTicket = NextTicket + 1 == 0 ? 1 : NextTicket + 1;
+		Free->Status = SubCommandStatus::Pending;
+		Free->bInFlight = false;
+		Free->bPosted = bPosted;
+		Free->Id = Id;
+		Free->ArgsLength = static_cast<uint8_t>(ArgsLength);
+		if (ArgsLength > 0) std::memcpy(Free->Args, Args, ArgsLength);
+		Free->Attempts = 0;
+		const Ticket RequestTicket = Free->RequestTicket;
+		ServiceLocked(Clock::now());
+		return RequestTicket;
+	}
+
+	SubCommandStatus SubCommandChannel::CollectLocked(const Ticket InTicket, uint8_t* Reply) {
+		PendingRequest* Request = FindLocked(InTicket);
+		const SubCommandStatus Status = Request != nullptr ? Request->Status : SubCommandStatus::Invalid;
+		if (Status == SubCommandStatus::Pending) return Status;
+		if (Reply != nullptr) {
+			if (Status == SubCommandStatus::Succeeded) std::memcpy(Reply, Request->Reply, ReportLength);
+			else std::memset(Reply, 0, ReportLength);
+		}
+		if (Request != nullptr) Request->RequestTicket = 0;
+		return Status;
+	}
+
+	SubCommandChannel::PendingRequest* SubCommandChannel::FindLocked(const Ticket InTicket) {
+		if (InTicket == 0) return nullptr;
+		for (PendingRequest& Request : Requests) {
+			if (Request.RequestTicket == InTicket) return &Request;
+		}
+		return nullptr;
+	}
+
+	bool SubCommandChannel::MatchesReply(const PendingRequest& Request, const uint8_t* Report, const size_t Length) const {
+		if (Request.Status != SubCommandStatus::Pending || Report[14] != Request.Id) return false;
+		if (Request.Id != SubCommand::SpiFlashRead) return true;
+		// Several reads can be in flight, the reply echoes address and length
+		return Length >= 20 && std::memcmp(&Report[15], Request.Args, 5) == 0;
+	}
+
+	bool SubCommandChannel::CanStartLocked(const PendingRequest& Queued, const int InFlight) const {
+		// Replies to anything but SPI reads carry only the subcommand id, and most subcommands depend on the ones
+		// before them (report mode, the pairing steps), so they run strictly one at a time
+		if (Queued.Id != SubCommand::SpiFlashRead) return InFlight == 0;
+		for (const PendingRequest& Request : Requests) {
+			if (Request.RequestTicket == 0 || !Request.bInFlight) continue;
+			if (Request.Id != SubCommand::SpiFlashRead) return false;
+			// Two reads of the same range would answer each other's replies
+			if (std::memcmp(Request.Args, Queued.Args, 5) == 0) return false;
+		}
+		return true;
+	}
+
+	void SubCommandChannel::WriteLocked(PendingRequest& Request, const Clock::time_point Now) {
+		uint8_t Buf[ReportLength] = {};
+		Buf[0] = ReportId::RumbleAndSubCommand;
+		Buf[1] = NextPacketCounter();
+		std::memcpy(&Buf[2], NeutralRumble, sizeof(NeutralRumble));
+		Buf[10] = Request.Id;
+		if (Request.ArgsLength > 0) std::memcpy(&Buf[11], Request.Args, Request.ArgsLength);
+		++Request.Attempts;
+		Request.SentAt = Now;
+		if (Transport == nullptr || Transport->Write(Buf, Request.ArgsLength + 11) < 0) {
+			CompleteLocked(Request, SubCommandStatus::Failed);
+			return;
+		}
+		Request.bInFlight = true;
+	}
+
+	void SubCommandChannel::CompleteLocked(PendingRequest& Request, const SubCommandStatus Status) {
+		Request.Status = Status;
+		Request.bInFlight = false;
+		if (Request.bPosted) {
+			++PostedResults.Posted;
+			if (Status != SubCommandStatus::Succeeded) ++PostedResults.Failed;
+			Request.RequestTicket = 0;
+		}
+		Completed.notify_all();
+	}
+
+	int SubCommandChannel::ServiceLocked(const Clock::time_point Now) {
+		int NextDeadlineMs = TimeoutMs;
+		int InFlight = 0;
+		for (PendingRequest& Request : Requests) {
+			if (Request.RequestTicket == 0 || !Request.bInFlight) continue;
+			const int ElapsedMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(Now - Request.SentAt).count());
+			if (ElapsedMs < TimeoutMs) {
+				++InFlight;
+				if (TimeoutMs - ElapsedMs < NextDeadlineMs) NextDeadlineMs = TimeoutMs - ElapsedMs;
+			} else if (Request.Attempts >= MaxAttempts) {
+				CompleteLocked(Request, SubCommandStatus::TimedOut);
+			} else {
+				WriteLocked(Request, Now);
+				if (Request.bInFlight) ++InFlight;
+			}
+		}
+		// Start queued requests in submission order, the controller executes them in the order they arrive. The oldest
+		// queued request that cannot start yet holds back every later one, so nothing overtakes it.
+		while (InFlight < MaxInFlight) {
+			PendingRequest* Oldest = nullptr;
+			for (PendingRequest& Request : Requests) {
+				if (Request.RequestTicket == 0 || Request.bInFlight || Request.Status != SubCommandStatus::Pending) continue;
+				if (Oldest == nullptr || IsOlder(Request.RequestTicket, Oldest->RequestTicket)) Oldest = &Request;
+			}
+			if (Oldest == nullptr || !CanStartLocked(*Oldest, InFlight)) break;
+			WriteLocked(*Oldest, Now);
+			if (Oldest->bInFlight) ++InFlight;
+		}
+		return NextDeadlineMs < 1 ? 1 : NextDeadlineMs;
+	}
+
+	void SubCommandChannel::PumpLocked(std::unique_lock<std::mutex>& Lock, const int TimeoutMsToWait) {
+		if (bExternalReader || Transport == nullptr) {
+			Completed.wait_for(Lock, std::chrono::milliseconds(TimeoutMsToWait));
+			return;
+		}
+		ITransport* Reader = Transport;
+		IReportSink* ReportSink = Sink;
+		Lock.unlock();
+		uint8_t Buf[ReportLength];
+		const int Result = Reader->Read(Buf, ReportLength, TimeoutMsToWait);
+		if (Result > 0 && !HandleReport(Buf, static_cast<size_t>(Result)) && ReportSink != nullptr) {
+			ReportSink->OnInputReport(Buf, static_cast<size_t>(Result));
+		}
+		Lock.lock();
+		if (Result >= 0) return;
+		// The device is gone, nothing pending can complete any more
+		for (PendingRequest& Request : Requests) {
+			if (Request.RequestTicket != 0 && Request.Status == SubCommandStatus::Pending) CompleteLocked(Request, SubCommandStatus::Failed);
+		}
+	}
+
+	uint8_t SubCommandChannel::NextPacketCounter() {
+		const uint8_t Counter = PacketCounter;
+		PacketCounter = static_cast<uint8_t>((PacketCounter + 1) & 0xf);
+		return Counter;
+	}
+}
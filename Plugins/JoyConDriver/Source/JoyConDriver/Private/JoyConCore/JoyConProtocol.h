@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConCoreTypes.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace JoyCon {
+
+	namespace ReportId {
+		constexpr uint8_t RumbleAndSubCommand = 0x01;
+		constexpr uint8_t RumbleOnly = 0x10;
+		constexpr uint8_t SubCommandReply = 0x21;
+		constexpr uint8_t FullInput = 0x30;
+		constexpr uint8_t SimpleInput = 0x3f;
+	}
+
+	namespace SubCommand {
+		constexpr uint8_t BluetoothPairing = 0x01;
+		constexpr uint8_t SetInputReportMode = 0x03;
+		constexpr uint8_t SpiFlashRead = 0x10;
+		constexpr uint8_t SetPlayerLights = 0x30;
+		constexpr uint8_t EnableImu = 0x40;
+		constexpr uint8_t EnableVibration = 0x48;
+	}
+
+	/** Largest payload a single SPI flash read reply can carry */
+	constexpr size_t MaxSpiReadLength = 0x1d;
+
+	/** Largest argument block of a 0x01 report */
+	constexpr size_t MaxSubCommandArgsLength = ReportLength - 11;
+
+	/** Requests that can be queued or in flight on one channel at the same time */
+	constexpr int MaxPendingSubCommands = 32;
+
+	/** Rumble bytes that leave both motors idle */
+	extern const uint8_t NeutralRumble[8];
+
+	/** Receives the reports read while waiting for subcommand replies that are not replies themselves */
+	class IReportSink {
+
+	public:
+		virtual ~IReportSink() = default;
+
+		virtual void OnInputReport(const uint8_t* Report, size_t Length) = 0;
+	};
+
+	enum class SubCommandStatus {
+		Pending,
+		Succeeded,
+		TimedOut,
+		Failed,
+		/** Unknown or already collected ticket */
+		Invalid,
+	};
+
+	/** Posted requests completed since the previous SubCommandChannel::Flush() */
+	struct FlushResult {
+		int Posted;
+		/** Failed or timed out */
+		int Failed;
+	};
+
+	/**
+	 * Output side of the protocol for one controller: builds 0x01 subcommand and 0x10 rumble reports and keeps the
+	 * shared 4 bit packet counter. Each request gets a ticket and requests start in submission order. SPI reads of
+	 * different ranges are pipelined, up to MaxInFlight of them are written before the first reply arrives and their
+	 * 0x21 replies are matched by the echoed address. Every other subcommand is only answered with its id, so it is
+	 * sent alone and the next request waits for its reply or failure. Requests without a reply are re-sent after the
+	 * timeout.
+	 *
+	 * Replies reach the channel either through HandleReport(), called by whoever already reads the transport, or by
+	 * Wait() reading the transport itself; input reports read there are forwarded to the report sink. Thread-safe.
+	 */
+	class SubCommandChannel {
+
+	public:
+		using Ticket = uint32_t;
+
+		explicit SubCommandChannel(ITransport* InTransport = nullptr, IReportSink* InSink = nullptr);
+
+		void SetTransport(ITransport* InTransport);
+		void SetReportSink(IReportSink* InSink);
+
+		/**
+		 * While set another thread reads the transport and passes every report to HandleReport(), Wait() then blocks on
+		 * the replies instead of reading itself.
+		 */
+		void SetExternalReader(bool bInExternalReader);
+
+		/** SPI reads written without a reply yet, the controller queues a few output reports */
+		void SetMaxInFlight(int InMaxInFlight);
+
+		/** Time to wait for a reply before re-sending, and how often a request is sent before it times out */
+		void SetTimeout(int InTimeoutMs, int InMaxAttempts);
+
+		/** Queues a subcommand and sends it as soon as a slot is free, returns 0 if too many requests are pending */
+		Ticket Submit(uint8_t Id, const uint8_t* Args, size_t ArgsLength);
+
+		/** Like Submit() but nobody collects the reply, the request is forgotten once it completes */
+		bool Post(uint8_t Id, const uint8_t* Args, size_t ArgsLength);
+
+		/** Queues a read of up to MaxSpiReadLength bytes of SPI flash */
+		Ticket SubmitSpiRead(uint32_t Address, size_t Length);
+
+		/**
+		 * Blocks until the request completes and releases its ticket. Reply (ReportLength bytes, may be null) receives
+		 * the 0x21 reply on success and is zeroed otherwise.
+		 */
+		SubCommandStatus Wait(Ticket InTicket, uint8_t* Reply);
+
+		/** Non-blocking Wait(), returns Pending and keeps the ticket while the request is outstanding */
+		SubCommandStatus Poll(Ticket InTicket, uint8_t* Reply);
+
+		/** Forgets a request, a reply arriving later is treated as input */
+		void Cancel(Ticket InTicket);
+
+		/** Waits for a SubmitSpiRead() ticket and copies the payload, Out is filled with 0xff if the read failed */
+		bool WaitSpiRead(Ticket InTicket, uint8_t* Out, size_t Length);
+
+		/** Blocks until every pending request, including posted ones, has completed */
+		FlushResult Flush();
+
+		/** Returns true if the report was the reply to a pending request and has been consumed */
+		bool HandleReport(const uint8_t* Report, size_t Length);
+
+		/** Submits a subcommand and waits for its reply, returns ReportLength on success, 0 on timeout, -1 on error */
+		int SendSubCommand(uint8_t Id, const uint8_t* Args, size_t ArgsLength, uint8_t* Reply);
+
+		/** Sends a rumble-only report */
+		int SendRumble(const uint8_t Rumble[8]);
+
+		/** Reads up to MaxSpiReadLength bytes of SPI flash, see WaitSpiRead() */
+		bool ReadSpi(uint32_t Address, uint8_t* Out, size_t Length);
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct PendingRequest {
+			/** 0 when the slot is free */
+			Ticket RequestTicket;
+			SubCommandStatus Status;
+			bool bInFlight;
+			bool bPosted;
+			uint8_t Id;
+			uint8_t ArgsLength;
+			uint8_t Args[MaxSubCommandArgsLength];
+			int Attempts;
+			Clock::time_point SentAt;
+			uint8_t Reply[ReportLength];
+		};
+
+		Ticket SubmitLocked(uint8_t Id, const uint8_t* Args, size_t ArgsLength, bool bPosted);
+		/** Returns the status and releases the ticket unless the request is still pending */
+		SubCommandStatus CollectLocked(Ticket InTicket, uint8_t* Reply);
+		PendingRequest* FindLocked(Ticket InTicket);
+		bool MatchesReply(const PendingRequest& Request, const uint8_t* Report, size_t Length) const;
+		/** Whether the oldest queued request may be written while InFlight requests await their replies */
+		bool CanStartLocked(const PendingRequest& Queued, int InFlight) const;
+		void WriteLocked(PendingRequest& Request, Clock::time_point Now);
+		void CompleteLocked(PendingRequest& Request, SubCommandStatus Status);
+		/** Re-sends or times out overdue requests and starts queued ones, returns the time until the next deadline */
+		int ServiceLocked(Clock::time_point Now);
+		/** Waits for a completion, or reads and dispatches one report when nobody else reads the transport */
+		void PumpLocked(std::unique_lock<std::mutex>& Lock, int TimeoutMsToWait);
+		uint8_t NextPacketCounter();
+
+	private:
+		ITransport* Transport;
+		IReportSink* Sink;
+		bool bExternalReader;
+		int MaxInFlight;
+		int TimeoutMs;
+		int MaxAttempts;
+		uint8_t PacketCounter;
+		Ticket NextTicket;
+		FlushResult PostedResults;
+
+		std::mutex Mutex;
+		std::condition_variable Completed;
+		PendingRequest Requests[MaxPendingSubCommands];
+	};
+}
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConReport.h"
+
+#include "JoyConCalibration.h"
+#include "JoyConLayout.h"
+
+#include <cmath>
+
+namespace JoyCon {
+
+	static int16_t ReadImuInt16(const uint8_t* Bytes) {
+		return static_cast<int16_t>(Bytes[0] | ((Bytes[1] << 8) & 0xff00));
+	}
+
+	bool DecodeInput(const uint8_t* Report, const bool bIsLeft, const StickCalibration& Calibration, InputState& Out) {
+		return GetControllerDecoders(GetJoyConType(bIsLeft)).DecodeInput(Report, Calibration, Out);
+	}
+
+	void DecodeStick(const uint8_t* Report, const bool bIsLeft, uint16_t Out[2]) {
+		GetControllerDecoders(GetJoyConType(bIsLeft)).DecodeStick(Report, Out);
+	}
+
+	void CenterStick(const uint16_t Raw[2], const StickCalibration& Calibration, float Out[2]) {
+		for (int i = 0; i < 2; ++i) {
+			const float Diff = static_cast<float>(Raw[i] - Calibration.Center[i]);
+			if (std::fabs(Diff) < Calibration.DeadZone) Out[i] = 0;
+			else if (Diff > 0) Out[i] = Diff / Calibration.Max[i];
+			else Out[i] = Diff / Calibration.Min[i];
+		}
+	}
+
+	RawImuSample DecodeImuSample(const uint8_t* Report, const int N) {
+		const uint8_t* Sample = &Report[13 + N * 12];
+		RawImuSample Raw;
+		for (int i = 0; i < 3; ++i) {
+			Raw.Accelerometer[i] = ReadImuInt16(&Sample[i * 2]);
+			Raw.Gyroscope[i] = ReadImuInt16(&Sample[6 + i * 2]);
+		}
+		return Raw;
+	}
+
+	ImuSample ConvertImuSample(const RawImuSample& Raw, const ImuConversion& Conversion) {
+		ImuSample Sample;
+		for (int i = 0; i < 3; ++i) {
+			Sample.Accelerometer[i] = (Raw.Accelerometer[i] - Conversion.AccelOrigin[i]) * Conversion.AccelScale[i];
+			Sample.Gyroscope[i] = (Raw.Gyroscope[i] - Conversion.GyroOrigin[i]) * Conversion.GyroScale[i];
+		}
+		return Sample;
+	}
+}
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConCoreTypes.h"
+
+namespace JoyCon {
+
+	struct StickCalibration;
+
+	struct InputState {
+		bool Buttons[ButtonCount];
+		/** 12 bit raw stick position */
+		uint16_t StickRaw[2];
+		/** Calibrated stick position, roughly -1 to 1 */
+		float Stick[2];
+	};
+
+	struct RawImuSample {
+		int16_t Accelerometer[3];
+		int16_t Gyroscope[3];
+	};
+
+	struct ImuSample {
+		/** Acceleration in g */
+		Vector3 Accelerometer;
+		/** Angular velocity in rad/s */
+		Vector3 Gyroscope;
+	};
+
+	struct TimedImuSample {
+		/** Device time in DeviceTimerPeriod ticks since the first report, unwrapped from the 8 bit report timer */
+		uint64_t Tick;
+		/** Host time of Tick in the clock the reports were stamped with, 0 if they were not */
+		double HostSeconds;
+		ImuSample Sample;
+	};
+
+	/** Accelerometer scale in g per count (+-8 g range) */
+	constexpr float AccelerometerScale = 0.00025f;
+
+	/** Gyroscope scale in rad/s per count (+-2000 dps range) */
+	constexpr float GyroscopeScale = 0.00122187695f;
+
+	/**
+	 * Per-axis conversion of raw IMU counts, Value = (Raw - Origin) * Scale. Defaults to the nominal scales without
+	 * any origin, DecodeCalibration() folds the unit's SPI calibration into it.
+	 */
+	struct ImuConversion {
+		int16_t AccelOrigin[3] = { 0, 0, 0 };
+		float AccelScale[3] = { AccelerometerScale, AccelerometerScale, AccelerometerScale };
+		int16_t GyroOrigin[3] = { 0, 0, 0 };
+		float GyroScale[3] = { GyroscopeScale, GyroscopeScale, GyroscopeScale };
+	};
+
+	/** Decodes buttons and the stick of a 0x21/0x30 report, returns false for an empty report */
+	bool DecodeInput(const uint8_t* Report, bool bIsLeft, const StickCalibration& Calibration, InputState& Out);
+
+	/** Raw 12 bit stick position of the side's stick */
+	void DecodeStick(const uint8_t* Report, bool bIsLeft, uint16_t Out[2]);
+
+	/** Applies dead zone and range calibration to a raw stick position */
+	void CenterStick(const uint16_t Raw[2], const StickCalibration& Calibration, float Out[2]);
+
+	/** Raw sample N (0 oldest to 2 newest) of a 0x30 report */
+	RawImuSample DecodeImuSample(const uint8_t* Report, int N);
+
+	ImuSample ConvertImuSample(const RawImuSample& Raw, const ImuConversion& Conversion);
+}
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConRumble.h"
+
+#include <cmath>
+
+namespace JoyCon {
+
+	static float ClampRumble(const float X, const float Min, const float Max) {
+		if (X < Min) return Min;
+		if (X > Max) return Max;
+		return X;
+	}
+
+	static int RoundRumble(const float X) {
+		return static_cast<int>(std::floor(X + 0.5f));
+	}
+
+	static float Log2Rumble(const float X) {
+		return std::log(X) / std::log(2.0f);
+	}
+
+	void EncodeRumble(float LowFrequency, float HighFrequency, float Amplitude, uint8_t Out[8]) {
+		if (Amplitude == 0.0f) {
+			Out[0] = 0x0;
+			Out[1] = 0x1;
+			Out[2] = 0x40;
+			Out[3] = 0x40;
+		} else {
+			LowFrequency = ClampRumble(LowFrequency, MinRumbleLowFrequency, MaxRumbleLowFrequency);
+			Amplitude = ClampRumble(Amplitude, 0.0f, 1.0f);
+			HighFrequency = ClampRumble(HighFrequency, MinRumbleHighFrequency, MaxRumbleHighFrequency);
+
+			const uint16_t HighFrequencyLocal = static_cast<uint16_t>((RoundRumble(32.0f * Log2Rumble(HighFrequency * 0.1f)) - 0x60) * 4);
+			const uint8_t LowFrequencyLocal = static_cast<uint8_t>(RoundRumble(32.0f * Log2Rumble(LowFrequency * 0.1f)) - 0x40);
+
+			// Converted through int so amplitudes that encode below zero wrap instead of being undefined
+			float EncodedAmplitude;
+			if (Amplitude < 0.117) EncodedAmplitude = ((Log2Rumble(Amplitude * 1000) * 32) - 0x60) / (5 - std::pow(Amplitude, 2.0f)) - 1;
+			else if (Amplitude < 0.23) EncodedAmplitude = ((Log2Rumble(Amplitude * 1000) * 32) - 0x60) - 0x5c;
+			else EncodedAmplitude = (((Log2Rumble(Amplitude * 1000) * 32) - 0x60) * 2) - 0xf6;
+			const uint8_t HighFrequencyAmplitude = static_cast<uint8_t>(static_cast<int>(EncodedAmplitude));
+
+			uint16_t LowFrequencyAmplitude = static_cast<uint16_t>(HighFrequencyAmplitude * .5);
+			const uint8_t Parity = static_cast<uint8_t>(LowFrequencyAmplitude % 2);
+			if (Parity > 0) {
+				--LowFrequencyAmplitude;
+			}
+
+			LowFrequencyAmplitude = static_cast<uint16_t>(LowFrequencyAmplitude >> 1);
+			LowFrequencyAmplitude += 0x40;
+			if (Parity > 0) LowFrequencyAmplitude |= 0x8000;
+			Out[0] = static_cast<uint8_t>(HighFrequencyLocal & 0xff);
+			Out[1] = static_cast<uint8_t>((HighFrequencyLocal >> 8) & 0xff);
+			Out[2] = LowFrequencyLocal;
+			Out[3] = 0;
+
+			Out[1] += static_cast<uint8_t>(HighFrequencyLocal);
+			Out[2] += static_cast<uint8_t>((LowFrequencyAmplitude >> 8) & 0xff);
+			Out[3] += static_cast<uint8_t>(LowFrequencyAmplitude & 0xff);
+		}
+		for (int i = 0; i < 4; ++i) {
+			Out[4 + i] = Out[i];
+		}
+	}
+}
@@ -0,0 +1,19 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConCoreTypes.h"
+
+namespace JoyCon {
+
+	constexpr float MinRumbleLowFrequency = 40.875885f;
+	constexpr float MaxRumbleLowFrequency = 626.286133f;
+	constexpr float MinRumbleHighFrequency = 81.75177f;
+	constexpr float MaxRumbleHighFrequency = 1252.572266f;
+
+	/**
+	 * Encodes a rumble command into the 8 bytes sent with every output report, the same 4 bytes drive the left and
+	 * right actuator. Frequencies are in Hz and clamped to what the actuator supports, amplitude is 0 to 1.
+	 */
+	void EncodeRumble(float LowFrequency, float HighFrequency, float Amplitude, uint8_t Out[8]);
+}
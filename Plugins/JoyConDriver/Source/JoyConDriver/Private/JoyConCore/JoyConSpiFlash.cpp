@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConSpiFlash.h"
+
+#include "JoyConCalibration.h"
+#include "JoyConLayout.h"
+#include "JoyConProtocol.h"
+
+namespace JoyCon {
+
+	int ReadSpiRange(SubCommandChannel& Channel, const uint32_t Address, uint8_t* Out, const size_t Length) {
+		const size_t NumChunks = (Length + MaxSpiReadLength - 1) / MaxSpiReadLength;
+		SubCommandChannel::Ticket Window[SpiReadWindow] = {};
+		size_t Submitted = 0;
+		int Failed = 0;
+		// Chunk i lives in Window[i % SpiReadWindow] until it is collected
+		for (size_t Collected = 0; Collected < NumChunks; ++Collected) {
+			for (; Submitted < NumChunks && Submitted < Collected + SpiReadWindow; ++Submitted) {
+				const size_t Offset = Submitted * MaxSpiReadLength;
+				const size_t ChunkLength = Length - Offset < MaxSpiReadLength ? Length - Offset : MaxSpiReadLength;
+				Window[Submitted % SpiReadWindow] = Channel.SubmitSpiRead(Address + static_cast<uint32_t>(Offset), ChunkLength);
+			}
+			const size_t Offset = Collected * MaxSpiReadLength;
+			const size_t ChunkLength = Length - Offset < MaxSpiReadLength ? Length - Offset : MaxSpiReadLength;
+			if (!Channel.WaitSpiRead(Window[Collected % SpiReadWindow], Out + Offset, ChunkLength)) ++Failed;
+		}
+		return Failed;
+	}
+
+	bool DumpCalibrationRegion(SubCommandChannel& Channel, uint8_t* Out) {
+		int Failed = ReadSpiRange(Channel, SpiRegion::FactoryCalibration, Out, SpiRegion::FactoryCalibrationLength);
+		Failed += ReadSpiRange(Channel, SpiRegion::UserCalibration, Out + SpiRegion::FactoryCalibrationLength, SpiRegion::UserCalibrationLength);
+		return Failed == 0;
+	}
+
+	void DecodeCalibrationDump(const uint8_t* Dump, const bool bIsLeft, Calibration& Out) {
+		auto Factory = [Dump](const uint32_t Address) {
+			return Dump + (Address - SpiRegion::FactoryCalibration);
+		};
+		auto User = [Dump](const uint32_t Address) {
+			return Dump + SpiRegion::FactoryCalibrationLength + (Address - SpiRegion::UserCalibration);
+		};
+		const ControllerDecoders& Decoders = GetControllerDecoders(GetJoyConType(bIsLeft));
+		CalibrationBlocks Blocks;
+		Blocks.UserStick = User(Decoders.UserStickCalibration);
+		Blocks.FactoryStick = Factory(Decoders.FactoryStickCalibration);
+		Blocks.StickParameters = Factory(Decoders.StickParameters);
+		Blocks.UserImu = User(SpiAddress::UserImuCalibration);
+		Blocks.FactoryImu = Factory(SpiAddress::FactoryImuCalibration);
+		DecodeCalibration(Blocks, bIsLeft, Out);
+	}
+}
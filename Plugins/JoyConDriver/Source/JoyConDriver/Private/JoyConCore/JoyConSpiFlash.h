@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "JoyConCoreTypes.h"
+
+namespace JoyCon {
+
+	class SubCommandChannel;
+	struct Calibration;
+
+	namespace SpiRegion {
+		/** Serial number, colors, factory IMU and stick calibration and stick parameters */
+		constexpr uint32_t FactoryCalibration = 0x6000;
+		constexpr size_t FactoryCalibrationLength = 0xb0;
+		/** User stick and IMU calibration, each behind a 2 byte magic */
+		constexpr uint32_t UserCalibration = 0x8010;
+		constexpr size_t UserCalibrationLength = 0x30;
+	}
+
+	/** Size of a DumpCalibrationRegion() dump, the factory region followed by the user region */
+	constexpr size_t CalibrationDumpLength = SpiRegion::FactoryCalibrationLength + SpiRegion::UserCalibrationLength;
+
+	/** Chunks submitted ahead of the oldest unfinished one, the channel still bounds what is actually in flight */
+	constexpr int SpiReadWindow = 8;
+
+	/**
+	 * Reads Length bytes starting at Address in MaxSpiReadLength chunks, keeping up to SpiReadWindow chunks queued so
+	 * the reads are pipelined. Every reply is matched by its echoed address and length. Chunks that fail are filled
+	 * with 0xff; returns the number of chunks that failed, 0 when the whole range was read.
+	 */
+	int ReadSpiRange(SubCommandChannel& Channel, uint32_t Address, uint8_t* Out, size_t Length);
+
+	/** Reads the factory and user calibration regions into Out (CalibrationDumpLength bytes), returns true if complete */
+	bool DumpCalibrationRegion(SubCommandChannel& Channel, uint8_t* Out);
+
+	/** Decodes a DumpCalibrationRegion() dump the same way LoadCalibration() decodes the individual blocks */
+	void DecodeCalibrationDump(const uint8_t* Dump, bool bIsLeft, Calibration& Out);
+}
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Drives the Linux hidraw backend through hid_open_fd() with a SOCK_SEQPACKET socketpair standing in for a
+// /dev/hidraw node. Each send on the peer is one report, like hidraw, so no controller is needed. Only built through
+// CMake, the guard keeps UnrealBuildTool from linking a second main() into the module.
+#if defined(JOYCON_CORE_STANDALONE) && defined(__linux__)
+
+#include "hidapi.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int Failures = 0;
+
+static void Check(const bool bCondition, const char* What) {
+	if (bCondition) return;
+	std::fprintf(stderr, "FAILED: %s\n", What);
+	Failures++;
+}
+
+int main() {
+	int Fds[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, Fds) != 0) {
+		std::perror("socketpair");
+		return 1;
+	}
+	hid_device* Device = hid_open_fd(Fds[0]);
+	Check(Device != nullptr, "hid_open_fd wraps the descriptor");
+	if (!Device) return 1;
+	const int Peer = Fds[1];
+
+	unsigned char Report[64] = {};
+	Check(hid_read_timeout(Device, Report, sizeof(Report), 20) == 0, "hid_read_timeout returns 0 on timeout");
+	hid_set_nonblocking(Device, 1);
+	Check(hid_read(Device, Report, sizeof(Report)) == 0, "non-blocking hid_read returns 0 without a report");
+	hid_set_nonblocking(Device, 0);
+
+	unsigned char Sent[49];
+	for (size_t i = 0; i < sizeof(Sent); ++i) Sent[i] = static_cast<unsigned char>(0x30 + i);
+	Check(write(Peer, Sent, sizeof(Sent)) == static_cast<ssize_t>(sizeof(Sent)), "peer writes a report");
+	Check(hid_read_timeout(Device, Report, sizeof(Report), 1000) == static_cast<int>(sizeof(Sent)), "hid_read_timeout returns the report length");
+	Check(std::memcmp(Report, Sent, sizeof(Sent)) == 0, "hid_read_timeout delivers the report bytes");
+
+	// Reports are not merged, two writes are two reads
+	Check(write(Peer, Sent, 10) == 10 && write(Peer, Sent, 20) == 20, "peer writes two reports");
+	Check(hid_read_timeout(Device, Report, sizeof(Report), 1000) == 10, "first of two reports");
+	Check(hid_read(Device, Report, sizeof(Report)) == 20, "second of two reports");
+
+	const unsigned char SubCommand[] = { 0x01, 0x00, 0x00, 0x01, 0x40, 0x40, 0x00, 0x01, 0x40, 0x40, 0x03, 0x30 };
+	Check(hid_write(Device, SubCommand, sizeof(SubCommand)) == static_cast<int>(sizeof(SubCommand)), "hid_write returns the written length");
+	unsigned char Received[64] = {};
+	Check(read(Peer, Received, sizeof(Received)) == static_cast<ssize_t>(sizeof(SubCommand)), "hid_write is passed through unpadded");
+	Check(std::memcmp(Received, SubCommand, sizeof(SubCommand)) == 0, "hid_write passes the bytes through");
+
+	close(Peer);
+	Check(hid_read_timeout(Device, Report, sizeof(Report), 1000) == -1, "hid_read_timeout returns -1 after a hang-up");
+	Check(hid_read(Device, Report, sizeof(Report)) == -1, "blocking hid_read returns -1 after a hang-up");
+	Check(hid_error(Device) != nullptr, "a hang-up sets the error string");
+	hid_close(Device);
+
+	if (Failures == 0) std::printf("hid_linux fd backend: all checks passed\n");
+	return Failures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Checks that the vector IMU kernel this build selected reproduces the scalar reference bit for bit, over random
+// reports and uneven per-axis conversions. Only built through CMake, the guard keeps UnrealBuildTool from linking a
+// second main() into the module.
+#if defined(JOYCON_CORE_STANDALONE)
+
+#include "JoyConImuKernel.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static constexpr int NumReports = 4096;
+static constexpr int NumConversions = 7;
+
+/** Storage for ImuSampleArrays, Count samples per axis */
+struct SampleStorage {
+	explicit SampleStorage(const size_t Count) : Values(Count * 6) {
+		for (int a = 0; a < 3; ++a) {
+			Arrays.Accelerometer[a] = &Values[a * Count];
+			Arrays.Gyroscope[a] = &Values[(3 + a) * Count];
+		}
+	}
+
+	std::vector<float> Values;
+	JoyCon::ImuSampleArrays Arrays;
+};
+
+/** Returns the first differing float, or -1 if both are bit for bit identical */
+static long FindMismatch(const SampleStorage& Expected, const SampleStorage& Actual) {
+	for (size_t i = 0; i < Expected.Values.size(); ++i) {
+		if (std::memcmp(&Expected.Values[i], &Actual.Values[i], sizeof(float)) != 0) return static_cast<long>(i);
+	}
+	return -1;
+}
+
+static int Report(const char* What, const SampleStorage& Expected, const SampleStorage& Actual) {
+	const long Mismatch = FindMismatch(Expected, Actual);
+	if (Mismatch < 0) return 0;
+	std::fprintf(stderr, "FAILED: %s differs from the scalar reference at value %ld: %.9g instead of %.9g\n",
+		What, Mismatch, Actual.Values[Mismatch], Expected.Values[Mismatch]);
+	return 1;
+}
+
+int main() {
+	std::mt19937 Random(1);
+	std::uniform_int_distribution<int> Byte(0, 255);
+	std::uniform_int_distribution<int> Origin(-400, 400);
+	std::uniform_real_distribution<float> ScaleFactor(0.8f, 1.2f);
+
+	// Fully random bytes, so the samples cover the whole int16 range including its extremes
+	std::vector<uint8_t> Corpus(static_cast<size_t>(NumReports) * JoyCon::ReportLength);
+	for (uint8_t& Value : Corpus) Value = static_cast<uint8_t>(Byte(Random));
+	JoyCon::ImuConversion Conversions[NumConversions];
+	for (int c = 1; c < NumConversions; ++c) {
+		for (int i = 0; i < 3; ++i) {
+			Conversions[c].AccelOrigin[i] = static_cast<int16_t>(Origin(Random));
+			Conversions[c].AccelScale[i] = JoyCon::AccelerometerScale * ScaleFactor(Random);
+			Conversions[c].GyroOrigin[i] = static_cast<int16_t>(Origin(Random));
+			Conversions[c].GyroScale[i] = JoyCon::GyroscopeScale * ScaleFactor(Random);
+		}
+	}
+
+	const size_t NumSamples = static_cast<size_t>(NumReports) * JoyCon::ImuSamplesPerReport;
+	SampleStorage Reference(NumSamples);
+	SampleStorage Scalar(NumSamples);
+	SampleStorage Vector(NumSamples);
+	SampleStorage Batch(NumSamples);
+	std::vector<const uint8_t*> Reports(NumReports);
+	std::vector<const JoyCon::ImuConversion*> ReportConversions(NumReports);
+	for (int r = 0; r < NumReports; ++r) {
+		const uint8_t* ReportData = &Corpus[static_cast<size_t>(r) * JoyCon::ReportLength];
+		const JoyCon::ImuConversion& Conversion = Conversions[r % NumConversions];
+		const size_t Offset = static_cast<size_t>(r) * JoyCon::ImuSamplesPerReport;
+		for (int n = 0; n < JoyCon::ImuSamplesPerReport; ++n) {
+			const JoyCon::ImuSample Sample = JoyCon::ConvertImuSample(JoyCon::DecodeImuSample(ReportData, n), Conversion);
+			for (int a = 0; a < 3; ++a) {
+				Reference.Arrays.Accelerometer[a][Offset + n] = Sample.Accelerometer[a];
+				Reference.Arrays.Gyroscope[a][Offset + n] = Sample.Gyroscope[a];
+			}
+		}
+		JoyCon::ConvertImuReportScalar(ReportData, Conversion, Scalar.Arrays, Offset);
+		JoyCon::ConvertImuReport(ReportData, Conversion, Vector.Arrays, Offset);
+		Reports[r] = ReportData;
+		ReportConversions[r] = &Conversion;
+	}
+	JoyCon::ConvertImuReports(Reports.data(), ReportConversions.data(), static_cast<size_t>(NumReports), Batch.Arrays);
+
+	int Failures = 0;
+	Failures += Report("ConvertImuReportScalar", Reference, Scalar);
+	Failures += Report("ConvertImuReport", Reference, Vector);
+	Failures += Report("ConvertImuReports", Reference, Batch);
+	if (Failures == 0) std::printf("%s IMU kernel matches the scalar reference over %d reports\n", JoyCon::GetImuKernelName(), NumReports);
+	return Failures == 0 ? 0 : 1;
+}
+
+#endif
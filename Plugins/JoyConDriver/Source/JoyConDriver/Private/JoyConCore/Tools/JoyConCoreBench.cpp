@@ -0,0 +1,701 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+// Standalone benchmark of the JoyCon core hot paths, prints JSON to stdout. Only built through CMake, the guard
+// keeps UnrealBuildTool from linking a second main() into the module.
+#if defined(JOYCON_CORE_STANDALONE)
+
+#include "JoyConCalibration.h"
+#include "JoyConClock.h"
+#include "JoyConGesture.h"
+#include "JoyConImuFusion.h"
+#include "JoyConImuKernel.h"
+#include "JoyConLayout.h"
+#include "JoyConReport.h"
+#include "JoyConRumble.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+static std::atomic<uint64_t> GAllocations(0);
+
+void* operator new(std::size_t Size) {
+	GAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* Ptr = std::malloc(Size ? Size : 1)) return Ptr;
+	std::abort();
+}
+
+void operator delete(void* Ptr) noexcept {
+	std::free(Ptr);
+}
+
+void operator delete(void* Ptr, std::size_t) noexcept {
+	std::free(Ptr);
+}
+
+namespace {
+
+	volatile float Sink = 0.0f;
+
+	struct BenchResult {
+		const char* Name;
+		int64_t Operations;
+		double NsPerOperation;
+		double AllocationsPerOperation;
+	};
+
+	template<typename FunctionType>
+	BenchResult Measure(const char* Name, const int Iterations, FunctionType&& Body) {
+		int64_t Operations = Body();
+		double BestSeconds = 1e300;
+		const uint64_t AllocationsBefore = GAllocations.load();
+		for (int i = 0; i < Iterations; ++i) {
+			const auto Start = std::chrono::steady_clock::now();
+			Operations = Body();
+			const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+			if (Seconds < BestSeconds) BestSeconds = Seconds;
+		}
+		const uint64_t Allocations = GAllocations.load() - AllocationsBefore;
+		BenchResult Result;
+		Result.Name = Name;
+		Result.Operations = Operations;
+		Result.NsPerOperation = Operations > 0 ? BestSeconds * 1e9 / Operations : 0.0;
+		Result.AllocationsPerOperation = Operations > 0 ? static_cast<double>(Allocations) / (static_cast<double>(Operations) * Iterations) : 0.0;
+		return Result;
+	}
+
+#if defined(_MSC_VER)
+	#define JOYCON_BENCH_NOINLINE __declspec(noinline)
+#else
+	#define JOYCON_BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+	/**
+	 * DecodeInput as it was before the per-layout decoders, it branches on the side for every button and the stick
+	 * offset. Kept as the baseline of the specialized decoders, out of line like the library function it replaced.
+	 */
+	JOYCON_BENCH_NOINLINE bool DecodeInputBranching(const uint8_t* Report, const bool bIsLeft, const JoyCon::StickCalibration& Calibration, JoyCon::InputState& Out) {
+		using JoyCon::Button;
+		if (Report[0] == 0x00) return false;
+
+		const uint8_t* Raw = &Report[bIsLeft ? 6 : 9];
+		Out.StickRaw[0] = static_cast<uint16_t>(Raw[0] | ((Raw[1] & 0xf) << 8));
+		Out.StickRaw[1] = static_cast<uint16_t>((Raw[1] >> 4) | (Raw[2] << 4));
+		JoyCon::CenterStick(Out.StickRaw, Calibration, Out.Stick);
+
+		const uint8_t SideButtons = Report[3 + (bIsLeft ? 2 : 0)];
+		const uint8_t SharedButtons = Report[4];
+		bool* Buttons = Out.Buttons;
+		Buttons[static_cast<int>(Button::DPad_Up)] = (SideButtons & 0x02) != 0;
+		Buttons[static_cast<int>(Button::DPad_Left)] = (SideButtons & (bIsLeft ? 0x08 : 0x01)) != 0;
+		Buttons[static_cast<int>(Button::DPad_Right)] = (SideButtons & (bIsLeft ? 0x04 : 0x08)) != 0;
+		Buttons[static_cast<int>(Button::DPad_Down)] = (SideButtons & (bIsLeft ? 0x01 : 0x04)) != 0;
+
+		Buttons[static_cast<int>(Button::Minus)] = (SharedButtons & 0x01) != 0;
+		Buttons[static_cast<int>(Button::Plus)] = (SharedButtons & 0x02) != 0;
+		Buttons[static_cast<int>(Button::Home)] = (SharedButtons & 0x10) != 0;
+
+		Buttons[static_cast<int>(Button::Left_ThumbStick)] = (SharedButtons & (bIsLeft ? 0x08 : 0x04)) != 0;
+
+		Buttons[static_cast<int>(Button::Sr)] = (SideButtons & 0x10) != 0;
+		Buttons[static_cast<int>(Button::Sl)] = (SideButtons & 0x20) != 0;
+
+		Buttons[static_cast<int>(Button::L)] = (SideButtons & 0x40) != 0;
+		Buttons[static_cast<int>(Button::Zl)] = (SideButtons & 0x80) != 0;
+		return true;
+	}
+
+	void PackInt16(uint8_t* Out, const int Value) {
+		Out[0] = static_cast<uint8_t>(Value & 0xff);
+		Out[1] = static_cast<uint8_t>((Value >> 8) & 0xff);
+	}
+
+	void BuildSyntheticCorpus(const int NumReports, const unsigned Seed, std::vector<uint8_t>& Out) {
+		std::mt19937 Random(Seed);
+		auto Range = [&Random](const int Min, const int Max) {
+			return std::uniform_int_distribution<int>(Min, Max)(Random);
+		};
+		Out.assign(static_cast<size_t>(NumReports) * JoyCon::ReportLength, 0);
+		for (int i = 0; i < NumReports; ++i) {
+			uint8_t* Report = &Out[i * JoyCon::ReportLength];
+			Report[0] = 0x30;
+			Report[1] = static_cast<uint8_t>(i * 3);
+			Report[2] = 0x8e;
+			for (int j = 3; j < 6; ++j) Report[j] = static_cast<uint8_t>(Range(0, 255));
+			for (int j = 6; j < 12; j += 3) {
+				const int X = Range(0x200, 0xe00);
+				const int Y = Range(0x200, 0xe00);
+				Report[j] = static_cast<uint8_t>(X & 0xff);
+				Report[j + 1] = static_cast<uint8_t>(((X >> 8) & 0xf) | ((Y & 0xf) << 4));
+				Report[j + 2] = static_cast<uint8_t>(Y >> 4);
+			}
+			for (int n = 0; n < JoyCon::ImuSamplesPerReport; ++n) {
+				uint8_t* Sample = &Report[13 + n * 12];
+				PackInt16(&Sample[0], Range(-400, 400));
+				PackInt16(&Sample[2], Range(-400, 400));
+				PackInt16(&Sample[4], 4096 + Range(-400, 400));
+				for (int k = 3; k < 6; ++k) PackInt16(&Sample[k * 2], Range(-2000, 2000));
+			}
+		}
+	}
+
+	JoyCon::Vector3 Rotate(const JoyCon::Quaternion& Q, const JoyCon::Vector3& V) {
+		const JoyCon::Quaternion R = Q * JoyCon::Quaternion(V.X, V.Y, V.Z, 0.0f) * JoyCon::Quaternion(-Q.X, -Q.Y, -Q.Z, Q.W);
+		return JoyCon::Vector3(R.X, R.Y, R.Z);
+	}
+
+	/** World Z in the device frame, recovered from an orientation in Unreal's axis convention */
+	JoyCon::Vector3 WorldZFromOrientation(const JoyCon::Quaternion& Orientation) {
+		JoyCon::Vector3 Z = Rotate(JoyCon::Quaternion(-Orientation.X, -Orientation.Y, -Orientation.Z, Orientation.W), JoyCon::Vector3(0, 0, 1));
+		Z.Z = -Z.Z;
+		return Z;
+	}
+
+	/**
+	 * Reports of a device swinging along smooth random axes with a small gyroscope bias, plus the true world Z in the
+	 * device frame at the newest sample of every report, which the filters' tilt can be checked against.
+	 */
+	void BuildMotionCorpus(const int NumReports, const unsigned Seed, std::vector<uint8_t>& Out, std::vector<JoyCon::Vector3>& OutWorldZ) {
+		std::mt19937 Random(Seed);
+		std::normal_distribution<float> Noise(0.0f, 1.0f);
+		std::uniform_real_distribution<float> Phase(0.0f, 6.2831853f);
+		float Phases[3];
+		for (float& P : Phases) P = Phase(Random);
+		Out.assign(static_cast<size_t>(NumReports) * JoyCon::ReportLength, 0);
+		OutWorldZ.resize(NumReports);
+		JoyCon::Quaternion Truth;
+		for (int i = 0; i < NumReports; ++i) {
+			uint8_t* Report = &Out[i * JoyCon::ReportLength];
+			Report[0] = 0x30;
+			Report[1] = static_cast<uint8_t>(i * 3);
+			for (int n = 0; n < JoyCon::ImuSamplesPerReport; ++n) {
+				const float Time = (i * JoyCon::ImuSamplesPerReport + n) * JoyCon::DeviceTimerPeriod;
+				const JoyCon::Vector3 Rate(3.0f * std::sin(Time * 1.1f + Phases[0]), 2.0f * std::sin(Time * 0.7f + Phases[1]), 4.0f * std::sin(Time * 0.3f + Phases[2]));
+				// Advance the truth in small steps so its own integration error stays far below the filters'
+				for (int Step = 0; Step < 8; ++Step) {
+					const float Half = 0.5f * JoyCon::DeviceTimerPeriod / 8;
+					const JoyCon::Quaternion Delta = Truth * JoyCon::Quaternion(Rate.X * Half, Rate.Y * Half, Rate.Z * Half, 0.0f);
+					Truth = JoyCon::Quaternion(Truth.X + Delta.X, Truth.Y + Delta.Y, Truth.Z + Delta.Z, Truth.W + Delta.W);
+					const float InvNorm = 1.0f / std::sqrt(Truth.X * Truth.X + Truth.Y * Truth.Y + Truth.Z * Truth.Z + Truth.W * Truth.W);
+					Truth = JoyCon::Quaternion(Truth.X * InvNorm, Truth.Y * InvNorm, Truth.Z * InvNorm, Truth.W * InvNorm);
+				}
+				const JoyCon::Vector3 WorldZ = Rotate(JoyCon::Quaternion(-Truth.X, -Truth.Y, -Truth.Z, Truth.W), JoyCon::Vector3(0, 0, 1));
+				if (n == JoyCon::ImuSamplesPerReport - 1) OutWorldZ[i] = WorldZ;
+				uint8_t* Sample = &Report[13 + n * 12];
+				for (int k = 0; k < 3; ++k) {
+					// The filters take world Z to be opposite to the measured acceleration
+					const float Accel = -WorldZ[k] + 0.02f * Noise(Random);
+					const float Gyro = Rate[k] + 0.01f + 0.02f * Noise(Random);
+					PackInt16(&Sample[k * 2], static_cast<int>(std::lround(Accel / JoyCon::AccelerometerScale)));
+					PackInt16(&Sample[6 + k * 2], static_cast<int>(std::lround(Gyro / JoyCon::GyroscopeScale)));
+				}
+			}
+		}
+	}
+
+	/** Reports of a device lying flat and still, with sensor noise and a constant gyroscope bias in rad/s */
+	void BuildRestCorpus(const int NumReports, const unsigned Seed, const JoyCon::Vector3& GyroBias, std::vector<uint8_t>& Out) {
+		std::mt19937 Random(Seed);
+		std::normal_distribution<float> Noise(0.0f, 1.0f);
+		Out.assign(static_cast<size_t>(NumReports) * JoyCon::ReportLength, 0);
+		for (int i = 0; i < NumReports; ++i) {
+			uint8_t* Report = &Out[i * JoyCon::ReportLength];
+			Report[0] = 0x30;
+			Report[1] = static_cast<uint8_t>(i * 3);
+			for (int n = 0; n < JoyCon::ImuSamplesPerReport; ++n) {
+				uint8_t* Sample = &Report[13 + n * 12];
+				for (int k = 0; k < 3; ++k) {
+					const float Accel = (k == 2 ? -1.0f : 0.0f) + 0.004f * Noise(Random);
+					const float Gyro = GyroBias[k] + 0.005f * Noise(Random);
+					PackInt16(&Sample[k * 2], static_cast<int>(std::lround(Accel / JoyCon::AccelerometerScale)));
+					PackInt16(&Sample[6 + k * 2], static_cast<int>(std::lround(Gyro / JoyCon::GyroscopeScale)));
+				}
+			}
+		}
+	}
+
+	/** Reads the 0x30 reports of a report log captured by the JoyConDriver module */
+	bool LoadReportLog(const char* Filename, std::vector<uint8_t>& Out, bool& bOutIsLeft) {
+		FILE* File = std::fopen(Filename, "rb");
+		if (File == nullptr) return false;
+		uint8_t Header[32];
+		if (std::fread(Header, 1, sizeof(Header), File) != sizeof(Header) || std::memcmp(Header, "JCRL", 4) != 0 || (Header[6] | (Header[7] << 8)) != 64) {
+			std::fclose(File);
+			return false;
+		}
+		bOutIsLeft = (Header[8] & 0x1) != 0;
+		uint8_t Record[64];
+		while (std::fread(Record, 1, sizeof(Record), File) == sizeof(Record)) {
+			// 8 byte timestamp followed by the report
+			if (Record[8] == 0x30) Out.insert(Out.end(), &Record[8], &Record[8] + JoyCon::ReportLength);
+		}
+		std::fclose(File);
+		return !Out.empty();
+	}
+}
+
+int main(int Argc, char** Argv) {
+	int NumReports = 20000;
+	int Iterations = 5;
+	unsigned Seed = 0;
+	const char* LogFilename = nullptr;
+	float BasisWeight = 0.05f;
+	float MadgwickBeta = 0.1f;
+	float MahonyGain = 1.0f;
+	for (int i = 1; i + 1 < Argc; i += 2) {
+		const std::string Option = Argv[i];
+		if (Option == "--reports") NumReports = std::atoi(Argv[i + 1]);
+		else if (Option == "--iterations") Iterations = std::atoi(Argv[i + 1]);
+		else if (Option == "--seed") Seed = static_cast<unsigned>(std::atoi(Argv[i + 1]));
+		else if (Option == "--log") LogFilename = Argv[i + 1];
+		else if (Option == "--basis-weight") BasisWeight = static_cast<float>(std::atof(Argv[i + 1]));
+		else if (Option == "--madgwick-beta") MadgwickBeta = static_cast<float>(std::atof(Argv[i + 1]));
+		else if (Option == "--mahony-gain") MahonyGain = static_cast<float>(std::atof(Argv[i + 1]));
+		else {
+			std::fprintf(stderr, "usage: %s [--reports N] [--iterations N] [--seed N] [--log capture.jcrl] [--basis-weight W] [--madgwick-beta B] [--mahony-gain K]\n", Argv[0]);
+			return 2;
+		}
+	}
+	if (NumReports < 1) NumReports = 1;
+	if (Iterations < 1) Iterations = 1;
+
+	std::vector<uint8_t> Corpus;
+	bool bIsLeft = true;
+	if (LogFilename != nullptr) {
+		if (!LoadReportLog(LogFilename, Corpus, bIsLeft)) {
+			std::fprintf(stderr, "failed to load %s\n", LogFilename);
+			return 1;
+		}
+	} else {
+		BuildSyntheticCorpus(NumReports, Seed, Corpus);
+	}
+	const int Count = static_cast<int>(Corpus.size() / JoyCon::ReportLength);
+
+	JoyCon::Calibration Calibration = {};
+	for (int i = 0; i < 2; ++i) {
+		Calibration.Stick.Max[i] = 0x5a0;
+		Calibration.Stick.Center[i] = 0x800;
+		Calibration.Stick.Min[i] = 0x5a0;
+	}
+	Calibration.Stick.DeadZone = 0xae;
+
+	JoyCon::InputState Input = {};
+	JoyCon::ImuProcessor Imu;
+	Imu.SetFilterType(JoyCon::OrientationFilterType::Basis);
+	Imu.Filter.SetFilterWeight(BasisWeight);
+	std::vector<BenchResult> Results;
+
+	Results.push_back(Measure("DecodeInputBranching", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) DecodeInputBranching(&Corpus[i * JoyCon::ReportLength], bIsLeft, Calibration.Stick, Input);
+		Sink = Sink + Input.Stick[0];
+		return static_cast<int64_t>(Count);
+	}));
+	// The bool based API, it looks the layout's decoders up on every call
+	Results.push_back(Measure("DecodeInput", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) JoyCon::DecodeInput(&Corpus[i * JoyCon::ReportLength], bIsLeft, Calibration.Stick, Input);
+		Sink = Sink + Input.Stick[0];
+		return static_cast<int64_t>(Count);
+	}));
+	// The controller looks its decoders up once and calls the layout's specialization directly
+	const JoyCon::ControllerDecoders& Decoders = JoyCon::GetControllerDecoders(JoyCon::GetJoyConType(bIsLeft));
+	Results.push_back(Measure("DecodeInputSpecialized", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) Decoders.DecodeInput(&Corpus[i * JoyCon::ReportLength], Calibration.Stick, Input);
+		Sink = Sink + Input.Stick[0];
+		return static_cast<int64_t>(Count);
+	}));
+	Results.push_back(Measure("ExtractImuSamples", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) {
+			for (int n = 0; n < JoyCon::ImuSamplesPerReport; ++n) Imu.ExtractSample(&Corpus[i * JoyCon::ReportLength], n, Calibration.Imu);
+		}
+		Sink = Sink + Imu.GetLatestSample().Gyroscope.X;
+		return static_cast<int64_t>(Count);
+	}));
+	// Structure of arrays output of the IMU kernels, three samples per report
+	std::vector<float> KernelValues(static_cast<size_t>(Count) * JoyCon::ImuSamplesPerReport * 12);
+	auto KernelArrays = [&KernelValues, Count](const int Half) {
+		float* Base = &KernelValues[static_cast<size_t>(Half) * Count * JoyCon::ImuSamplesPerReport * 6];
+		const size_t Stride = static_cast<size_t>(Count) * JoyCon::ImuSamplesPerReport;
+		return JoyCon::ImuSampleArrays{ { Base, Base + Stride, Base + Stride * 2 }, { Base + Stride * 3, Base + Stride * 4, Base + Stride * 5 } };
+	};
+	const JoyCon::ImuSampleArrays ScalarArrays = KernelArrays(0);
+	const JoyCon::ImuSampleArrays VectorArrays = KernelArrays(1);
+	Results.push_back(Measure("ConvertImuReportScalar", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) {
+			JoyCon::ConvertImuReportScalar(&Corpus[i * JoyCon::ReportLength], Calibration.Imu, ScalarArrays, static_cast<size_t>(i) * JoyCon::ImuSamplesPerReport);
+		}
+		Sink = Sink + ScalarArrays.Gyroscope[0][0];
+		return static_cast<int64_t>(Count);
+	}));
+	Results.push_back(Measure("ConvertImuReport", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) {
+			JoyCon::ConvertImuReport(&Corpus[i * JoyCon::ReportLength], Calibration.Imu, VectorArrays, static_cast<size_t>(i) * JoyCon::ImuSamplesPerReport);
+		}
+		Sink = Sink + VectorArrays.Gyroscope[0][0];
+		return static_cast<int64_t>(Count);
+	}));
+	// Batches as a host servicing several controllers would build them, each report with its own neutral
+	const int BatchSize = 8;
+	JoyCon::ImuConversion BatchConversions[BatchSize];
+	for (int b = 0; b < BatchSize; ++b) {
+		for (int i = 0; i < 3; ++i) {
+			BatchConversions[b].AccelOrigin[i] = static_cast<int16_t>(3 * b - i);
+			BatchConversions[b].AccelScale[i] = JoyCon::AccelerometerScale * (1.0f + 0.01f * (b - i));
+			BatchConversions[b].GyroOrigin[i] = static_cast<int16_t>(b - i);
+			BatchConversions[b].GyroScale[i] = JoyCon::GyroscopeScale * (1.0f - 0.01f * (b - i));
+		}
+	}
+	Results.push_back(Measure("ConvertImuReportsBatch", Iterations, [&]() {
+		const uint8_t* Reports[BatchSize];
+		const JoyCon::ImuConversion* Conversions[BatchSize];
+		for (int i = 0; i < Count; i += BatchSize) {
+			const int Batch = Count - i < BatchSize ? Count - i : BatchSize;
+			for (int b = 0; b < Batch; ++b) {
+				Reports[b] = &Corpus[(i + b) * JoyCon::ReportLength];
+				Conversions[b] = &BatchConversions[b];
+			}
+			JoyCon::ImuSampleArrays Arrays = VectorArrays;
+			for (int a = 0; a < 3; ++a) {
+				Arrays.Accelerometer[a] += static_cast<size_t>(i) * JoyCon::ImuSamplesPerReport;
+				Arrays.Gyroscope[a] += static_cast<size_t>(i) * JoyCon::ImuSamplesPerReport;
+			}
+			JoyCon::ConvertImuReports(Reports, Conversions, static_cast<size_t>(Batch), Arrays);
+		}
+		Sink = Sink + VectorArrays.Gyroscope[0][0];
+		return static_cast<int64_t>(Count);
+	}));
+	// The vector kernel must reproduce the scalar reference exactly, also with uneven per-axis conversions
+	for (int i = 0; i < Count; ++i) {
+		const JoyCon::ImuConversion& Conversion = BatchConversions[i % BatchSize];
+		JoyCon::ConvertImuReportScalar(&Corpus[i * JoyCon::ReportLength], Conversion, ScalarArrays, static_cast<size_t>(i) * JoyCon::ImuSamplesPerReport);
+		JoyCon::ConvertImuReport(&Corpus[i * JoyCon::ReportLength], Conversion, VectorArrays, static_cast<size_t>(i) * JoyCon::ImuSamplesPerReport);
+	}
+	const bool bKernelMatchesScalar = std::memcmp(&KernelValues[0], &KernelValues[KernelValues.size() / 2], KernelValues.size() / 2 * sizeof(float)) == 0;
+	Results.push_back(Measure("ProcessImuReport", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) Imu.ProcessReport(&Corpus[i * JoyCon::ReportLength], Calibration.Imu);
+		Sink = Sink + Imu.Filter.K.Z;
+		return static_cast<int64_t>(Count);
+	}));
+	JoyCon::ImuProcessor QuaternionImu;
+	QuaternionImu.QuaternionFilter.SetGain(MadgwickBeta);
+	Results.push_back(Measure("ProcessImuReportMadgwick", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) QuaternionImu.ProcessReport(&Corpus[i * JoyCon::ReportLength], Calibration.Imu);
+		Sink = Sink + QuaternionImu.QuaternionFilter.GetState().W;
+		return static_cast<int64_t>(Count);
+	}));
+	QuaternionImu.SetFilterType(JoyCon::OrientationFilterType::Mahony);
+	QuaternionImu.QuaternionFilter.SetGain(MahonyGain);
+	Results.push_back(Measure("ProcessImuReportMahony", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) QuaternionImu.ProcessReport(&Corpus[i * JoyCon::ReportLength], Calibration.Imu);
+		Sink = Sink + QuaternionImu.QuaternionFilter.GetState().W;
+		return static_cast<int64_t>(Count);
+	}));
+	std::vector<JoyCon::ImuSample> GestureCorpus(static_cast<size_t>(Count) * JoyCon::ImuSamplesPerReport);
+	for (int i = 0; i < Count; ++i) {
+		for (int n = 0; n < JoyCon::ImuSamplesPerReport; ++n) {
+			GestureCorpus[i * JoyCon::ImuSamplesPerReport + n] = JoyCon::ConvertImuSample(JoyCon::DecodeImuSample(&Corpus[i * JoyCon::ReportLength], n), Calibration.Imu);
+		}
+	}
+	JoyCon::GestureRecognizer CorpusGestures;
+	uint64_t GestureTick = 0;
+	Results.push_back(Measure("RecognizeGestures", Iterations, [&]() {
+		JoyCon::GestureEvent Events[JoyCon::MaxGestureEventsPerSample];
+		int Found = 0;
+		for (size_t i = 0; i < GestureCorpus.size(); ++i) Found += CorpusGestures.Update(GestureCorpus[i], ++GestureTick, Events);
+		Sink = Sink + static_cast<float>(Found);
+		return static_cast<int64_t>(Count);
+	}));
+	Results.push_back(Measure("CenterStick", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) {
+			uint16_t Raw[2];
+			JoyCon::DecodeStick(&Corpus[i * JoyCon::ReportLength], bIsLeft, Raw);
+			JoyCon::CenterStick(Raw, Calibration.Stick, Input.Stick);
+		}
+		Sink = Sink + Input.Stick[1];
+		return static_cast<int64_t>(Count);
+	}));
+	Results.push_back(Measure("EncodeRumble", Iterations, [&]() {
+		uint8_t Rumble[8];
+		for (int i = 0; i < Count; ++i) {
+			JoyCon::EncodeRumble(160.0f + (i & 0xff), 320.0f + (i & 0x1ff), (i & 0x3f) / 63.0f, Rumble);
+			Sink = Sink + Rumble[3];
+		}
+		return static_cast<int64_t>(Count);
+	}));
+	Results.push_back(Measure("GetOrientation", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) {
+			Imu.Filter.I.X = 1.0f - (i & 0xf) * 0.01f;
+			Sink = Sink + Imu.Filter.GetOrientation().W;
+		}
+		return static_cast<int64_t>(Count);
+	}));
+	Results.push_back(Measure("GetOrientationQuaternion", Iterations, [&]() {
+		for (int i = 0; i < Count; ++i) Sink = Sink + QuaternionImu.GetOrientation().W;
+		return static_cast<int64_t>(Count);
+	}));
+
+	// Tilt accuracy of every filter, against the known motion or, for a capture, against the accelerometer while the
+	// device is close to rest. Yaw is left out, no filter can observe it without a magnetometer.
+	struct FilterAccuracy {
+		const char* Name;
+		JoyCon::OrientationFilterType Type;
+		float Gain;
+		double MeanTiltDegrees;
+		double MaxTiltDegrees;
+		int Samples;
+	};
+	FilterAccuracy Accuracy[] = {
+		{ "Basis", JoyCon::OrientationFilterType::Basis, BasisWeight, 0.0, 0.0, 0 },
+		{ "Madgwick", JoyCon::OrientationFilterType::Madgwick, MadgwickBeta, 0.0, 0.0, 0 },
+		{ "Mahony", JoyCon::OrientationFilterType::Mahony, MahonyGain, 0.0, 0.0, 0 },
+	};
+	std::vector<uint8_t> AccuracyCorpus;
+	std::vector<JoyCon::Vector3> TruthWorldZ;
+	if (LogFilename != nullptr) AccuracyCorpus = Corpus;
+	else BuildMotionCorpus(Count, Seed, AccuracyCorpus, TruthWorldZ);
+	// Skip the first second while the filters converge from the identity orientation
+	const int WarmupReports = 67;
+	for (FilterAccuracy& Filter : Accuracy) {
+		JoyCon::ImuProcessor Processor;
+		Processor.SetFilterType(Filter.Type);
+		Processor.SetFilterGain(Filter.Gain);
+		double Sum = 0.0;
+		for (int i = 0; i < Count; ++i) {
+			Processor.ProcessReport(&AccuracyCorpus[i * JoyCon::ReportLength], Calibration.Imu);
+			if (i < WarmupReports) continue;
+			JoyCon::Vector3 Reference;
+			if (!TruthWorldZ.empty()) {
+				Reference = TruthWorldZ[i];
+			} else {
+				const JoyCon::Vector3 Accel = Processor.GetLatestSample().Accelerometer;
+				if (std::fabs(std::sqrt(JoyCon::Vector3::Dot(Accel, Accel)) - 1.0f) > 0.05f) continue;
+				Reference = (-Accel).GetSafeNormal();
+			}
+			const float Cosine = JoyCon::Vector3::Dot(WorldZFromOrientation(Processor.GetOrientation()).GetSafeNormal(), Reference);
+			const double Degrees = std::acos(Cosine > 1.0f ? 1.0f : (Cosine < -1.0f ? -1.0f : Cosine)) * 57.29577951;
+			Sum += Degrees;
+			if (Degrees > Filter.MaxTiltDegrees) Filter.MaxTiltDegrees = Degrees;
+			Filter.Samples++;
+		}
+		Filter.MeanTiltDegrees = Filter.Samples > 0 ? Sum / Filter.Samples : 0.0;
+	}
+
+	// Heading drift of a device at rest with a biased gyroscope, with and without the bias estimator. The tilt is held
+	// by gravity either way, the heading only by the bias correction.
+	const JoyCon::Vector3 RestBias(0.03f, -0.02f, 0.015f);
+	std::vector<uint8_t> RestCorpus;
+	BuildRestCorpus(Count, Seed, RestBias, RestCorpus);
+	double RestDriftDegrees[2] = {};
+	JoyCon::Vector3 EstimatedBias;
+	float BiasConfidence = 0.0f;
+	for (int Pass = 0; Pass < 2; ++Pass) {
+		JoyCon::ImuProcessor Processor;
+		Processor.SetFilterGain(MadgwickBeta);
+		Processor.SetGyroBiasEstimation(Pass == 1);
+		for (int i = 0; i < Count; ++i) Processor.ProcessReport(&RestCorpus[i * JoyCon::ReportLength], Calibration.Imu);
+		const float W = std::fabs(Processor.QuaternionFilter.GetState().W);
+		RestDriftDegrees[Pass] = 2.0 * std::acos(W > 1.0f ? 1.0f : W) * 57.29577951;
+		EstimatedBias = Processor.GyroBias.GetBias();
+		BiasConfidence = Processor.GyroBias.GetConfidence();
+	}
+	const JoyCon::Vector3 BiasError = EstimatedBias - RestBias;
+
+	// Orientation error against the orientation the filter actually reaches 30 ms later, with and without prediction
+	const int PredictionReports = 2;
+	const float PredictionSeconds = PredictionReports * JoyCon::ImuSamplesPerReport * JoyCon::DeviceTimerPeriod;
+	double PredictionError[2] = {};
+	int PredictionSamples = 0;
+	{
+		std::vector<JoyCon::Quaternion> Actual(Count);
+		std::vector<JoyCon::Quaternion> Predicted(Count);
+		std::vector<JoyCon::Quaternion> Held(Count);
+		JoyCon::ImuProcessor Processor;
+		Processor.SetFilterGain(MadgwickBeta);
+		for (int i = 0; i < Count; ++i) {
+			Processor.ProcessReport(&AccuracyCorpus[i * JoyCon::ReportLength], Calibration.Imu);
+			Actual[i] = Processor.GetOrientation();
+			Held[i] = Actual[i];
+			Predicted[i] = Processor.PredictOrientation(PredictionSeconds);
+		}
+		auto AngleBetween = [](const JoyCon::Quaternion& A, const JoyCon::Quaternion& B) {
+			const float Dot = std::fabs(A.X * B.X + A.Y * B.Y + A.Z * B.Z + A.W * B.W);
+			return 2.0 * std::acos(Dot > 1.0f ? 1.0f : Dot) * 57.29577951;
+		};
+		for (int i = WarmupReports; i + PredictionReports < Count; ++i) {
+			PredictionError[0] += AngleBetween(Held[i], Actual[i + PredictionReports]);
+			PredictionError[1] += AngleBetween(Predicted[i], Actual[i + PredictionReports]);
+			PredictionSamples++;
+		}
+	}
+
+	// Gravity as seen by a unit whose accelerometer is off by its factory origin and sensitivity, converted with the
+	// nominal scale and with the unit's calibration folded in
+	JoyCon::Calibration Unit = Calibration;
+	const int16_t UnitOrigin[3] = { 40, -60, 25 };
+	const int16_t UnitSpan[3] = { 16384 + 320, 16384 - 260, 16384 + 180 };
+	for (int i = 0; i < 3; ++i) {
+		Unit.AccelNeutral[i] = UnitOrigin[i];
+		Unit.AccelSensitivity[i] = static_cast<int16_t>(UnitOrigin[i] + UnitSpan[i]);
+		Unit.GyroSensitivity[i] = 13371;
+	}
+	JoyCon::ComputeImuConversion(Unit);
+	const JoyCon::ImuConversion Nominal;
+	double MagnitudeError[2] = {};
+	double DirectionError[2] = {};
+	std::mt19937 GravityRandom(Seed);
+	std::normal_distribution<float> GravityNoise(0.0f, 1.0f);
+	const int GravityDirections = 1000;
+	for (int d = 0; d < GravityDirections; ++d) {
+		const JoyCon::Vector3 Gravity = JoyCon::Vector3(GravityNoise(GravityRandom), GravityNoise(GravityRandom), GravityNoise(GravityRandom)).GetSafeNormal();
+		JoyCon::RawImuSample Raw = {};
+		for (int i = 0; i < 3; ++i) Raw.Accelerometer[i] = static_cast<int16_t>(std::lround(UnitOrigin[i] + Gravity[i] * UnitSpan[i] / 4.0f));
+		const JoyCon::ImuConversion* Conversions[2] = { &Nominal, &Unit.Imu };
+		for (int c = 0; c < 2; ++c) {
+			const JoyCon::Vector3 Accel = JoyCon::ConvertImuSample(Raw, *Conversions[c]).Accelerometer;
+			MagnitudeError[c] += std::fabs(std::sqrt(JoyCon::Vector3::Dot(Accel, Accel)) - 1.0f);
+			const float Cosine = JoyCon::Vector3::Dot(Accel.GetSafeNormal(), Gravity);
+			DirectionError[c] += std::acos(Cosine > 1.0f ? 1.0f : Cosine) * 57.29577951;
+		}
+	}
+
+	// Two minutes of reports from a device whose crystal runs 150 ppm slow, read after a random transport delay, with a
+	// share of the reports and one two second stretch lost on the radio
+	const int ClockReports = 8000;
+	const int ClockWarmupReports = 1000;
+	const double TruePeriod = JoyCon::DeviceTimerPeriod * (1.0 + 150e-6);
+	double ClockError[2] = {};
+	int ClockSamples = 0;
+	uint64_t ClockLostInjected = 0;
+	uint64_t ClockLostDetected = 0;
+	double ClockPeriodError = 0.0;
+	{
+		std::mt19937 ClockRandom(Seed);
+		std::exponential_distribution<double> Latency(1.0 / 0.003);
+		std::uniform_real_distribution<double> Loss(0.0, 1.0);
+		JoyCon::DeviceClock Clock;
+		const double HostOrigin = 1000.0;
+		uint64_t DeviceTick = 17;
+		for (int i = 0; i < ClockReports; ++i) {
+			DeviceTick += JoyCon::ImuSamplesPerReport;
+			if (i == ClockReports / 2) {
+				DeviceTick += 400 * JoyCon::ImuSamplesPerReport;
+				ClockLostInjected += 400;
+			}
+			if (Loss(ClockRandom) < 0.01) {
+				ClockLostInjected++;
+				continue;
+			}
+			const double SampleTime = HostOrigin + DeviceTick * TruePeriod;
+			const double Arrival = SampleTime + 0.001 + Latency(ClockRandom);
+			const uint64_t Tick = Clock.Observe(static_cast<uint8_t>(DeviceTick & 0xff), Arrival);
+			if (i < ClockWarmupReports) continue;
+			ClockError[0] += std::fabs(Arrival - SampleTime);
+			ClockError[1] += std::fabs(Clock.ToHostSeconds(Tick) - SampleTime);
+			ClockSamples++;
+		}
+		ClockLostDetected = Clock.GetLostReports();
+		ClockPeriodError = Clock.GetTickPeriod() / TruePeriod - 1.0;
+	}
+
+	// A scripted session with one of each gesture between rests, plus a twist that must not count as a flick
+	struct GestureScript {
+		JoyCon::GestureType Type;
+		JoyCon::FlickDirection Direction;
+		int Axis;
+		float Peak;
+		float Seconds;
+	};
+	const GestureScript Script[] = {
+		{ JoyCon::GestureType::Swing, JoyCon::FlickDirection::None, 2, 15.0f, 0.4f },
+		{ JoyCon::GestureType::Flick, JoyCon::FlickDirection::Up, 1, 9.0f, 0.08f },
+		{ JoyCon::GestureType::Flick, JoyCon::FlickDirection::Right, 2, -9.0f, 0.08f },
+		{ JoyCon::GestureType::Flick, JoyCon::FlickDirection::None, 0, 9.0f, 0.08f },
+		{ JoyCon::GestureType::Shake, JoyCon::FlickDirection::None, 0, 2.5f, 1.0f },
+	};
+	const int GestureCount = static_cast<int>(sizeof(Script) / sizeof(Script[0]));
+	int GesturesExpected = 0;
+	int GesturesDetected = 0;
+	int GesturesCorrect = 0;
+	double GestureLatency = 0.0;
+	{
+		std::mt19937 GestureRandom(Seed);
+		std::normal_distribution<float> Noise(0.0f, 0.01f);
+		JoyCon::GestureRecognizer Recognizer;
+		uint64_t Tick = 0;
+		auto Feed = [&](JoyCon::ImuSample Sample, const GestureScript* Expected, const uint64_t PeakTick) {
+			for (int i = 0; i < 3; ++i) {
+				Sample.Accelerometer[i] += Noise(GestureRandom);
+				Sample.Gyroscope[i] += Noise(GestureRandom);
+			}
+			JoyCon::GestureEvent Events[JoyCon::MaxGestureEventsPerSample];
+			const int Found = Recognizer.Update(Sample, ++Tick, Events);
+			for (int e = 0; e < Found; ++e) {
+				GesturesDetected++;
+				if (Expected == nullptr || Events[e].Type != Expected->Type || Events[e].Direction != Expected->Direction) continue;
+				GesturesCorrect++;
+				GestureLatency += (static_cast<double>(Events[e].Tick) - static_cast<double>(PeakTick)) * JoyCon::DeviceTimerPeriod;
+			}
+		};
+		const JoyCon::Vector3 Gravity(0.0f, 0.0f, 1.0f);
+		for (int g = 0; g < GestureCount; ++g) {
+			const GestureScript& Gesture = Script[g];
+			const bool bShouldDetect = Gesture.Type != JoyCon::GestureType::Flick || Gesture.Direction != JoyCon::FlickDirection::None;
+			if (bShouldDetect) GesturesExpected++;
+			for (int n = 0; n < 200; ++n) Feed({ Gravity, JoyCon::Vector3() }, nullptr, 0);
+			const int Samples = static_cast<int>(Gesture.Seconds / JoyCon::DeviceTimerPeriod);
+			// Shakes peak on every stroke, the fourth reversal is the earliest they can be told apart from a bump
+			const uint64_t PeakTick = Tick + (Gesture.Type == JoyCon::GestureType::Shake ? static_cast<uint64_t>(Samples * 2 / 5) : static_cast<uint64_t>(Samples / 2));
+			for (int n = 0; n < Samples; ++n) {
+				const float Phase = (n + 0.5f) / Samples;
+				JoyCon::ImuSample Sample = { Gravity, JoyCon::Vector3() };
+				if (Gesture.Type == JoyCon::GestureType::Shake) Sample.Accelerometer[Gesture.Axis] += Gesture.Peak * std::sin(2.0f * 3.14159265f * 5.0f * Gesture.Seconds * Phase);
+				else Sample.Gyroscope[Gesture.Axis] = Gesture.Peak * std::sin(3.14159265f * Phase);
+				Feed(Sample, bShouldDetect ? &Gesture : nullptr, PeakTick);
+			}
+			if (Gesture.Type == JoyCon::GestureType::Flick) {
+				// The wrist springs back after a snap
+				for (int n = 0; n < 20; ++n) {
+					JoyCon::ImuSample Sample = { Gravity, JoyCon::Vector3() };
+					Sample.Gyroscope[Gesture.Axis] = -0.6f * Gesture.Peak * std::sin(3.14159265f * (n + 0.5f) / 20);
+					Feed(Sample, nullptr, 0);
+				}
+			}
+		}
+		for (int n = 0; n < 200; ++n) Feed({ Gravity, JoyCon::Vector3() }, nullptr, 0);
+	}
+
+	std::printf("{\n\t\"corpus\": \"%s\",\n\t\"reports\": %d,\n\t\"iterations\": %d,\n\t\"imu_kernel\": \"%s\",\n\t\"imu_kernel_matches_scalar\": %s,\n\t\"benchmarks\": [\n",
+		LogFilename ? LogFilename : "synthetic", Count, Iterations, JoyCon::GetImuKernelName(), bKernelMatchesScalar ? "true" : "false");
+	for (size_t i = 0; i < Results.size(); ++i) {
+		const BenchResult& Result = Results[i];
+		std::printf("\t\t{ \"name\": \"%s\", \"operations\": %lld, \"ns_per_report\": %.3f, \"reports_per_second_per_core\": %.1f, \"allocations_per_report\": %.4f }%s\n",
+			Result.Name, static_cast<long long>(Result.Operations), Result.NsPerOperation, Result.NsPerOperation > 0.0 ? 1e9 / Result.NsPerOperation : 0.0,
+			Result.AllocationsPerOperation, i + 1 < Results.size() ? "," : "");
+	}
+	std::printf("\t],\n\t\"tilt_reference\": \"%s\",\n\t\"filters\": [\n", TruthWorldZ.empty() ? "accelerometer_at_rest" : "synthetic_motion");
+	for (size_t i = 0; i < sizeof(Accuracy) / sizeof(Accuracy[0]); ++i) {
+		const FilterAccuracy& Filter = Accuracy[i];
+		std::printf("\t\t{ \"name\": \"%s\", \"gain\": %.3f, \"samples\": %d, \"mean_tilt_error_degrees\": %.3f, \"max_tilt_error_degrees\": %.3f }%s\n",
+			Filter.Name, Filter.Gain, Filter.Samples, Filter.MeanTiltDegrees, Filter.MaxTiltDegrees, i + 1 < sizeof(Accuracy) / sizeof(Accuracy[0]) ? "," : "");
+	}
+	std::printf("\t],\n\t\"gyro_bias\": { \"seconds_at_rest\": %.1f, \"bias_error_rad_per_second\": %.5f, \"confidence\": %.3f, \"heading_drift_degrees\": %.3f, \"heading_drift_uncorrected_degrees\": %.3f },\n",
+		Count * JoyCon::ImuSamplesPerReport * JoyCon::DeviceTimerPeriod, std::sqrt(JoyCon::Vector3::Dot(BiasError, BiasError)), BiasConfidence, RestDriftDegrees[1], RestDriftDegrees[0]);
+	std::printf("\t\"prediction\": { \"ahead_seconds\": %.3f, \"held_error_degrees\": %.3f, \"predicted_error_degrees\": %.3f },\n",
+		PredictionSeconds, PredictionSamples > 0 ? PredictionError[0] / PredictionSamples : 0.0, PredictionSamples > 0 ? PredictionError[1] / PredictionSamples : 0.0);
+	std::printf("\t\"accel_calibration\": { \"directions\": %d, \"nominal_magnitude_error_g\": %.4f, \"calibrated_magnitude_error_g\": %.4f, \"nominal_direction_error_degrees\": %.3f, \"calibrated_direction_error_degrees\": %.3f },\n",
+		GravityDirections, MagnitudeError[0] / GravityDirections, MagnitudeError[1] / GravityDirections, DirectionError[0] / GravityDirections, DirectionError[1] / GravityDirections);
+	std::printf("\t\"clock\": { \"reports\": %d, \"arrival_error_ms\": %.3f, \"fitted_error_ms\": %.3f, \"period_error_ppm\": %.1f, \"lost_reports\": %llu, \"lost_reports_detected\": %llu },\n",
+		ClockReports, ClockSamples > 0 ? 1000.0 * ClockError[0] / ClockSamples : 0.0, ClockSamples > 0 ? 1000.0 * ClockError[1] / ClockSamples : 0.0, ClockPeriodError * 1e6,
+		static_cast<unsigned long long>(ClockLostInjected), static_cast<unsigned long long>(ClockLostDetected));
+	std::printf("\t\"gestures\": { \"expected\": %d, \"detected\": %d, \"correct\": %d, \"mean_latency_after_peak_ms\": %.1f }\n}\n",
+		GesturesExpected, GesturesDetected, GesturesCorrect, GesturesCorrect > 0 ? 1000.0 * GestureLatency / GesturesCorrect : 0.0);
+	return 0;
+}
+
+#endif
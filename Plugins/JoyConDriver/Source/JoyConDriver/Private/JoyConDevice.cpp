@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConDevice.h"
+
+FJoyConHidDevice::FJoyConHidDevice(hid_device* InHandle) : Handle(InHandle) {
+}
+
+FJoyConHidDevice::~FJoyConHidDevice() {
+	if (Handle != nullptr) {
+		hid_close(Handle);
+		Handle = nullptr;
+	}
+}
+
+int32 FJoyConHidDevice::Read(uint8* Data, const size_t Length, const int32 Milliseconds) {
+	return hid_read_timeout(Handle, Data, Length, Milliseconds);
+}
+
+int32 FJoyConHidDevice::Write(const uint8* Data, const size_t Length) {
+	return hid_write(Handle, Data, Length);
+}
+
+intptr_t FJoyConHidDevice::GetPollHandle() {
+	return hid_get_poll_handle(Handle);
+}
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "hidapi.h"
+#include "JoyConCore/JoyConCoreTypes.h"
+
+/**
+ * Transport used by FJoyConController. Read and Write follow the hidapi contract documented on JoyCon::ITransport,
+ * the device additionally exposes a handle the I/O reactor can wait on.
+ */
+class IJoyConDevice : public JoyCon::ITransport {
+
+public:
+	/** Handle that can be waited on for input (see hid_get_poll_handle), or -1 if the device has to be polled */
+	virtual intptr_t GetPollHandle() = 0;
+
+	/** True for hardware whose serial number identifies the same controller across sessions */
+	virtual bool HasStableIdentity() const { return false; }
+};
+
+/** IJoyConDevice backed by a real hidapi device, closes the handle on destruction */
+class FJoyConHidDevice : public IJoyConDevice {
+
+public:
+	explicit FJoyConHidDevice(hid_device* InHandle);
+	virtual ~FJoyConHidDevice();
+
+	virtual int32 Read(uint8* Data, size_t Length, int32 Milliseconds) override;
+	virtual int32 Write(const uint8* Data, size_t Length) override;
+	virtual intptr_t GetPollHandle() override;
+	virtual bool HasStableIdentity() const override { return true; }
+
+private:
+	hid_device* Handle;
+};
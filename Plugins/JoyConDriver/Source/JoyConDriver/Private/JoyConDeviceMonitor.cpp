@@ -0,0 +1,231 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConDeviceMonitor.h"
+
+#include "hidapi.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+
+#if PLATFORM_LINUX
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#elif PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include <cfgmgr32.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+// Upper bound for a single wait, so Stop() is honoured even if waking fails
+static constexpr int32 MonitorWaitTimeoutMs = 1000;
+// Rescan interval when the platform does not report device changes
+static constexpr int32 MonitorRescanIntervalMs = 2000;
+
+#if PLATFORM_WINDOWS
+typedef CONFIGRET (WINAPI *FCmRegisterNotification)(PCM_NOTIFY_FILTER, PVOID, PCM_NOTIFY_CALLBACK, PHCMNOTIFICATION);
+typedef CONFIGRET (WINAPI *FCmUnregisterNotification)(HCMNOTIFICATION);
+
+// GUID_DEVINTERFACE_HID, spelled out to avoid pulling in hidclass.h and initguid.h
+static const GUID HidInterfaceGuid = { 0x4d1e55b2, 0xf16f, 0x11cf, { 0x88, 0xcb, 0x00, 0x11, 0x11, 0x00, 0x00, 0x30 } };
+
+static DWORD CALLBACK OnHidInterfaceChanged(HCMNOTIFICATION, PVOID Context, CM_NOTIFY_ACTION Action, PCM_NOTIFY_EVENT_DATA, DWORD) {
+	if (Action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL || Action == CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL) {
+		SetEvent(static_cast<HANDLE>(Context));
+	}
+	return ERROR_SUCCESS;
+}
+#endif
+
+FJoyConDeviceMonitor::FJoyConDeviceMonitor() :
+	Thread(nullptr),
+	bStopping(false),
+	Generation(0),
+	bHasNotifications(false) {
+	// Subscribe before the initial snapshot, so nothing plugged in between is missed
+#if PLATFORM_LINUX
+	UeventFd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (UeventFd >= 0) {
+		sockaddr_nl Address = {};
+		Address.nl_family = AF_NETLINK;
+		Address.nl_groups = 1; // Kernel uevents, no udev daemon involved
+		if (bind(UeventFd, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) != 0) {
+			close(UeventFd);
+			UeventFd = -1;
+		}
+	}
+	bHasNotifications = UeventFd >= 0 && WakeSignal.IsValid();
+#elif PLATFORM_WINDOWS
+	Notification = nullptr;
+	// Loaded at runtime like hid.dll, CM_Register_Notification needs Windows 8
+	CfgMgr = LoadLibraryA("cfgmgr32.dll");
+	if (CfgMgr != nullptr && WakeSignal.IsValid()) {
+		const FCmRegisterNotification Register = reinterpret_cast<FCmRegisterNotification>(GetProcAddress(static_cast<HMODULE>(CfgMgr), "CM_Register_Notification"));
+		if (Register != nullptr) {
+			CM_NOTIFY_FILTER Filter = {};
+			Filter.cbSize = sizeof(Filter);
+			Filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+			Filter.u.DeviceInterface.ClassGuid = HidInterfaceGuid;
+			HCMNOTIFICATION Handle = nullptr;
+			if (Register(&Filter, reinterpret_cast<HANDLE>(WakeSignal.GetWaitHandle()), OnHidInterfaceChanged, &Handle) == CR_SUCCESS) Notification = Handle;
+		}
+	}
+	bHasNotifications = Notification != nullptr;
+#endif
+	if (!bHasNotifications) {
+		UE_LOG(LogTemp, Log, TEXT("No device change notifications available, JoyCons are rescanned every %d ms."), MonitorRescanIntervalMs);
+	}
+}
+
+FJoyConDeviceMonitor::~FJoyConDeviceMonitor() {
+	if (Thread != nullptr) {
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+#if PLATFORM_LINUX
+	if (UeventFd >= 0) close(UeventFd);
+#elif PLATFORM_WINDOWS
+	if (Notification != nullptr) {
+		const FCmUnregisterNotification Unregister = reinterpret_cast<FCmUnregisterNotification>(GetProcAddress(static_cast<HMODULE>(CfgMgr), "CM_Unregister_Notification"));
+		if (Unregister != nullptr) Unregister(static_cast<HCMNOTIFICATION>(Notification));
+	}
+	if (CfgMgr != nullptr) FreeLibrary(static_cast<HMODULE>(CfgMgr));
+#endif
+}
+
+void FJoyConDeviceMonitor::Enumerate(TArray<FJoyConInformation>& Out) {
+	Out.Reset();
+	hid_device_info* Devices = hid_enumerate(0x57e, 0x0);
+	for (hid_device_info* Device = Devices; Device != nullptr; Device = Device->next) {
+		if (Device->product_id != 0x2006 && Device->product_id != 0x2007) continue;
+		Out.Add(FJoyConInformation(
+			Device->product_id,
+			Device->vendor_id,
+			Device->interface_number,
+			Device->release_number,
+			FString(Device->manufacturer_string),
+			FString(Device->path),
+			FString(Device->product_string),
+			FString(Device->serial_number),
+			0,
+			Device->usage,
+			Device->usage_page,
+			Device->product_id == 0x2006,
+			false
+		));
+	}
+	hid_free_enumeration(Devices);
+}
+
+bool FJoyConDeviceMonitor::Start() {
+	if (Thread != nullptr) return true;
+	Rescan();
+	// The initial snapshot is not reported as arrivals
+	{
+		FScopeLock Lock(&Mutex);
+		Events.Reset();
+	}
+	if (!FPlatformProcess::SupportsMultithreading()) return false;
+	bStopping = false;
+	Thread = FRunnableThread::Create(this, TEXT("FJoyConDeviceMonitor"), 0, EThreadPriority::TPri_BelowNormal);
+	return Thread != nullptr;
+}
+
+void FJoyConDeviceMonitor::GetDevices(TArray<FJoyConInformation>& Out) {
+	FScopeLock Lock(&Mutex);
+	Out = Devices;
+}
+
+void FJoyConDeviceMonitor::ConsumeEvents(TArray<FJoyConDeviceEvent>& Out) {
+	Out.Reset();
+	FScopeLock Lock(&Mutex);
+	Swap(Out, Events);
+}
+
+bool FJoyConDeviceMonitor::Init() {
+	return true;
+}
+
+uint32 FJoyConDeviceMonitor::Run() {
+	while (!bStopping) {
+		if (WaitForChange() && !bStopping) Rescan();
+	}
+	return 0;
+}
+
+void FJoyConDeviceMonitor::Stop() {
+	bStopping = true;
+	WakeSignal.Trigger();
+}
+
+bool FJoyConDeviceMonitor::WaitForChange() {
+	if (!bHasNotifications) {
+		FPlatformProcess::Sleep(MonitorRescanIntervalMs / 1000.0f);
+		return true;
+	}
+#if PLATFORM_LINUX
+	pollfd Fds[2] = { { UeventFd, POLLIN, 0 }, { static_cast<int>(WakeSignal.GetWaitHandle()), POLLIN, 0 } };
+	if (poll(Fds, 2, MonitorWaitTimeoutMs) <= 0) return false;
+	if (Fds[1].revents & POLLIN) WakeSignal.Drain();
+	// Drain everything queued so a burst of uevents costs a single rescan
+	bool bHidrawChanged = false;
+	char Buffer[4096];
+	for (;;) {
+		const ssize_t Length = recv(UeventFd, Buffer, sizeof(Buffer) - 1, 0);
+		if (Length < 0) {
+			if (errno == EINTR) continue;
+			// ENOBUFS means the socket overflowed during a burst and uevents were lost, only a rescan can tell what
+			// changed. Any other failure is treated the same rather than missing a controller.
+			if (errno != EAGAIN && errno != EWOULDBLOCK) bHidrawChanged = true;
+			break;
+		}
+		if (Length == 0) break;
+		Buffer[Length] = '\0';
+		// "ACTION@DEVPATH" followed by NUL separated KEY=VALUE pairs
+		for (const char* Field = Buffer; Field < Buffer + Length; Field += strlen(Field) + 1) {
+			if (strcmp(Field, "SUBSYSTEM=hidraw") == 0) {
+				bHidrawChanged = true;
+				break;
+			}
+		}
+	}
+	return bHidrawChanged;
+#elif PLATFORM_WINDOWS
+	return WaitForSingleObject(reinterpret_cast<HANDLE>(WakeSignal.GetWaitHandle()), MonitorWaitTimeoutMs) == WAIT_OBJECT_0;
+#else
+	return false;
+#endif
+}
+
+void FJoyConDeviceMonitor::Rescan() {
+	TArray<FJoyConInformation> Found;
+	Enumerate(Found);
+	FScopeLock Lock(&Mutex);
+	bool bChanged = false;
+	for (int32 i = Devices.Num() - 1; i >= 0; --i) {
+		const FJoyConInformation& Device = Devices[i];
+		const bool bStillPresent = Found.ContainsByPredicate([&Device](const FJoyConInformation& Other) {
+			return Other.BluetoothPath == Device.BluetoothPath && Other.SerialNumber == Device.SerialNumber;
+		});
+		if (bStillPresent) continue;
+		Events.Add(FJoyConDeviceEvent{ Device, false });
+		Devices.RemoveAt(i);
+		bChanged = true;
+	}
+	for (const FJoyConInformation& Device : Found) {
+		const bool bKnown = Devices.ContainsByPredicate([&Device](const FJoyConInformation& Other) {
+			return Other.BluetoothPath == Device.BluetoothPath && Other.SerialNumber == Device.SerialNumber;
+		});
+		if (bKnown) continue;
+		Events.Add(FJoyConDeviceEvent{ Device, true });
+		Devices.Add(Device);
+		bChanged = true;
+	}
+	if (bChanged) Generation++;
+}
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "JoyConInformation.h"
+#include "JoyConWakeSignal.h"
+
+struct FJoyConDeviceEvent {
+	FJoyConInformation Information;
+	bool bArrived;
+};
+
+/**
+ * Keeps a table of the Joy-Cons present on the system up to date from hot-plug notifications (a kernel uevent socket
+ * on Linux, CM_Register_Notification on Windows) instead of enumerating on every query. The table is only rescanned
+ * when the system reports a HID device change, platforms without notifications fall back to a slow periodic rescan.
+ */
+class FJoyConDeviceMonitor : public FRunnable {
+
+public:
+	FJoyConDeviceMonitor();
+	virtual ~FJoyConDeviceMonitor();
+
+	/** Enumerates the Joy-Cons currently present, ordered as hidapi reports them */
+	static void Enumerate(TArray<FJoyConInformation>& Out);
+
+	/** Takes the initial snapshot and starts the monitor thread */
+	bool Start();
+
+	/** Copies the current device table, this does not touch the system */
+	void GetDevices(TArray<FJoyConInformation>& Out);
+
+	/** Incremented whenever the device table changes, so callers can skip copying an unchanged snapshot */
+	uint32 GetGeneration() const { return Generation; }
+
+	/** Moves the arrivals and removals seen since the last call into Out */
+	void ConsumeEvents(TArray<FJoyConDeviceEvent>& Out);
+
+	// FRunnable interface overrides
+	virtual bool Init() override;
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/** Blocks until the system reported a device change or the wait timed out, returns true if a rescan is due */
+	bool WaitForChange();
+	void Rescan();
+
+private:
+	TArray<FJoyConInformation> Devices;
+	TArray<FJoyConDeviceEvent> Events;
+	FCriticalSection Mutex;
+	FRunnableThread* Thread;
+	TAtomic<bool> bStopping;
+	TAtomic<uint32> Generation;
+	/** False if the platform gave us no change notifications and the monitor rescans periodically */
+	bool bHasNotifications;
+	/** Stops the wait for a change, on Windows the device notifications trigger it too */
+	FJoyConWakeSignal WakeSignal;
+
+#if PLATFORM_LINUX
+	int UeventFd;
+#elif PLATFORM_WINDOWS
+	void* CfgMgr;
+	void* Notification;
+#endif
+};
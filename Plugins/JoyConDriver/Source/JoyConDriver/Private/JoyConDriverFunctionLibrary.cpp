@@ -36,6 +36,18 @@ void UJoyConDriverFunctionLibrary::AttachJoyCon(const int ControllerId, const in
 	}
 }
 
+void UJoyConDriverFunctionLibrary::AttachJoyConAsync(const int ControllerId, const int GripIndex, const FJoyConAttachCompleteDynamic& OnComplete, bool& Success) {
+	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
+	Success = false;
+	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
+		if (JoyConInputApi == nullptr) continue;
+		Success = JoyConInputApi->Get().AttachJoyConAsync(ControllerId, GripIndex, FOnJoyConAttachComplete::CreateLambda([OnComplete](const int Id, const bool bSuccess, const float AttachSeconds) {
+			OnComplete.ExecuteIfBound(Id, bSuccess, AttachSeconds);
+		}));
+		break;
+	}
+}
+
 void UJoyConDriverFunctionLibrary::DisconnectJoyCon(const int ControllerId, bool& Success) {
 	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
 	Success = false;
@@ -58,47 +70,40 @@ void UJoyConDriverFunctionLibrary::DetachJoyCon(const int ControllerId, bool& Su
 
 void UJoyConDriverFunctionLibrary::SearchForJoyCons(TArray<FJoyConInformation>& JoyCons) {
 	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
+	JoyCons.Reset();
 	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
 		if (JoyConInputApi == nullptr) continue;
-		TArray<FJoyConInformation>* Data = JoyConInputApi->Get().SearchForJoyCons();
-		if (Data == nullptr) {
-			JoyCons = TArray<FJoyConInformation>();
-			break;
-		}
-		const TArray<FJoyConInformation> ArrayFrom = *Data;
-		JoyCons = ArrayFrom;
+		JoyConInputApi->Get().SearchForJoyCons(JoyCons);
 		break;
 	}
 }
 
 void UJoyConDriverFunctionLibrary::GetAttachedJoyCons(TArray<FJoyConInformation>& JoyCons) {
 	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
-	JoyCons = TArray<FJoyConInformation>();
+	JoyCons.Reset();
 	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
 		if (JoyConInputApi == nullptr) continue;
-		TArray<FJoyConInformation>* Data = JoyConInputApi->Get().GetAttachedJoyCons();
-		if (Data == nullptr) {
-			JoyCons = TArray<FJoyConInformation>();
-			break;
-		}
-		const TArray<FJoyConInformation> ArrayFrom = *Data;
-		JoyCons = ArrayFrom;
+		JoyConInputApi->Get().GetAttachedJoyCons(JoyCons);
 		break;
 	}
 }
 
 void UJoyConDriverFunctionLibrary::GetConnectedJoyCons(TArray<FJoyConInformation>& JoyCons) {
 	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
-	JoyCons = TArray<FJoyConInformation>();
+	JoyCons.Reset();
+	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
+		if (JoyConInputApi == nullptr) continue;
+		JoyConInputApi->Get().GetConnectedJoyCons(JoyCons);
+		break;
+	}
+}
+
+void UJoyConDriverFunctionLibrary::GetJoyConListVersion(int& Version) {
+	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
+	Version = 0;
 	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
 		if (JoyConInputApi == nullptr) continue;
-		TArray<FJoyConInformation>* Data = JoyConInputApi->Get().GetConnectedJoyCons();
-		if (Data == nullptr) {
-			JoyCons = TArray<FJoyConInformation>();
-			break;
-		}
-		const TArray<FJoyConInformation> ArrayFrom = *Data;
-		JoyCons = ArrayFrom;
+		Version = static_cast<int>(JoyConInputApi->Get().GetJoyConListVersion());
 		break;
 	}
 }
@@ -125,6 +130,29 @@ void UJoyConDriverFunctionLibrary::GetJoyConGyroscope(const int ControllerId, bo
 	}
 }
 
+void UJoyConDriverFunctionLibrary::GetJoyConGyroBias(const int ControllerId, bool& Success, FVector& Bias, float& Confidence) {
+	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
+	Success = false;
+	Bias = FVector::ZeroVector;
+	Confidence = 0.0f;
+	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
+		if (JoyConInputApi == nullptr) continue;
+		Success = JoyConInputApi->Get().GetJoyConGyroBias(ControllerId, Bias, Confidence);
+		break;
+	}
+}
+
+void UJoyConDriverFunctionLibrary::DrainJoyConImuSamples(const int ControllerId, bool& Success, TArray<FJoyConImuSample>& Samples) {
+	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
+	Success = false;
+	Samples.Reset();
+	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
+		if (JoyConInputApi == nullptr) continue;
+		Success = JoyConInputApi->Get().DrainJoyConImuSamples(ControllerId, Samples);
+		break;
+	}
+}
+
 void UJoyConDriverFunctionLibrary::GetJoyConVector(const int ControllerId, bool& Success, FRotator& Vector) {
 	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
 	Success = false;
@@ -136,6 +164,31 @@ void UJoyConDriverFunctionLibrary::GetJoyConVector(const int ControllerId, bool&
 	}
 }
 
+void UJoyConDriverFunctionLibrary::GetJoyConRecoveryStats(const int ControllerId, bool& Success, int& RecoveryCount, float& LastRecoverySeconds) {
+	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
+	Success = false;
+	RecoveryCount = 0;
+	LastRecoverySeconds = 0.0f;
+	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
+		if (JoyConInputApi == nullptr) continue;
+		Success = JoyConInputApi->Get().GetJoyConRecoveryStats(ControllerId, RecoveryCount, LastRecoverySeconds);
+		break;
+	}
+}
+
+void UJoyConDriverFunctionLibrary::GetJoyConClockStats(const int ControllerId, bool& Success, int& LostReports, int& DuplicateReports, float& TickPeriod) {
+	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
+	Success = false;
+	LostReports = 0;
+	DuplicateReports = 0;
+	TickPeriod = 0.0f;
+	for (FJoyConDriverModule* JoyConInputApi : JoyConInputApis) {
+		if (JoyConInputApi == nullptr) continue;
+		Success = JoyConInputApi->Get().GetJoyConClockStats(ControllerId, LostReports, DuplicateReports, TickPeriod);
+		break;
+	}
+}
+
 void UJoyConDriverFunctionLibrary::ReCenterJoyCon(const int ControllerId, bool& Success) {
 	TArray<FJoyConDriverModule*> JoyConInputApis = IModularFeatures::Get().GetModularFeatureImplementations<FJoyConDriverModule>(FJoyConDriverModule::GetModularFeatureName());
 	Success = false;
@@ -12,22 +12,30 @@ void FJoyConDriverModule::StartupModule() {
 	FJoyConInput::PreInit();
 }
 
-TArray<FJoyConInformation>* FJoyConDriverModule::SearchForJoyCons() const {
-	return JoyConInputDevice.Pin()->SearchJoyCons();
+void FJoyConDriverModule::SearchForJoyCons(TArray<FJoyConInformation>& Out) const {
+	JoyConInputDevice.Pin()->SearchJoyCons(Out);
 }
 
-TArray<FJoyConInformation>* FJoyConDriverModule::GetAttachedJoyCons() const {
-	return JoyConInputDevice.Pin()->GetAttachedJoyCons();
+void FJoyConDriverModule::GetAttachedJoyCons(TArray<FJoyConInformation>& Out) const {
+	JoyConInputDevice.Pin()->GetAttachedJoyCons(Out);
 }
 
-TArray<FJoyConInformation>* FJoyConDriverModule::GetConnectedJoyCons() const {
-	return JoyConInputDevice.Pin()->GetConnectedJoyCons();
+void FJoyConDriverModule::GetConnectedJoyCons(TArray<FJoyConInformation>& Out) const {
+	JoyConInputDevice.Pin()->GetConnectedJoyCons(Out);
+}
+
+uint32 FJoyConDriverModule::GetJoyConListVersion() const {
+	return JoyConInputDevice.Pin()->GetJoyConListVersion();
 }
 
 bool FJoyConDriverModule::ResumeJoyConConnection() const {
 	return JoyConInputDevice.Pin()->ResumeJoyConConnection();
 }
 
+FOnJoyConDeviceChanged& FJoyConDriverModule::OnJoyConDeviceChanged() const {
+	return JoyConInputDevice.Pin()->OnJoyConDeviceChanged();
+}
+
 bool FJoyConDriverModule::ConnectJoyCon(const FJoyConInformation JoyConInformation, const bool UseImu, const bool UseLocalize, const float Alpha, int& ControllerId) const {
 	return JoyConInputDevice.Pin()->ConnectJoyCon(JoyConInformation, UseImu, UseLocalize, Alpha, ControllerId);
 }
@@ -36,6 +44,10 @@ bool FJoyConDriverModule::AttachJoyCon(const int ControllerId, const int GripInd
 	return JoyConInputDevice.Pin()->AttachJoyCon(ControllerId, GripIndex);
 }
 
+bool FJoyConDriverModule::AttachJoyConAsync(const int ControllerId, const int GripIndex, FOnJoyConAttachComplete OnComplete) const {
+	return JoyConInputDevice.Pin()->AttachJoyConAsync(ControllerId, GripIndex, MoveTemp(OnComplete));
+}
+
 bool FJoyConDriverModule::DisconnectJoyCon(const int ControllerId) const {
 	return JoyConInputDevice.Pin()->DisconnectJoyCon(ControllerId);
 }
@@ -44,6 +56,14 @@ bool FJoyConDriverModule::DetachJoyCon(const int ControllerId) const {
 	return JoyConInputDevice.Pin()->DetachJoyCon(ControllerId);
 }
 
+bool FJoyConDriverModule::GetJoyConRecoveryStats(const int ControllerId, int& RecoveryCount, float& LastRecoverySeconds) const {
+	return JoyConInputDevice.Pin()->GetJoyConRecoveryStats(ControllerId, RecoveryCount, LastRecoverySeconds);
+}
+
+bool FJoyConDriverModule::GetJoyConClockStats(const int ControllerId, int& LostReports, int& DuplicateReports, float& TickPeriod) const {
+	return JoyConInputDevice.Pin()->GetJoyConClockStats(ControllerId, LostReports, DuplicateReports, TickPeriod);
+}
+
 bool FJoyConDriverModule::GetJoyConAccelerometer(const int ControllerId, FVector& Out) const {
 	return JoyConInputDevice.Pin()->GetJoyConAccelerometer(ControllerId, Out);
 }
@@ -52,6 +72,14 @@ bool FJoyConDriverModule::GetJoyConGyroscope(const int ControllerId, FVector& Ou
 	return JoyConInputDevice.Pin()->GetJoyConGyroscope(ControllerId, Out);
 }
 
+bool FJoyConDriverModule::GetJoyConGyroBias(const int ControllerId, FVector& Bias, float& Confidence) const {
+	return JoyConInputDevice.Pin()->GetJoyConGyroBias(ControllerId, Bias, Confidence);
+}
+
+bool FJoyConDriverModule::DrainJoyConImuSamples(const int ControllerId, TArray<FJoyConImuSample>& Out) const {
+	return JoyConInputDevice.Pin()->DrainJoyConImuSamples(ControllerId, Out);
+}
+
 bool FJoyConDriverModule::GetJoyConVector(const int ControllerId, FRotator& Out) const {
 	return JoyConInputDevice.Pin()->GetJoyConVector(ControllerId, Out);
 }
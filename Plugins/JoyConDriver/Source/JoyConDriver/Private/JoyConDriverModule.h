@@ -23,16 +23,23 @@ public:
 	virtual TSharedPtr< class IInputDevice > CreateInputDevice(const TSharedRef< FGenericApplicationMessageHandler >& InMessageHandler) override;
 
 	// IJoyConDriverModule overrides
-	virtual TArray<FJoyConInformation>* SearchForJoyCons() const override;
-	virtual TArray<FJoyConInformation>* GetAttachedJoyCons() const override;
-	virtual TArray<FJoyConInformation>* GetConnectedJoyCons() const override;
+	virtual void SearchForJoyCons(TArray<FJoyConInformation>& Out) const override;
+	virtual void GetAttachedJoyCons(TArray<FJoyConInformation>& Out) const override;
+	virtual void GetConnectedJoyCons(TArray<FJoyConInformation>& Out) const override;
+	virtual uint32 GetJoyConListVersion() const override;
 	virtual bool ResumeJoyConConnection() const override;
+	virtual FOnJoyConDeviceChanged& OnJoyConDeviceChanged() const override;
 	virtual bool ConnectJoyCon(FJoyConInformation JoyConInformation, bool UseImu, bool UseLocalize, float Alpha, int& ControllerId) const override;
 	virtual bool AttachJoyCon(int ControllerId, int GripIndex) const override;
+	virtual bool AttachJoyConAsync(int ControllerId, int GripIndex, FOnJoyConAttachComplete OnComplete) const override;
 	virtual bool DisconnectJoyCon(int ControllerId) const override;
 	virtual bool DetachJoyCon(int ControllerId) const override;
+	virtual bool GetJoyConRecoveryStats(int ControllerId, int& RecoveryCount, float& LastRecoverySeconds) const override;
+	virtual bool GetJoyConClockStats(int ControllerId, int& LostReports, int& DuplicateReports, float& TickPeriod) const override;
 	virtual bool GetJoyConAccelerometer(int ControllerId, FVector& Out) const override;
 	virtual bool GetJoyConGyroscope(int ControllerId, FVector& Out) const override;
+	virtual bool GetJoyConGyroBias(int ControllerId, FVector& Bias, float& Confidence) const override;
+	virtual bool DrainJoyConImuSamples(int ControllerId, TArray<FJoyConImuSample>& Out) const override;
 	virtual bool GetJoyConVector(int ControllerId, FRotator& Out) const override;
 	virtual bool ReCenterJoyCon(int ControllerId) const override;
 	virtual bool SetJoyConFilterCoefficient(int ControllerId, float Coefficient) const override;
@@ -8,11 +8,9 @@ FJoyConGrip::FJoyConGrip() {
 	Mode = EGripMode::Auto;
 }
 
-bool FJoyConGrip::ContainsController(const FJoyConInformation JoyConInformation) {
-	for (FJoyConController* Controller : Controllers) {
-		if (Controller->JoyConInformation.SerialNumber.Equals(JoyConInformation.SerialNumber) && Controller->JoyConInformation.BluetoothPath.Equals(JoyConInformation.BluetoothPath)) {
-			return true;
-		}
+bool FJoyConGrip::ContainsController(const FJoyConInformation& JoyConInformation) const {
+	for (const FJoyConController* Controller : Controllers) {
+		if (Controller->JoyConInformation.ControllerId == JoyConInformation.ControllerId) return true;
 	}
 	return false;
 }
\ No newline at end of file
@@ -3,11 +3,18 @@
 #include "JoyConInput.h"
 
 #include "hidapi.h"
+#include "JoyConBenchmark.h"
 #include "JoyConState.h"
 #include "Engine/Engine.h"
+#include "Misc/Parse.h"
+#include "HAL/PlatformProcess.h"
 #include "HAL/RunnableThread.h"
+#include "Async/Async.h"
 #include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
 #include "Misc/ConfigCacheIni.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
 
 #define LOCTEXT_NAMESPACE "JoyConInput"
 
@@ -45,6 +52,14 @@ const FKey FJoyConKey::JoyCon_Right_ThumbStick_Y("JoyCon_Right_ThumbStick_Y");
 const FKey FJoyConKey::JoyCon_Zr("JoyCon_Zr");
 const FKey FJoyConKey::JoyCon_R("JoyCon_R");
 
+const FKey FJoyConKey::JoyCon_Swing("JoyCon_Swing");
+const FKey FJoyConKey::JoyCon_Shake("JoyCon_Shake");
+const FKey FJoyConKey::JoyCon_Flick_Up("JoyCon_Flick_Up");
+const FKey FJoyConKey::JoyCon_Flick_Down("JoyCon_Flick_Down");
+const FKey FJoyConKey::JoyCon_Flick_Left("JoyCon_Flick_Left");
+const FKey FJoyConKey::JoyCon_Flick_Right("JoyCon_Flick_Right");
+const FKey FJoyConKey::JoyCon_Gesture_Magnitude("JoyCon_Gesture_Magnitude");
+
 // Setup Keys Names
 const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_DPad_Up("JoyCon_DPad_Up");
 const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_DPad_Left("JoyCon_DPad_Left");
@@ -79,10 +94,31 @@ const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Right_ThumbStick_Y("JoyCon_R
 const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Zr("JoyCon_Zr");
 const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_R("JoyCon_R");
 
+// Setup Gesture Keys Names
+const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Swing("JoyCon_Swing");
+const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Shake("JoyCon_Shake");
+const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Flick_Up("JoyCon_Flick_Up");
+const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Flick_Down("JoyCon_Flick_Down");
+const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Flick_Left("JoyCon_Flick_Left");
+const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Flick_Right("JoyCon_Flick_Right");
+const FJoyConKeyNames::Type FJoyConKeyNames::JoyCon_Gesture_Magnitude("JoyCon_Gesture_Magnitude");
+
 float FJoyConInput::InitialButtonRepeatDelay = 0.2f;
 float FJoyConInput::ButtonRepeatDelay = 0.1f;
-
-FJoyConInput::FJoyConInput(const TSharedRef< FGenericApplicationMessageHandler >& InMessageHandler) : MessageHandler(InMessageHandler) {
+bool FJoyConInput::bUseIoReactor = false;
+float FJoyConInput::DropTimeoutSeconds = 2.0f;
+bool FJoyConInput::bUseCalibrationCache = true;
+bool FJoyConInput::bAutoReconnect = true;
+float FJoyConInput::ReconnectInitialDelaySeconds = 0.25f;
+float FJoyConInput::ReconnectMaxDelaySeconds = 8.0f;
+bool FJoyConInput::bUseDeviceMonitor = true;
+JoyCon::OrientationFilterType FJoyConInput::OrientationFilter = JoyCon::OrientationFilterType::Madgwick;
+bool FJoyConInput::bEstimateGyroBias = true;
+bool FJoyConInput::bPredictMotion = true;
+float FJoyConInput::MotionPredictionSeconds = 0.02f;
+bool FJoyConInput::bDetectGestures = true;
+
+FJoyConInput::FJoyConInput(const TSharedRef< FGenericApplicationMessageHandler >& InMessageHandler) : MessageHandler(InMessageHandler), ListVersion(0), AsyncToken(MakeShared<int32, ESPMode::ThreadSafe>(0)), RunningWorkers(0) {
 	IModularFeatures::Get().RegisterModularFeature(GetModularFeatureName(), this);
 	if (hid_init() == 0) HidInitialized = true;
 	else {
@@ -97,11 +133,25 @@ FJoyConInput::FJoyConInput(const TSharedRef< FGenericApplicationMessageHandler >
 	Grips[5].GripIndex = 5;
 	Grips[6].GripIndex = 6;
 	Grips[7].GripIndex = 7;
+	if (bUseIoReactor) Reactor = MakeUnique<FJoyConReactor>();
+	if (bUseCalibrationCache) {
+		CalibrationCache = MakeUnique<FJoyConCalibrationCache>(FJoyConCalibrationCache::GetDefaultFilename());
+		CalibrationCache->Load();
+	}
+	if (HidInitialized && bUseDeviceMonitor) {
+		DeviceMonitor = MakeUnique<FJoyConDeviceMonitor>();
+		if (!DeviceMonitor->Start()) DeviceMonitor.Reset();
+	}
 	UE_LOG(LogTemp, Log, TEXT("JoyConDriver is initialized"));
 }
 
 FJoyConInput::~FJoyConInput() {
 	IModularFeatures::Get().UnregisterModularFeature(GetModularFeatureName(), this);
+	// Workers check the token before starting anything new, a handshake already running finishes within its timeouts
+	AsyncToken.Reset();
+	while (RunningWorkers > 0) FPlatformProcess::Sleep(0.001f);
+	Reactor.Reset();
+	DeviceMonitor.Reset();
 	if (hid_exit() == 0) HidInitialized = false;
 	else {
 		HidInitialized = true;
@@ -150,95 +200,84 @@ void FJoyConInput::PreInit() {
 	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Zr, LOCTEXT("JoyCon_Zr", "JoyCon ZR"), FKeyDetails::GamepadKey, "JoyCon"));
 	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_R, LOCTEXT("JoyCon_R", "JoyCon R"), FKeyDetails::GamepadKey, "JoyCon"));
 
+	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Swing, LOCTEXT("JoyCon_Swing", "JoyCon Swing"), FKeyDetails::GamepadKey, "JoyCon"));
+	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Shake, LOCTEXT("JoyCon_Shake", "JoyCon Shake"), FKeyDetails::GamepadKey, "JoyCon"));
+	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Flick_Up, LOCTEXT("JoyCon_Flick_Up", "JoyCon Flick Up"), FKeyDetails::GamepadKey, "JoyCon"));
+	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Flick_Down, LOCTEXT("JoyCon_Flick_Down", "JoyCon Flick Down"), FKeyDetails::GamepadKey, "JoyCon"));
+	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Flick_Left, LOCTEXT("JoyCon_Flick_Left", "JoyCon Flick Left"), FKeyDetails::GamepadKey, "JoyCon"));
+	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Flick_Right, LOCTEXT("JoyCon_Flick_Right", "JoyCon Flick Right"), FKeyDetails::GamepadKey, "JoyCon"));
+	EKeys::AddKey(FKeyDetails(FJoyConKey::JoyCon_Gesture_Magnitude, LOCTEXT("JoyCon_Gesture_Magnitude", "JoyCon Gesture Magnitude"), FKeyDetails::GamepadKey | FKeyDetails::FloatAxis, "JoyCon"));
+
 	UE_LOG(LogTemp, Log, TEXT("JoyConInput pre-init called"));
 }
 
 void FJoyConInput::LoadConfig() {
 	GConfig->GetFloat(TEXT("/Script/Engine.InputSettings"), TEXT("InitialButtonRepeatDelay"), InitialButtonRepeatDelay, GInputIni);
 	GConfig->GetFloat(TEXT("/Script/Engine.InputSettings"), TEXT("ButtonRepeatDelay"), ButtonRepeatDelay, GInputIni);
+	GConfig->GetBool(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("bUseIoReactor"), bUseIoReactor, GInputIni);
+	GConfig->GetFloat(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("DropTimeoutSeconds"), DropTimeoutSeconds, GInputIni);
+	GConfig->GetBool(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("bUseCalibrationCache"), bUseCalibrationCache, GInputIni);
+	GConfig->GetBool(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("bAutoReconnect"), bAutoReconnect, GInputIni);
+	GConfig->GetFloat(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("ReconnectInitialDelaySeconds"), ReconnectInitialDelaySeconds, GInputIni);
+	GConfig->GetFloat(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("ReconnectMaxDelaySeconds"), ReconnectMaxDelaySeconds, GInputIni);
+	GConfig->GetBool(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("bUseDeviceMonitor"), bUseDeviceMonitor, GInputIni);
+	FString FilterName;
+	if (GConfig->GetString(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("OrientationFilter"), FilterName, GInputIni)) {
+		if (FilterName.Equals(TEXT("Basis"), ESearchCase::IgnoreCase)) OrientationFilter = JoyCon::OrientationFilterType::Basis;
+		else if (FilterName.Equals(TEXT("Mahony"), ESearchCase::IgnoreCase)) OrientationFilter = JoyCon::OrientationFilterType::Mahony;
+		else OrientationFilter = JoyCon::OrientationFilterType::Madgwick;
+	}
+	GConfig->GetBool(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("bEstimateGyroBias"), bEstimateGyroBias, GInputIni);
+	GConfig->GetBool(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("bPredictMotion"), bPredictMotion, GInputIni);
+	GConfig->GetFloat(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("MotionPredictionSeconds"), MotionPredictionSeconds, GInputIni);
+	GConfig->GetBool(TEXT("/Script/JoyConDriver.JoyConInput"), TEXT("bDetectGestures"), bDetectGestures, GInputIni);
 }
 
-TArray<FJoyConInformation>* FJoyConInput::SearchJoyCons() {
-	TArray<FJoyConInformation>* Data = new TArray<FJoyConInformation>();
-	if (!HidInitialized) return Data;
-	hid_device_info* Devices = hid_enumerate(0x57e, 0x0);
-	if (Devices == nullptr) {
-		hid_free_enumeration(Devices);
-		Devices = hid_enumerate(0x057e, 0x0);
-		if (Devices == nullptr) {
-			hid_free_enumeration(Devices);
-			return Data;
-		}
-	}
-	hid_device_info* Device = Devices;
+void FJoyConInput::SearchJoyCons(TArray<FJoyConInformation>& Out) {
+	Out.Reset();
+	if (!HidInitialized) return;
+	// The monitor keeps the table current, so searching does not enumerate the system
+	if (DeviceMonitor.IsValid()) DeviceMonitor->GetDevices(Out);
+	else FJoyConDeviceMonitor::Enumerate(Out);
 	int ControllerId = 0;
-	while (Device != nullptr) {
-		if (Device->product_id == 0x2006 || Device->product_id == 0x2007) {
-			FString SerialNumber(Device->serial_number);
-			FString BluetoothPath(Device->path);
-			bool IsConnected = false;
-			if (Controllers.Num() > 0) {
-				for (FJoyConController* Controller : Controllers) {
-					if (Controller->JoyConInformation.SerialNumber.Equals(SerialNumber) && Controller->JoyConInformation.BluetoothPath.Equals(BluetoothPath)) {
-						IsConnected = true;
-						break;
-					}
-				}
-			}
-			bool IsLeft = false;
-			if (Device->product_id == 0x2006) {
-				IsLeft = true;
-			} else if (Device->product_id == 0x2007) {
-				IsLeft = false;
-			}
-			const FJoyConInformation JoyConInformation(
-				Device->product_id,
-				Device->vendor_id,
-				Device->interface_number,
-				Device->release_number,
-				FString(Device->manufacturer_string),
-				FString(Device->path),
-				FString(Device->product_string),
-				FString(Device->serial_number),
-				ControllerId,
-				Device->usage,
-				Device->usage_page,
-				IsLeft,
-				IsConnected
-			);
-			Data->Add(JoyConInformation);
-			ControllerId++;
-		}
-		Device = Device->next;
+	for (FJoyConInformation& JoyConInformation : Out) {
+		JoyConInformation.ControllerId = ControllerId++;
+		JoyConInformation.IsConnected = FindControllerByDevice(JoyConInformation) != nullptr;
 	}
-	hid_free_enumeration(Devices);
-	return Data;
 }
 
-TArray<FJoyConInformation>* FJoyConInput::GetAttachedJoyCons() {
-	TArray<FJoyConInformation>* Data = new TArray<FJoyConInformation>();
-	if (!HidInitialized) return Data;
-	for (FJoyConController* Controller : Controllers) {
-		if (Controller->JoyConInformation.IsAttached) Data->Add(Controller->JoyConInformation);
+void FJoyConInput::GetAttachedJoyCons(TArray<FJoyConInformation>& Out) const {
+	Out.Reset();
+	if (!HidInitialized) return;
+	for (const FJoyConController* Controller : Controllers) {
+		if (Controller->JoyConInformation.IsAttached) Out.Add(Controller->JoyConInformation);
 	}
-	return Data;
 }
 
-TArray<FJoyConInformation>* FJoyConInput::GetConnectedJoyCons() {
-	TArray<FJoyConInformation>* Data = new TArray<FJoyConInformation>();
-	if (!HidInitialized) return Data;
-	for (FJoyConController* Controller : Controllers) {
-		Data->Add(Controller->JoyConInformation);
+void FJoyConInput::GetConnectedJoyCons(TArray<FJoyConInformation>& Out) const {
+	Out.Reset();
+	if (!HidInitialized) return;
+	Out.Reserve(Controllers.Num());
+	for (const FJoyConController* Controller : Controllers) {
+		Out.Add(Controller->JoyConInformation);
 	}
-	return Data;
+}
+
+uint32 FJoyConInput::GetJoyConListVersion() const {
+	// Both counters only grow, so the sum changes whenever either does
+	return ListVersion + (DeviceMonitor.IsValid() ? DeviceMonitor->GetGeneration() : 0);
 }
 
 bool FJoyConInput::ResumeJoyConConnection() {
 	if (!HidInitialized) return false;
 	bool Success = false;
 	for (FJoyConController* Controller : Controllers) {
+		// A worker may be running the controller's handshake, FinishReconnectAttempt() starts polling it afterwards
+		const int ControllerId = Controller->JoyConInformation.ControllerId;
+		if (AttachingControllers.Contains(ControllerId) || Recoveries.Contains(ControllerId)) continue;
 		if (Controller->JoyConInformation.IsAttached) {
-			Success = Controller->StartListenThread();
+			StopPolling(Controller);
+			Success = StartPolling(Controller);
 			if (Success == false) return Success;
 		}
 	}
@@ -247,30 +286,181 @@ bool FJoyConInput::ResumeJoyConConnection() {
 
 bool FJoyConInput::ConnectJoyCon(const FJoyConInformation JoyConInformation, const bool UseImu, const bool UseLocalize, const float Alpha, int& ControllerId) {
 	if (!HidInitialized) return false;
-	if (JoyConInformation.IsConnected) return false;
+	if (JoyConInformation.IsConnected || FindControllerByDevice(JoyConInformation) != nullptr) return false;
 	char* Path = TCHAR_TO_ANSI(*JoyConInformation.BluetoothPath);
 	hid_device* Handle = hid_open_path(Path);
+	if (Handle == nullptr) return false;
 	hid_set_nonblocking(Handle, 1);
-	FJoyConController* Controller = new FJoyConController(JoyConInformation, Handle, UseImu, UseLocalize, Alpha, JoyConInformation.IsLeft);
+	return AddController(JoyConInformation, new FJoyConHidDevice(Handle), UseImu, UseLocalize, Alpha, ControllerId);
+}
+
+bool FJoyConInput::ConnectSimulatedJoyCon(const FJoyConSimulatedDeviceSettings& Settings, const bool UseImu, const bool UseLocalize, const float Alpha, int& ControllerId) {
+	const int SimulatedIndex = GetNextControllerId();
+	const FJoyConInformation JoyConInformation(
+		Settings.bIsLeft ? 0x2006 : 0x2007,
+		0x57e,
+		-1,
+		0,
+		TEXT("Nintendo"),
+		FString::Printf(TEXT("sim://%d"), SimulatedIndex),
+		Settings.bIsLeft ? TEXT("Simulated Joy-Con (L)") : TEXT("Simulated Joy-Con (R)"),
+		FString::Printf(TEXT("SIM-%04d"), SimulatedIndex),
+		SimulatedIndex,
+		0x5,
+		0x1,
+		Settings.bIsLeft,
+		false
+	);
+	return AddController(JoyConInformation, new FJoyConSimulatedDevice(Settings), UseImu, UseLocalize, Alpha, ControllerId);
+}
+
+bool FJoyConInput::ConnectReplayJoyCon(const FJoyConReplayDeviceSettings& Settings, const bool UseImu, const bool UseLocalize, const float Alpha, int& ControllerId) {
+	FJoyConReplayDevice* Device = FJoyConReplayDevice::Open(Settings);
+	if (Device == nullptr) return false;
+	const int ReplayIndex = GetNextControllerId();
+	const FJoyConInformation JoyConInformation(
+		Device->IsLeft() ? 0x2006 : 0x2007,
+		0x57e,
+		-1,
+		0,
+		TEXT("Nintendo"),
+		FString::Printf(TEXT("replay://%s"), *Settings.Filename),
+		Device->IsLeft() ? TEXT("Replayed Joy-Con (L)") : TEXT("Replayed Joy-Con (R)"),
+		FString::Printf(TEXT("REPLAY-%04d"), ReplayIndex),
+		ReplayIndex,
+		0x5,
+		0x1,
+		Device->IsLeft(),
+		false
+	);
+	return AddController(JoyConInformation, Device, UseImu, UseLocalize, Alpha, ControllerId);
+}
+
+bool FJoyConInput::StartJoyConCapture(const int ControllerId, const FString& Filename) {
+	if (!ControllersMap.Contains(ControllerId)) return false;
+	return ControllersMap[ControllerId]->StartCapture(Filename);
+}
+
+bool FJoyConInput::StopJoyConCapture(const int ControllerId) {
+	if (!ControllersMap.Contains(ControllerId)) return false;
+	ControllersMap[ControllerId]->StopCapture();
+	return true;
+}
+
+bool FJoyConInput::DumpJoyConFlash(const int ControllerId, const FString& Filename) {
+	if (!ControllersMap.Contains(ControllerId)) return false;
+	// A worker running the handshake reads the device through the same channel
+	if (AttachingControllers.Contains(ControllerId)) return false;
+	if (const FJoyConRecovery* Recovery = Recoveries.Find(ControllerId)) {
+		if (Recovery->bAttemptInFlight) return false;
+	}
+	TArray<uint8> Dump;
+	const double StartTime = FPlatformTime::Seconds();
+	const bool bComplete = ControllersMap[ControllerId]->DumpCalibrationRegion(Dump);
+	UE_LOG(LogTemp, Display, TEXT("Read %d bytes of JoyCon %d flash in %.1f ms%s."), Dump.Num(), ControllerId,
+		(FPlatformTime::Seconds() - StartTime) * 1000.0, bComplete ? TEXT("") : TEXT(", some chunks failed and read as 0xff"));
+	return FFileHelper::SaveArrayToFile(Dump, *Filename) && bComplete;
+}
+
+bool FJoyConInput::AddController(const FJoyConInformation& JoyConInformation, IJoyConDevice* Device, const bool UseImu, const bool UseLocalize, const float Alpha, int& ControllerId) {
+	FJoyConController* Controller = new FJoyConController(JoyConInformation, Device, UseImu, UseLocalize, Alpha, JoyConInformation.IsLeft);
+	Controller->SetOrientationFilter(OrientationFilter);
+	Controller->SetGyroBiasEstimation(bEstimateGyroBias);
+	Controller->SetGestureDetection(bDetectGestures);
 	Controllers.Add(Controller);
 	Controller->JoyConInformation.IsConnected = true;
 	Controller->JoyConInformation.ControllerId = GetNextControllerId();
 	ControllersMap.Add(Controller->JoyConInformation.ControllerId, Controller);
+	RegisterDevice(Controller);
+	ListVersion++;
 	ControllerId = Controller->JoyConInformation.ControllerId;
 	return true;
 }
 
+// Consecutive empty pumps after which a full speed replay is taken to have nothing left to deliver
+static constexpr int32 MaxReplayIdlePumps = 4;
+
+void FJoyConInput::ReplayThroughput(FJoyConReplayDeviceSettings Settings, FOutputDevice& Ar) {
+	// Runs the log through a private controller on this thread, so only report decoding and IMU fusion are timed
+	Settings.Speed = 0.0f;
+	Settings.bLoop = false;
+	FJoyConReplayDevice* Device = FJoyConReplayDevice::Open(Settings);
+	if (Device == nullptr) {
+		Ar.Logf(TEXT("Failed to open %s."), *Settings.Filename);
+		return;
+	}
+	const FJoyConInformation JoyConInformation;
+	FJoyConController Controller(JoyConInformation, Device, true, true, 0.05f, Device->IsLeft());
+	Controller.Attach(0x1);
+	Controller.StartReactorPolling();
+	const double StartTime = FPlatformTime::Seconds();
+	// At full speed a pump only comes back empty once the log stops delivering, e.g. it never switches to 0x30
+	int32 IdlePumps = 0;
+	while (!Device->IsFinished() && IdlePumps < MaxReplayIdlePumps) {
+		const int32 Pumped = Controller.PumpReports();
+		if (Pumped < 0) break;
+		IdlePumps = Pumped == 0 ? IdlePumps + 1 : 0;
+		Controller.Update();
+	}
+	Controller.Update();
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+	const uint64 Delivered = Device->GetReportsDelivered();
+	if (!Device->IsFinished()) Ar.Logf(TEXT("%s stopped delivering reports before its end."), *Settings.Filename);
+	Ar.Logf(TEXT("Replayed %llu reports in %.3f ms, %.0f reports/s, %.1f ns/report, %llu dropped by the report queue."),
+		Delivered, Elapsed * 1000.0, Elapsed > 0.0 ? Delivered / Elapsed : 0.0, Delivered > 0 ? Elapsed * 1e9 / Delivered : 0.0,
+		Controller.GetReportQueueOverflowCount());
+}
+
 bool FJoyConInput::AttachJoyCon(const int ControllerId, const int GripIndex) {
-	if (!ControllersMap.Contains(ControllerId)) return false;
+	FJoyConController* Controller = PrepareAttach(ControllerId, GripIndex);
+	if (Controller == nullptr) return false;
+	return FinishAttach(Controller, GripIndex, Controller->Attach(static_cast<uint8>(0x1 << GripIndex)));
+}
+
+bool FJoyConInput::AttachJoyConAsync(const int ControllerId, const int GripIndex, FOnJoyConAttachComplete OnComplete) {
+	FJoyConController* Controller = PrepareAttach(ControllerId, GripIndex);
+	if (Controller == nullptr) return false;
+	AttachingControllers.Add(ControllerId);
+	const TWeakPtr<int32, ESPMode::ThreadSafe> Token = AsyncToken;
+	RunOnWorker([this, Token, Controller, ControllerId, GripIndex, OnComplete]() {
+		if (!Token.IsValid()) return;
+		const double StartTime = FPlatformTime::Seconds();
+		const bool bHandshakeSucceeded = Controller->Attach(static_cast<uint8>(0x1 << GripIndex));
+		const float AttachSeconds = static_cast<float>(FPlatformTime::Seconds() - StartTime);
+		AsyncTask(ENamedThreads::GameThread, [this, Token, Controller, ControllerId, GripIndex, OnComplete, bHandshakeSucceeded, AttachSeconds]() {
+			if (!Token.IsValid()) return;
+			AttachingControllers.Remove(ControllerId);
+			const bool bSuccess = FinishAttach(Controller, GripIndex, bHandshakeSucceeded);
+			OnComplete.ExecuteIfBound(ControllerId, bSuccess, AttachSeconds);
+		});
+	});
+	return true;
+}
+
+bool FJoyConInput::IsJoyConAttaching(const int ControllerId) const {
+	return AttachingControllers.Contains(ControllerId);
+}
+
+FJoyConController* FJoyConInput::PrepareAttach(const int ControllerId, const int GripIndex) {
+	if (!ControllersMap.Contains(ControllerId)) return nullptr;
 	FJoyConController* Controller = ControllersMap[ControllerId];
-	if (GripIndex < 0 || GripIndex > 7) return false;
-	if (Controller->JoyConInformation.IsAttached) return false;
-	uint8 Leds = 0x0;
-	Leds |= static_cast<uint8>(0x1 << GripIndex);
+	if (GripIndex < 0 || GripIndex > 7) return nullptr;
+	if (Controller->JoyConInformation.IsAttached || AttachingControllers.Contains(ControllerId)) return nullptr;
+	JoyCon::Calibration Calibration;
+	if (CalibrationCache.IsValid() && Controller->GetDevice()->HasStableIdentity()
+		&& CalibrationCache->Find(Controller->JoyConInformation.SerialNumber, Controller->JoyConInformation.IsLeft, Calibration)) {
+		Controller->SetCachedCalibration(Calibration);
+	}
+	return Controller;
+}
+
+bool FJoyConInput::FinishAttach(FJoyConController* Controller, const int GripIndex, const bool bHandshakeSucceeded) {
+	if (!bHandshakeSucceeded) return false;
 	Grips[GripIndex].Controllers.Add(Controller);
-	Controller->Attach(Leds);
-	Controller->StartListenThread();
+	PublishMotionStates();
+	StartPolling(Controller);
 	Controller->JoyConInformation.IsAttached = true;
+	ListVersion++;
 	return true;
 }
 
@@ -278,9 +468,12 @@ bool FJoyConInput::DisconnectJoyCon(const int ControllerId) {
 	if (!HidInitialized) return false;
 	if (!ControllersMap.Contains(ControllerId)) return false;
 	FJoyConController* Controller = ControllersMap[ControllerId];
-	if (Controller->JoyConInformation.IsAttached) return false;
+	if (Controller->JoyConInformation.IsAttached || AttachingControllers.Contains(ControllerId) || Recoveries.Contains(ControllerId)) return false;
 	Controllers.RemoveAt(Controllers.IndexOfByKey(Controller));
 	ControllersMap.Remove(ControllerId);
+	UnregisterDevice(Controller);
+	ListVersion++;
+	StopPolling(Controller);
 	Controller->Stop();
 	delete Controller;
 	return true;
@@ -288,18 +481,44 @@ bool FJoyConInput::DisconnectJoyCon(const int ControllerId) {
 
 bool FJoyConInput::DetachJoyCon(const int ControllerId) {
 	if (!ControllersMap.Contains(ControllerId)) return false;
+	if (const FJoyConRecovery* Recovery = Recoveries.Find(ControllerId)) {
+		if (Recovery->bAttemptInFlight) return false;
+		Recoveries.Remove(ControllerId);
+	}
 	FJoyConController* Controller = ControllersMap[ControllerId];
 	for (int i = 0; i < 8; i++) {
 		if (Grips[i].ContainsController(Controller->JoyConInformation)) {
 			Grips[i].Controllers.Remove(Controller);
+			PublishMotionStates();
+			StopPolling(Controller);
 			Controller->Detach();
 			Controller->JoyConInformation.IsAttached = false;
+			ListVersion++;
 			return true;
 		}
 	}
 	return false;
 }
 
+bool FJoyConInput::GetJoyConRecoveryStats(const int ControllerId, int& RecoveryCount, float& LastRecoverySeconds) {
+	RecoveryCount = 0;
+	LastRecoverySeconds = 0.0f;
+	if (!ControllersMap.Contains(ControllerId)) return false;
+	FJoyConController* Controller = ControllersMap[ControllerId];
+	RecoveryCount = Controller->GetRecoveryCount();
+	LastRecoverySeconds = Controller->GetLastRecoverySeconds();
+	return true;
+}
+
+bool FJoyConInput::GetJoyConClockStats(const int ControllerId, int& LostReports, int& DuplicateReports, float& TickPeriod) {
+	LostReports = 0;
+	DuplicateReports = 0;
+	TickPeriod = 0.0f;
+	if (!ControllersMap.Contains(ControllerId)) return false;
+	ControllersMap[ControllerId]->GetClockStats(LostReports, DuplicateReports, TickPeriod);
+	return true;
+}
+
 bool FJoyConInput::GetJoyConAccelerometer(const int ControllerId, FVector& Out) {
 	if (!HidInitialized) return false;
 	Out = FVector::ZeroVector;
@@ -318,6 +537,24 @@ bool FJoyConInput::GetJoyConGyroscope(const int ControllerId, FVector& Out) {
 	return true;
 }
 
+bool FJoyConInput::GetJoyConGyroBias(const int ControllerId, FVector& Bias, float& Confidence) {
+	Bias = FVector::ZeroVector;
+	Confidence = 0.0f;
+	if (!HidInitialized) return false;
+	if (!ControllersMap.Contains(ControllerId)) return false;
+	ControllersMap[ControllerId]->GetGyroBias(Bias, Confidence);
+	return true;
+}
+
+bool FJoyConInput::DrainJoyConImuSamples(const int ControllerId, TArray<FJoyConImuSample>& Out) {
+	Out.Reset();
+	if (!HidInitialized) return false;
+	if (!ControllersMap.Contains(ControllerId)) return false;
+	FJoyConController* Controller = ControllersMap[ControllerId];
+	Controller->DrainImuSamples(Out);
+	return true;
+}
+
 bool FJoyConInput::GetJoyConVector(const int ControllerId, FRotator& Out) {
 	if (!HidInitialized) return false;
 	Out = FRotator::ZeroRotator;
@@ -358,18 +595,150 @@ bool FJoyConInput::SetJoyConRumble(const int ControllerId, const float LowFreque
 }
 
 void FJoyConInput::Tick(float DeltaTime) {
+	if (DeviceMonitor.IsValid()) DispatchDeviceEvents();
+	if (bAutoReconnect) UpdateRecovery();
+}
 
+void FJoyConInput::DispatchDeviceEvents() {
+	DeviceMonitor->ConsumeEvents(PendingDeviceEvents);
+	for (const FJoyConDeviceEvent& Event : PendingDeviceEvents) {
+		UE_LOG(LogTemp, Log, TEXT("JoyCon %s %s (%s)."), *Event.Information.SerialNumber, Event.bArrived ? TEXT("arrived") : TEXT("removed"), *Event.Information.BluetoothPath);
+		if (Event.bArrived) {
+			// A controller waiting for its backoff to expire came back, reconnect it right away
+			for (TPair<int, FJoyConRecovery>& Pair : Recoveries) {
+				if (!Pair.Value.bAttemptInFlight && ControllersMap[Pair.Key]->JoyConInformation.SerialNumber.Equals(Event.Information.SerialNumber)) {
+					Pair.Value.NextAttemptTime = 0.0;
+				}
+			}
+		}
+		DeviceChangedDelegate.Broadcast(Event.Information, Event.bArrived);
+	}
+}
+
+void FJoyConInput::UpdateRecovery() {
+	const double CurrentTime = FPlatformTime::Seconds();
+	for (int i = 0; i < 8; i++) {
+		for (FJoyConController* Controller : Grips[i].Controllers) {
+			const int ControllerId = Controller->JoyConInformation.ControllerId;
+			// A worker may be running the handshake of a controller in recovery, check that before touching it
+			if (Recoveries.Contains(ControllerId) || !Controller->IsDropped() || !Controller->GetDevice()->HasStableIdentity()) continue;
+			StopPolling(Controller);
+			// The grip loop keeps sending the controller's state, release its keys instead of holding the last report
+			Controller->ClearInput();
+			Recoveries.Add(ControllerId, FJoyConRecovery{ i, 0, CurrentTime, CurrentTime, false });
+			UE_LOG(LogTemp, Warning, TEXT("JoyCon %d dropped, trying to reconnect it."), ControllerId);
+		}
+	}
+	TArray<int> Due;
+	for (const TPair<int, FJoyConRecovery>& Pair : Recoveries) {
+		if (!Pair.Value.bAttemptInFlight && Pair.Value.NextAttemptTime <= CurrentTime) Due.Add(Pair.Key);
+	}
+	for (const int ControllerId : Due) {
+		StartReconnectAttempt(ControllerId);
+	}
+}
+
+// The HID path of a controller can change when it reconnects, so look it up again by serial number
+static FString FindJoyConPath(const FJoyConInformation& Information) {
+	FString Path = Information.BluetoothPath;
+	hid_device_info* Devices = hid_enumerate(0x57e, Information.ProductId);
+	for (hid_device_info* Device = Devices; Device != nullptr; Device = Device->next) {
+		if (Device->serial_number != nullptr && Information.SerialNumber.Equals(FString(Device->serial_number))) {
+			Path = FString(Device->path);
+			break;
+		}
+	}
+	hid_free_enumeration(Devices);
+	return Path;
+}
+
+void FJoyConInput::StartReconnectAttempt(const int ControllerId) {
+	FJoyConRecovery& Recovery = Recoveries[ControllerId];
+	Recovery.bAttemptInFlight = true;
+	Recovery.Attempt++;
+	const FJoyConInformation Information = ControllersMap[ControllerId]->JoyConInformation;
+	const TWeakPtr<int32, ESPMode::ThreadSafe> Token = AsyncToken;
+	// Enumerating and opening can block, the controller itself is only touched on the game thread
+	RunOnWorker([this, Token, ControllerId, Information]() {
+		if (!Token.IsValid()) return;
+		const FString Path = FindJoyConPath(Information);
+		hid_device* Handle = hid_open_path(TCHAR_TO_ANSI(*Path));
+		if (Handle != nullptr) hid_set_nonblocking(Handle, 1);
+		AsyncTask(ENamedThreads::GameThread, [this, Token, ControllerId, Handle, Path]() {
+			if (!Token.IsValid()) {
+				if (Handle != nullptr) hid_close(Handle);
+				return;
+			}
+			ContinueReconnectAttempt(ControllerId, Handle, Path);
+		});
+	});
+}
+
+void FJoyConInput::ContinueReconnectAttempt(const int ControllerId, hid_device* Handle, const FString& Path) {
+	if (Handle == nullptr) {
+		FinishReconnectAttempt(ControllerId, false, Path);
+		return;
+	}
+	FJoyConController* Controller = ControllersMap[ControllerId];
+	const uint8 Leds = static_cast<uint8>(0x1 << Recoveries[ControllerId].GripIndex);
+	// Polling stopped when the drop was noticed, so nothing else uses the old device while it is swapped
+	Controller->ReplaceDevice(new FJoyConHidDevice(Handle));
+	const TWeakPtr<int32, ESPMode::ThreadSafe> Token = AsyncToken;
+	RunOnWorker([this, Token, Controller, ControllerId, Leds, Path]() {
+		if (!Token.IsValid()) return;
+		const bool bSuccess = Controller->Attach(Leds);
+		AsyncTask(ENamedThreads::GameThread, [this, Token, ControllerId, bSuccess, Path]() {
+			if (!Token.IsValid()) return;
+			FinishReconnectAttempt(ControllerId, bSuccess, Path);
+		});
+	});
+}
+
+void FJoyConInput::RunOnWorker(TUniqueFunction<void()> Work) {
+	++RunningWorkers;
+	Async(EAsyncExecution::ThreadPool, [this, Work = MoveTemp(Work)]() {
+		Work();
+		--RunningWorkers;
+	});
+}
+
+void FJoyConInput::FinishReconnectAttempt(const int ControllerId, const bool bSuccess, const FString& Path) {
+	FJoyConRecovery& Recovery = Recoveries[ControllerId];
+	FJoyConController* Controller = ControllersMap[ControllerId];
+	const double CurrentTime = FPlatformTime::Seconds();
+	Recovery.bAttemptInFlight = false;
+	if (bSuccess && StartPolling(Controller)) {
+		const float RecoverySeconds = static_cast<float>(CurrentTime - Recovery.DroppedTime);
+		UnregisterDevice(Controller);
+		Controller->JoyConInformation.BluetoothPath = Path;
+		RegisterDevice(Controller);
+		ListVersion++;
+		Controller->RecordRecovery(RecoverySeconds);
+		UE_LOG(LogTemp, Log, TEXT("JoyCon %d reconnected after %d attempts in %.3f s."), ControllerId, Recovery.Attempt, RecoverySeconds);
+		Recoveries.Remove(ControllerId);
+		return;
+	}
+	const float Delay = FMath::Min(ReconnectInitialDelaySeconds * FMath::Pow(2.0f, static_cast<float>(Recovery.Attempt - 1)), ReconnectMaxDelaySeconds);
+	Recovery.NextAttemptTime = CurrentTime + Delay;
+	UE_LOG(LogTemp, Verbose, TEXT("JoyCon %d reconnect attempt %d failed, retrying in %.2f s."), ControllerId, Recovery.Attempt, Delay);
 }
 
 void FJoyConInput::SendControllerEvents() {
 	const double CurrentTime = FPlatformTime::Seconds();
 
 	for (FJoyConController* Controller : Controllers) {
+		if (AttachingControllers.Contains(Controller->JoyConInformation.ControllerId) || Recoveries.Contains(Controller->JoyConInformation.ControllerId)) continue;
 		Controller->Update();
+		JoyCon::Calibration Calibration;
+		if (Controller->ConsumeCalibrationChange(Calibration) && CalibrationCache.IsValid() && Controller->GetDevice()->HasStableIdentity()) {
+			CalibrationCache->Store(Controller->JoyConInformation.SerialNumber, Controller->JoyConInformation.IsLeft, Calibration);
+		}
 	}
+	PublishMotionStates();
 
 	for (int i = 0; i < 8; i++) {
 		for (FJoyConController* Controller : Grips[i].Controllers) {
+			SendGestureEvents(Grips[i].GripIndex, Controller);
 			for (int32 ButtonIndex = 0; ButtonIndex < static_cast<int32>(EJoyConControllerButton::TotalButtonCount); ++ButtonIndex) {
 				FJoyConButtonState& ButtonState = Controller->ControllerState.Buttons[ButtonIndex];
 				check(!ButtonState.Key.IsNone()); // is button's name initialized?
@@ -414,6 +783,95 @@ void FJoyConInput::SetMessageHandler(const TSharedRef<FGenericApplicationMessage
 }
 
 bool FJoyConInput::Exec(UWorld* InWorld, const TCHAR* Cmd, FOutputDevice& Ar) {
+	if (!FParse::Command(&Cmd, TEXT("JOYCON"))) return false;
+
+	if (FParse::Command(&Cmd, TEXT("SIMULATE"))) {
+		// JOYCON SIMULATE Count=16 Left=1 Rate=66.67 Loss=0.01 Duplicate=0.01 Jitter=4 Seed=0
+		int32 Count = 1;
+		bool bIsLeft = true;
+		FJoyConSimulatedDeviceSettings Settings;
+		FParse::Value(Cmd, TEXT("Count="), Count);
+		FParse::Bool(Cmd, TEXT("Left="), bIsLeft);
+		FParse::Value(Cmd, TEXT("Rate="), Settings.ReportRateHz);
+		FParse::Value(Cmd, TEXT("Loss="), Settings.LossProbability);
+		FParse::Value(Cmd, TEXT("Duplicate="), Settings.DuplicateProbability);
+		FParse::Value(Cmd, TEXT("Jitter="), Settings.JitterMs);
+		FParse::Value(Cmd, TEXT("Seed="), Settings.RandomSeed);
+		Settings.bIsLeft = bIsLeft;
+		for (int32 i = 0; i < Count; ++i) {
+			int ControllerId;
+			if (!ConnectSimulatedJoyCon(Settings, true, true, 0.05f, ControllerId)) {
+				Ar.Logf(TEXT("Failed to connect simulated JoyCon %d."), i);
+				return true;
+			}
+			// Attached in parallel, like a lobby where every player connects at once
+			AttachJoyConAsync(ControllerId, ControllerId % 8, FOnJoyConAttachComplete::CreateLambda([](const int Id, const bool bSuccess, const float AttachSeconds) {
+				UE_LOG(LogTemp, Display, TEXT("Simulated JoyCon %d %s in %.1f ms."), Id, bSuccess ? TEXT("attached") : TEXT("failed to attach"), AttachSeconds * 1000.0f);
+			}));
+			Settings.RandomSeed++;
+			Ar.Logf(TEXT("Attaching simulated JoyCon %d to grip %d."), ControllerId, ControllerId % 8);
+		}
+		return true;
+	}
+
+	if (FParse::Command(&Cmd, TEXT("CAPTURE"))) {
+		// JOYCON CAPTURE Id=0 File=JoyCon.jcrl, JOYCON CAPTURE STOP Id=0
+		const bool bStop = FParse::Command(&Cmd, TEXT("STOP"));
+		int32 ControllerId = 0;
+		FString Filename = FPaths::ProjectSavedDir() / TEXT("JoyCon.jcrl");
+		FParse::Value(Cmd, TEXT("Id="), ControllerId);
+		FParse::Value(Cmd, TEXT("File="), Filename);
+		const bool bSuccess = bStop ? StopJoyConCapture(ControllerId) : StartJoyConCapture(ControllerId, Filename);
+		Ar.Logf(TEXT("%s capture of JoyCon %d %s."), bStop ? TEXT("Stopping") : TEXT("Starting"), ControllerId, bSuccess ? TEXT("succeeded") : TEXT("failed"));
+		return true;
+	}
+
+	if (FParse::Command(&Cmd, TEXT("DUMPFLASH"))) {
+		// JOYCON DUMPFLASH Id=0 File=JoyConFlash.bin, the factory region 0x6000-0x60af followed by the user region 0x8010-0x803f
+		int32 ControllerId = 0;
+		FString Filename = FPaths::ProjectSavedDir() / TEXT("JoyConFlash.bin");
+		FParse::Value(Cmd, TEXT("Id="), ControllerId);
+		FParse::Value(Cmd, TEXT("File="), Filename);
+		const bool bSuccess = DumpJoyConFlash(ControllerId, Filename);
+		Ar.Logf(TEXT("Dumping the flash of JoyCon %d to %s %s."), ControllerId, *Filename, bSuccess ? TEXT("succeeded") : TEXT("failed"));
+		return true;
+	}
+
+	if (FParse::Command(&Cmd, TEXT("REPLAY"))) {
+		// JOYCON REPLAY File=JoyCon.jcrl Speed=1 Loop=0 Grip=0, Speed=0 Bench=1 decodes the log as fast as possible
+		FJoyConReplayDeviceSettings Settings;
+		Settings.Filename = FPaths::ProjectSavedDir() / TEXT("JoyCon.jcrl");
+		int32 GripIndex = 0;
+		bool bBenchmark = false;
+		FParse::Value(Cmd, TEXT("File="), Settings.Filename);
+		FParse::Value(Cmd, TEXT("Speed="), Settings.Speed);
+		FParse::Bool(Cmd, TEXT("Loop="), Settings.bLoop);
+		FParse::Value(Cmd, TEXT("Grip="), GripIndex);
+		FParse::Bool(Cmd, TEXT("Bench="), bBenchmark);
+		if (bBenchmark) {
+			ReplayThroughput(Settings, Ar);
+			return true;
+		}
+		int ControllerId;
+		if (!ConnectReplayJoyCon(Settings, true, true, 0.05f, ControllerId) || !AttachJoyCon(ControllerId, GripIndex)) {
+			Ar.Logf(TEXT("Failed to replay %s."), *Settings.Filename);
+			return true;
+		}
+		Ar.Logf(TEXT("Replaying %s as JoyCon %d on grip %d."), *Settings.Filename, ControllerId, GripIndex);
+		return true;
+	}
+
+	if (FParse::Command(&Cmd, TEXT("BENCHMARK"))) {
+		// JOYCON BENCHMARK Reports=20000 Iterations=5 Seed=0 File=JoyCon.jcrl Out=Results.json
+		FJoyConBenchmarkSettings Settings;
+		FParse::Value(Cmd, TEXT("Reports="), Settings.NumReports);
+		FParse::Value(Cmd, TEXT("Iterations="), Settings.Iterations);
+		FParse::Value(Cmd, TEXT("Seed="), Settings.RandomSeed);
+		FParse::Value(Cmd, TEXT("File="), Settings.CorpusFilename);
+		FParse::Value(Cmd, TEXT("Out="), Settings.OutputFilename);
+		FJoyConBenchmark::Run(Settings, Ar);
+		return true;
+	}
 	return false;
 }
 
@@ -426,12 +884,51 @@ FName FJoyConInput::GetMotionControllerDeviceTypeName() const {
 	return DefaultName;
 }
 
+void FJoyConInput::PublishMotionStates() {
+	FJoyConMotionState States[8][3];
+	for (int i = 0; i < 8; i++) {
+		bool bFound[3] = { false, false, false };
+		for (FJoyConController* Controller : Grips[i].Controllers) {
+			// A worker may be running the handshake of a controller in recovery, it publishes nothing until it is back
+			FJoyConMotionState State;
+			if (!Recoveries.Contains(Controller->JoyConInformation.ControllerId)) State = Controller->GetMotionState();
+			for (const int Slot : { Controller->IsLeft() ? 0 : 1, 2 }) {
+				if (bFound[Slot]) continue;
+				States[i][Slot] = State;
+				bFound[Slot] = true;
+			}
+		}
+	}
+	FScopeLock Lock(&MotionMutex);
+	FMemory::Memcpy(MotionStates, States, sizeof(MotionStates));
+}
+
+bool FJoyConInput::FindMotionState(const int32 ControllerIndex, const EControllerHand DeviceHand, FJoyConMotionState& Out) const {
+	if (ControllerIndex < 0 || ControllerIndex > 7) return false;
+	int Slot;
+	if (DeviceHand == EControllerHand::Left) Slot = 0;
+	else if (DeviceHand == EControllerHand::Right) Slot = 1;
+	else if (DeviceHand == EControllerHand::AnyHand) Slot = 2;
+	else return false;
+	FScopeLock Lock(&MotionMutex);
+	Out = MotionStates[ControllerIndex][Slot];
+	return Out.bTracking;
+}
+
 bool FJoyConInput::GetControllerOrientationAndPosition(const int32 ControllerIndex, const EControllerHand DeviceHand, FRotator& OutOrientation, FVector& OutPosition, float WorldToMetersScale) const {
-	return false;
+	// Called on the render thread too, so only the snapshot the game thread published is read
+	FJoyConMotionState State;
+	if (!FindMotionState(ControllerIndex, DeviceHand, State)) return false;
+	// Joy-Cons only sense rotation, the position stays at the component's origin
+	OutOrientation = (bPredictMotion ? State.GetPredictedOrientation(MotionPredictionSeconds) : State.GetOrientation()).Rotator();
+	OutPosition = FVector::ZeroVector;
+	return true;
 }
 
 ETrackingStatus FJoyConInput::GetControllerTrackingStatus(const int32 ControllerIndex, const EControllerHand DeviceHand) const {
-	return ETrackingStatus::NotTracked;
+	FJoyConMotionState State;
+	if (!FindMotionState(ControllerIndex, DeviceHand, State)) return ETrackingStatus::NotTracked;
+	return ETrackingStatus::InertialOnly;
 }
 
 void FJoyConInput::SetHapticFeedbackValues(int32 ControllerId, int32 Hand, const FHapticFeedbackValues& Values) {
@@ -453,15 +950,45 @@ float FJoyConInput::GetHapticAmplitudeScale() const {
 }
 
 int FJoyConInput::GetNextControllerId() const {
-	TArray<int> Keys;
 	int NextId = 0;
-	ControllersMap.GetKeys(Keys);
-	for (int Key : Keys) {
-		if (Key == NextId) NextId++;
-	}
+	while (ControllersMap.Contains(NextId)) NextId++;
 	return NextId;
 }
 
+uint32 FJoyConInput::HashDevice(const FJoyConInformation& JoyConInformation) {
+	return HashCombine(GetTypeHash(JoyConInformation.SerialNumber), GetTypeHash(JoyConInformation.BluetoothPath));
+}
+
+FJoyConController* FJoyConInput::FindControllerByDevice(const FJoyConInformation& JoyConInformation) const {
+	for (TMultiMap<uint32, FJoyConController*>::TConstKeyIterator It = ControllersByDevice.CreateConstKeyIterator(HashDevice(JoyConInformation)); It; ++It) {
+		const FJoyConInformation& Other = It.Value()->JoyConInformation;
+		if (Other.SerialNumber.Equals(JoyConInformation.SerialNumber) && Other.BluetoothPath.Equals(JoyConInformation.BluetoothPath)) return It.Value();
+	}
+	return nullptr;
+}
+
+void FJoyConInput::RegisterDevice(FJoyConController* Controller) {
+	ControllersByDevice.Add(HashDevice(Controller->JoyConInformation), Controller);
+}
+
+void FJoyConInput::UnregisterDevice(FJoyConController* Controller) {
+	ControllersByDevice.RemoveSingle(HashDevice(Controller->JoyConInformation), Controller);
+}
+
+bool FJoyConInput::StartPolling(FJoyConController* Controller) const {
+	Controller->SetDropTimeout(DropTimeoutSeconds);
+	if (Reactor.IsValid()) {
+		return Controller->StartReactorPolling() && Reactor->AddController(Controller);
+	}
+	return Controller->StartListenThread();
+}
+
+void FJoyConInput::StopPolling(FJoyConController* Controller) const {
+	if (Reactor.IsValid()) {
+		Reactor->RemoveController(Controller);
+	}
+}
+
 FName FJoyConInput::GetRightJoyConKeyName(const int Index, const FName OriginalKeyName) {
 	switch (Index) {
 
@@ -510,6 +1037,47 @@ void FJoyConInput::SendButtonEvents(const bool bButtonPressed, const float Curre
 	}
 }
 
+void FJoyConInput::SendGestureEvents(const int GripIndex, FJoyConController* Controller) const {
+	float& Magnitude = Controller->ControllerState.GestureMagnitude;
+	bool bSent = false;
+	JoyCon::GestureEvent Gesture;
+	while (Controller->DequeueGesture(Gesture)) {
+		// The magnitude goes first, so bindings of the gesture key can read it
+		Magnitude = Gesture.Magnitude;
+		MessageHandler->OnControllerAnalog(FJoyConKeyNames::JoyCon_Gesture_Magnitude, GripIndex, Magnitude);
+		const FName KeyName = GetGestureKeyName(Gesture);
+		MessageHandler->OnControllerButtonPressed(KeyName, GripIndex, false);
+		MessageHandler->OnControllerButtonReleased(KeyName, GripIndex, false);
+		bSent = true;
+	}
+	// The magnitude only lasts for the frame of its gesture
+	if (!bSent && Magnitude != 0.0f) {
+		Magnitude = 0.0f;
+		MessageHandler->OnControllerAnalog(FJoyConKeyNames::JoyCon_Gesture_Magnitude, GripIndex, Magnitude);
+	}
+}
+
+FName FJoyConInput::GetGestureKeyName(const JoyCon::GestureEvent& Gesture) {
+	switch (Gesture.Type) {
+	case JoyCon::GestureType::Swing:
+		return FJoyConKeyNames::JoyCon_Swing;
+	case JoyCon::GestureType::Shake:
+		return FJoyConKeyNames::JoyCon_Shake;
+	default:
+		break;
+	}
+	switch (Gesture.Direction) {
+	case JoyCon::FlickDirection::Up:
+		return FJoyConKeyNames::JoyCon_Flick_Up;
+	case JoyCon::FlickDirection::Down:
+		return FJoyConKeyNames::JoyCon_Flick_Down;
+	case JoyCon::FlickDirection::Left:
+		return FJoyConKeyNames::JoyCon_Flick_Left;
+	default:
+		return FJoyConKeyNames::JoyCon_Flick_Right;
+	}
+}
+
 void FJoyConInput::SendAnalogEvents(const bool bIsLeft, const int GripIndex, const FVector2D StickVector, FJoyConAnalogState* AnalogState) const {
 	if (StickVector.X != AnalogState->X) {
 		AnalogState->X = StickVector.X;
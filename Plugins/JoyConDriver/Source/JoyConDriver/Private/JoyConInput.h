@@ -6,9 +6,14 @@
 #include "GenericPlatform/IInputInterface.h"
 #include "XRMotionControllerBase.h"
 #include "IHapticDevice.h"
+#include "JoyConCalibrationCache.h"
 #include "JoyConController.h"
+#include "JoyConDeviceMonitor.h"
 #include "JoyConGrip.h"
 #include "JoyConInformation.h"
+#include "JoyConReactor.h"
+#include "JoyConReplayDevice.h"
+#include "JoyConSimulatedDevice.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogJoyConDriver, Log, All);
 
@@ -26,26 +31,67 @@ public:
 	static void LoadConfig();
 
 	/** Commands */
-	TArray<FJoyConInformation>* SearchJoyCons();
+	/** Fills Out with the Joy-Cons present on the system, reusing its allocation */
+	void SearchJoyCons(TArray<FJoyConInformation>& Out);
 
-	TArray<FJoyConInformation>* GetConnectedJoyCons();
+	void GetConnectedJoyCons(TArray<FJoyConInformation>& Out) const;
 
-	TArray<FJoyConInformation>* GetAttachedJoyCons();
+	void GetAttachedJoyCons(TArray<FJoyConInformation>& Out) const;
+
+	/**
+	 * Changes whenever a controller connects, disconnects, attaches or detaches, and with the device monitor running
+	 * whenever the search result changes. Polling this is free, the lists only need to be fetched when it differs.
+	 */
+	uint32 GetJoyConListVersion() const;
 
 	bool ResumeJoyConConnection();
 
+	/** Arrivals and removals reported by the device monitor, broadcast from Tick */
+	FOnJoyConDeviceChanged& OnJoyConDeviceChanged() { return DeviceChangedDelegate; }
+
 	bool ConnectJoyCon(FJoyConInformation JoyConInformation, bool UseImu, bool UseLocalize, float Alpha, int& ControllerId);
 
+	bool ConnectSimulatedJoyCon(const FJoyConSimulatedDeviceSettings& Settings, bool UseImu, bool UseLocalize, float Alpha, int& ControllerId);
+
+	bool ConnectReplayJoyCon(const FJoyConReplayDeviceSettings& Settings, bool UseImu, bool UseLocalize, float Alpha, int& ControllerId);
+
+	bool StartJoyConCapture(int ControllerId, const FString& Filename);
+
+	bool StopJoyConCapture(int ControllerId);
+
+	/** Writes the calibration regions of the controller's SPI flash to a file for offline inspection */
+	bool DumpJoyConFlash(int ControllerId, const FString& Filename);
+
 	bool AttachJoyCon(int ControllerId, int GripIndex);
 
+	/**
+	 * Runs the attach handshake on the thread pool so several controllers attach in parallel without stalling the game
+	 * thread. Returns false if the attach could not be started, otherwise OnComplete fires on the game thread.
+	 */
+	bool AttachJoyConAsync(int ControllerId, int GripIndex, FOnJoyConAttachComplete OnComplete);
+
+	bool IsJoyConAttaching(int ControllerId) const;
+
 	bool DisconnectJoyCon(int ControllerId);
 
 	bool DetachJoyCon(int ControllerId);
 
+	/** Successful automatic reconnects of the controller and the seconds from its drop to the end of the last one */
+	bool GetJoyConRecoveryStats(int ControllerId, int& RecoveryCount, float& LastRecoverySeconds);
+
+	/** IMU reports lost or repeated according to the device timer, and the fitted seconds per timer tick */
+	bool GetJoyConClockStats(int ControllerId, int& LostReports, int& DuplicateReports, float& TickPeriod);
+
 	bool GetJoyConAccelerometer(int ControllerId, FVector& Out);
 
 	bool GetJoyConGyroscope(int ControllerId, FVector& Out);
 
+	/** Gyroscope bias estimated while the controller rested, in rad/s, and the confidence in it from 0 to 1 */
+	bool GetJoyConGyroBias(int ControllerId, FVector& Bias, float& Confidence);
+
+	/** Moves every IMU sample (200 Hz) received since the last call into Out, oldest first */
+	bool DrainJoyConImuSamples(int ControllerId, TArray<FJoyConImuSample>& Out);
+
 	bool GetJoyConVector(int ControllerId, FRotator& Out);
 
 	bool ReCenterJoyCon(int ControllerId);
@@ -78,9 +124,40 @@ public:
 
 private:
 	int GetNextControllerId() const;
+	/**
+	 * Game thread, copies the motion of every grip's controllers into MotionStates. Runs after Update() and whenever a
+	 * grip's controllers change, the motion controller queries never look at the grips themselves.
+	 */
+	void PublishMotionStates();
+	/** Snapshot of the grip at ControllerIndex for the hand, the first controller of the grip for AnyHand */
+	bool FindMotionState(int32 ControllerIndex, EControllerHand DeviceHand, FJoyConMotionState& Out) const;
+	/** Hash of the serial number and path that identify a device, the key of ControllersByDevice */
+	static uint32 HashDevice(const FJoyConInformation& JoyConInformation);
+	FJoyConController* FindControllerByDevice(const FJoyConInformation& JoyConInformation) const;
+	void RegisterDevice(FJoyConController* Controller);
+	void UnregisterDevice(FJoyConController* Controller);
+	bool AddController(const FJoyConInformation& JoyConInformation, IJoyConDevice* Device, bool UseImu, bool UseLocalize, float Alpha, int& ControllerId);
+	/** Validates an attach request and hands the cached calibration to the controller, returns null if it cannot attach */
+	FJoyConController* PrepareAttach(int ControllerId, int GripIndex);
+	/** Adds a controller whose handshake succeeded to its grip and starts polling it */
+	bool FinishAttach(FJoyConController* Controller, int GripIndex, bool bHandshakeSucceeded);
+	/** Starts recovering attached controllers that dropped and runs the reconnect attempts that are due */
+	void UpdateRecovery();
+	void DispatchDeviceEvents();
+	void StartReconnectAttempt(int ControllerId);
+	void ContinueReconnectAttempt(int ControllerId, hid_device* Handle, const FString& Path);
+	void FinishReconnectAttempt(int ControllerId, bool bSuccess, const FString& Path);
+	/** Runs Work on the thread pool, the destructor waits for every worker started here */
+	void RunOnWorker(TUniqueFunction<void()> Work);
+	void ReplayThroughput(FJoyConReplayDeviceSettings Settings, FOutputDevice& Ar);
+	bool StartPolling(FJoyConController* Controller) const;
+	void StopPolling(FJoyConController* Controller) const;
 	static FName GetRightJoyConKeyName(int Index, FName OriginalKeyName);
 	void SendButtonEvents(bool bButtonPressed, float CurrentTime, int GripIndex, FName KeyName, FJoyConButtonState *ButtonState) const;
 	void SendAnalogEvents(bool bIsLeft, int GripIndex, FVector2D StickVector, FJoyConAnalogState* AnalogState) const;
+	/** Forwards the gestures the controller recognized since the last frame as key presses of their gesture key */
+	void SendGestureEvents(int GripIndex, FJoyConController* Controller) const;
+	static FName GetGestureKeyName(const JoyCon::GestureEvent& Gesture);
 	
 private:
 	/** The recipient of motion controller input events */
@@ -89,9 +166,69 @@ private:
 	/** Repeat key delays, loaded from config */
 	static float InitialButtonRepeatDelay;
 	static float ButtonRepeatDelay;
+
+	/** Service every controller from a single FJoyConReactor thread instead of one thread each, loaded from config */
+	static bool bUseIoReactor;
+
+	/** Seconds without a report before a controller is considered dropped, loaded from config */
+	static float DropTimeoutSeconds;
+
+	/** Persist calibration per serial number so known controllers attach without reading it first, loaded from config */
+	static bool bUseCalibrationCache;
+
+	/** Reopen attached controllers that dropped, retrying with exponential backoff between the delays, loaded from config */
+	static bool bAutoReconnect;
+	static float ReconnectInitialDelaySeconds;
+	static float ReconnectMaxDelaySeconds;
+
+	/** Track arrivals and removals from hot-plug notifications instead of enumerating on every search, loaded from config */
+	static bool bUseDeviceMonitor;
+
+	/** Orientation filter of new controllers, Madgwick, Mahony or Basis, loaded from config */
+	static JoyCon::OrientationFilterType OrientationFilter;
+
+	/** Re-estimate the gyroscope bias of new controllers whenever they rest, loaded from config */
+	static bool bEstimateGyroBias;
+
+	/** Seconds motion controller orientations are predicted past the query, 0 only compensates the report's age, loaded from config */
+	static bool bPredictMotion;
+	static float MotionPredictionSeconds;
+
+	/** Recognize swings, shakes and flicks on the polling thread and send them as gesture keys, loaded from config */
+	static bool bDetectGestures;
 	
 	bool HidInitialized;
 	TArray<FJoyConController*> Controllers;
     TMap<int, FJoyConController*> ControllersMap;
+	/** Connected controllers by HashDevice(), entries with the same hash are told apart by comparing the strings */
+	TMultiMap<uint32, FJoyConController*> ControllersByDevice;
+	/** Bumped by every change to the connected or attached lists, see GetJoyConListVersion() */
+	uint32 ListVersion;
 	FJoyConGrip Grips[8];
+	/** Motion of each grip's left, right and first controller, the render thread reads it while the grips change */
+	mutable FCriticalSection MotionMutex;
+	/** Guarded by MotionMutex */
+	FJoyConMotionState MotionStates[8][3];
+	TUniquePtr<FJoyConReactor> Reactor;
+	TUniquePtr<FJoyConCalibrationCache> CalibrationCache;
+	TUniquePtr<FJoyConDeviceMonitor> DeviceMonitor;
+	FOnJoyConDeviceChanged DeviceChangedDelegate;
+	TArray<FJoyConDeviceEvent> PendingDeviceEvents;
+
+	/** Controllers whose handshake runs on a worker, they are left alone until it finished */
+	TSet<int> AttachingControllers;
+	/** Expires with this object, so completions queued by workers can tell it is gone */
+	TSharedPtr<int32, ESPMode::ThreadSafe> AsyncToken;
+	/** Workers that may still use a controller or HIDAPI, see RunOnWorker() */
+	TAtomic<int32> RunningWorkers;
+
+	struct FJoyConRecovery {
+		int GripIndex;
+		int Attempt;
+		double DroppedTime;
+		double NextAttemptTime;
+		bool bAttemptInFlight;
+	};
+	/** Dropped controllers that keep their id and grip slot while they are reopened */
+	TMap<int, FJoyConRecovery> Recoveries;
 };
\ No newline at end of file
@@ -0,0 +1,232 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConReactor.h"
+
+#include "JoyConController.h"
+#include "HAL/Event.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+
+#if PLATFORM_LINUX
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#elif PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+// Upper bound for a single wait, so Stop() is honoured even if waking fails
+static constexpr int32 ReactorWaitTimeoutMs = 100;
+// Wait used while some devices have no waitable handle and must be polled
+static constexpr int32 ReactorPollIntervalMs = 1;
+
+FJoyConReactor::FJoyConReactor() :
+	CompletedIterations(0),
+	IterationEvent(FPlatformProcess::GetSynchEventFromPool(true)),
+	Thread(nullptr),
+	bStopping(false) {
+#if PLATFORM_LINUX
+	EpollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (EpollFd >= 0 && WakeSignal.IsValid()) {
+		epoll_event Event = {};
+		Event.events = EPOLLIN;
+		Event.data.ptr = nullptr;
+		epoll_ctl(EpollFd, EPOLL_CTL_ADD, static_cast<int>(WakeSignal.GetWaitHandle()), &Event);
+	}
+#endif
+}
+
+FJoyConReactor::~FJoyConReactor() {
+	if (Thread != nullptr) {
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(IterationEvent);
+	IterationEvent = nullptr;
+#if PLATFORM_LINUX
+	if (EpollFd >= 0) close(EpollFd);
+#endif
+}
+
+bool FJoyConReactor::AddController(FJoyConController* Controller) {
+	if (Controller == nullptr || Controller->GetDevice() == nullptr) return false;
+	{
+		FScopeLock Lock(&Mutex);
+		if (Controllers.Contains(Controller)) return true;
+		const intptr_t Handle = Controller->GetDevice()->GetPollHandle();
+		if (Handle == -1) {
+			PolledControllers.Add(Controller);
+		} else {
+#if PLATFORM_LINUX
+			epoll_event Event = {};
+			Event.events = EPOLLIN;
+			Event.data.ptr = Controller;
+			if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, static_cast<int>(Handle), &Event) != 0) {
+				UE_LOG(LogTemp, Warning, TEXT("Failed to register JoyCon with the I/O reactor."));
+				return false;
+			}
+#endif
+		}
+		Controllers.Add(Controller);
+	}
+	WakeSignal.Trigger();
+	return StartThread();
+}
+
+void FJoyConReactor::RemoveController(FJoyConController* Controller) {
+	uint64 Iteration;
+	{
+		FScopeLock Lock(&Mutex);
+		RemoveControllerLocked(Controller);
+		Iteration = CompletedIterations;
+	}
+	if (Thread == nullptr) return;
+	// The iteration in progress may have taken the device handle before the removal, wait until it is done with it
+	for (;;) {
+		IterationEvent->Reset();
+		{
+			FScopeLock Lock(&Mutex);
+			if (CompletedIterations != Iteration) return;
+		}
+		if (bStopping) return;
+		WakeSignal.Trigger();
+		IterationEvent->Wait(ReactorWaitTimeoutMs);
+	}
+}
+
+int32 FJoyConReactor::Num() {
+	FScopeLock Lock(&Mutex);
+	return Controllers.Num();
+}
+
+bool FJoyConReactor::Init() {
+	return true;
+}
+
+uint32 FJoyConReactor::Run() {
+#if PLATFORM_LINUX
+	epoll_event Events[16];
+	while (!bStopping) {
+		int32 WaitMs;
+		{
+			FScopeLock Lock(&Mutex);
+			WaitMs = PolledControllers.Num() > 0 ? ReactorPollIntervalMs : ReactorWaitTimeoutMs;
+		}
+		const int Count = epoll_wait(EpollFd, Events, UE_ARRAY_COUNT(Events), WaitMs);
+		if (Count < 0) {
+			if (errno == EINTR) continue;
+			UE_LOG(LogTemp, Error, TEXT("JoyCon I/O reactor epoll_wait failed (%d)."), errno);
+			break;
+		}
+		FScopeLock Lock(&Mutex);
+		for (int i = 0; i < Count; ++i) {
+			FJoyConController* Controller = static_cast<FJoyConController*>(Events[i].data.ptr);
+			if (Controller == nullptr) {
+				WakeSignal.Drain();
+				continue;
+			}
+			// The controller may have been removed while we were waiting
+			if (Controllers.Contains(Controller)) ServiceController(Controller);
+		}
+		for (int32 i = PolledControllers.Num() - 1; i >= 0; --i) {
+			ServiceController(PolledControllers[i]);
+		}
+		SweepTimeouts();
+		FinishIterationLocked();
+	}
+#elif PLATFORM_WINDOWS
+	HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+	while (!bStopping) {
+		DWORD NumHandles = 0;
+		DWORD WaitMs;
+		if (WakeSignal.IsValid()) Handles[NumHandles++] = reinterpret_cast<HANDLE>(WakeSignal.GetWaitHandle());
+		{
+			FScopeLock Lock(&Mutex);
+			WaitMs = PolledControllers.Num() > 0 ? ReactorPollIntervalMs : ReactorWaitTimeoutMs;
+			for (FJoyConController* Controller : Controllers) {
+				if (NumHandles == MAXIMUM_WAIT_OBJECTS) break;
+				const intptr_t Handle = Controller->GetDevice()->GetPollHandle();
+				if (Handle != -1) Handles[NumHandles++] = reinterpret_cast<HANDLE>(Handle);
+			}
+		}
+		const DWORD Result = WaitForMultipleObjects(NumHandles, Handles, FALSE, WaitMs);
+		if (Result == WAIT_FAILED) {
+			FPlatformProcess::Sleep(0.001f);
+		}
+		// Reads are non-blocking, so servicing every controller is cheaper than
+		// mapping signaled handles back and avoids starving higher indices
+		FScopeLock Lock(&Mutex);
+		for (int32 i = Controllers.Num() - 1; i >= 0; --i) {
+			ServiceController(Controllers[i]);
+		}
+		SweepTimeouts();
+		FinishIterationLocked();
+	}
+#else
+	while (!bStopping) {
+		{
+			FScopeLock Lock(&Mutex);
+			for (int32 i = Controllers.Num() - 1; i >= 0; --i) {
+				ServiceController(Controllers[i]);
+			}
+			SweepTimeouts();
+			FinishIterationLocked();
+		}
+		FPlatformProcess::Sleep(ReactorPollIntervalMs / 1000.0f);
+	}
+#endif
+	// Also reached when the wait fails, RemoveController() must not wait for iterations that never come
+	bStopping = true;
+	IterationEvent->Trigger();
+	return 0;
+}
+
+void FJoyConReactor::Stop() {
+	bStopping = true;
+	WakeSignal.Trigger();
+	IterationEvent->Trigger();
+}
+
+bool FJoyConReactor::StartThread() {
+	if (Thread != nullptr) return true;
+	if (!FPlatformProcess::SupportsMultithreading()) {
+		UE_LOG(LogTemp, Fatal, TEXT("Failed to start the JoyCon I/O reactor, the platform does not support multithreading."));
+		return false;
+	}
+	bStopping = false;
+	Thread = FRunnableThread::Create(this, TEXT("FJoyConReactor"), 0, EThreadPriority::TPri_AboveNormal);
+	return Thread != nullptr;
+}
+
+void FJoyConReactor::ServiceController(FJoyConController* Controller) {
+	if (Controller->PumpReports() < 0) {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon %d dropped, removing it from the I/O reactor."), Controller->JoyConInformation.ControllerId);
+		RemoveControllerLocked(Controller);
+	}
+}
+
+void FJoyConReactor::SweepTimeouts() {
+	// A silent device never becomes readable, so drop detection cannot rely on servicing alone
+	for (int32 i = Controllers.Num() - 1; i >= 0; --i) {
+		if (Controllers[i]->CheckReportTimeout()) RemoveControllerLocked(Controllers[i]);
+	}
+}
+
+void FJoyConReactor::RemoveControllerLocked(FJoyConController* Controller) {
+	if (Controllers.Remove(Controller) == 0) return;
+	if (PolledControllers.Remove(Controller) > 0) return;
+#if PLATFORM_LINUX
+	const intptr_t Handle = Controller->GetDevice()->GetPollHandle();
+	if (Handle != -1) epoll_ctl(EpollFd, EPOLL_CTL_DEL, static_cast<int>(Handle), nullptr);
+#endif
+}
+
+void FJoyConReactor::FinishIterationLocked() {
+	CompletedIterations++;
+	IterationEvent->Trigger();
+}
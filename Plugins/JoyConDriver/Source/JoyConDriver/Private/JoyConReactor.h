@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "JoyConWakeSignal.h"
+
+class FEvent;
+class FJoyConController;
+
+/**
+ * Single I/O thread that services every attached Joy-Con, used instead of one
+ * FJoyConController listen thread per controller when bUseIoReactor is enabled.
+ * The thread waits on all device handles at once (epoll on Linux,
+ * WaitForMultipleObjects on Windows) and pumps the controllers whose reports are ready.
+ */
+class FJoyConReactor : public FRunnable {
+
+public:
+	FJoyConReactor();
+	virtual ~FJoyConReactor();
+
+	/** Starts servicing the controller, spawning the reactor thread on first use */
+	bool AddController(FJoyConController* Controller);
+
+	/**
+	 * Stops servicing the controller, once this returns the reactor no longer touches it. Waits for the reactor's
+	 * current iteration, which may still wait on the controller's handle, so it must not be called from the reactor.
+	 */
+	void RemoveController(FJoyConController* Controller);
+
+	int32 Num();
+
+	// FRunnable interface overrides
+	virtual bool Init() override;
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	bool StartThread();
+	void ServiceController(FJoyConController* Controller);
+	void SweepTimeouts();
+	void RemoveControllerLocked(FJoyConController* Controller);
+	void FinishIterationLocked();
+
+private:
+	TArray<FJoyConController*> Controllers;
+	/** Controllers whose device has no waitable handle, serviced on every iteration */
+	TArray<FJoyConController*> PolledControllers;
+	FCriticalSection Mutex;
+	/** Iterations the reactor thread finished, guarded by Mutex. RemoveController() waits for it to advance. */
+	uint64 CompletedIterations;
+	/** Triggered after every iteration */
+	FEvent* IterationEvent;
+	FRunnableThread* Thread;
+	TAtomic<bool> bStopping;
+	FJoyConWakeSignal WakeSignal;
+
+#if PLATFORM_LINUX
+	int EpollFd;
+#endif
+};
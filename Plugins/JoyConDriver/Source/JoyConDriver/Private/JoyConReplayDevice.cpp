@@ -0,0 +1,160 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConReplayDevice.h"
+
+#include "JoyConSimulatedDevice.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+
+// At full speed Read reports "nothing pending" after this many reports, so a pump returns before the
+// controller's report ring (64 entries) overflows
+static constexpr int32 MaxBurstReports = 32;
+// Granularity of blocking reads while there is nothing to deliver
+static constexpr float IdleSleepSeconds = 0.002f;
+
+FJoyConReplayDevice* FJoyConReplayDevice::Open(const FJoyConReplayDeviceSettings& Settings) {
+	TUniquePtr<FJoyConReportLog> Log = FJoyConReportLog::Open(Settings.Filename);
+	if (!Log.IsValid()) return nullptr;
+	return new FJoyConReplayDevice(Settings, MoveTemp(Log));
+}
+
+FJoyConReplayDevice::FJoyConReplayDevice(const FJoyConReplayDeviceSettings& InSettings, TUniquePtr<FJoyConReportLog> InLog) :
+	Settings(InSettings),
+	Log(MoveTemp(InLog)),
+	InputMode(0x3f),
+	BurstCount(0),
+	ReplayStartTime(0.0),
+	LogStartTimestampNs(0),
+	ReportsDelivered(0),
+	bFinished(false) {
+	Cursor = NextStreamRecord(0);
+	// A log without input reports has nothing to deliver, it is finished before it starts
+	bFinished = Cursor == INDEX_NONE && !Settings.bLoop;
+	BuildFlashImage();
+}
+
+int32 FJoyConReplayDevice::Read(uint8* Data, const size_t Length, const int32 Milliseconds) {
+	const double Deadline = Milliseconds < 0 ? TNumericLimits<double>::Max() : FPlatformTime::Seconds() + Milliseconds / 1000.0;
+	const int32 CopyLen = static_cast<int32>(FMath::Min<size_t>(Length, ReportLen));
+
+	for (;;) {
+		double WakeTime;
+		{
+			FScopeLock Lock(&Mutex);
+			if (PendingReplies.Num() > 0) {
+				FMemory::Memcpy(Data, PendingReplies[0].Data, CopyLen);
+				PendingReplies.RemoveAt(0, 1, false);
+				return CopyLen;
+			}
+
+			const double Now = FPlatformTime::Seconds();
+			WakeTime = FMath::Min(Now + IdleSleepSeconds, Deadline);
+			if (InputMode == 0x30 && Cursor == INDEX_NONE && Settings.bLoop) {
+				Cursor = NextStreamRecord(0);
+				ReplayStartTime = 0.0;
+			}
+			if (InputMode == 0x30 && Cursor != INDEX_NONE) {
+				const FJoyConReportLogRecord& Record = (*Log)[Cursor];
+				if (ReplayStartTime == 0.0) {
+					ReplayStartTime = Now;
+					LogStartTimestampNs = Record.TimestampNs;
+				}
+				bool bDue;
+				if (Settings.Speed > 0.0f) {
+					const double DueTime = ReplayStartTime + (Record.TimestampNs - LogStartTimestampNs) / 1e9 / Settings.Speed;
+					bDue = Now >= DueTime;
+					if (!bDue) WakeTime = FMath::Min(DueTime, Deadline);
+				} else {
+					bDue = BurstCount < MaxBurstReports;
+					BurstCount = bDue ? BurstCount + 1 : 0;
+				}
+				if (bDue) {
+					FMemory::Memzero(Data, CopyLen);
+					FMemory::Memcpy(Data, Record.Data, FMath::Min<int32>(CopyLen, Record.Length));
+					Cursor = NextStreamRecord(Cursor + 1);
+					if (Cursor == INDEX_NONE && !Settings.bLoop) bFinished = true;
+					++ReportsDelivered;
+					return CopyLen;
+				}
+				if (Settings.Speed <= 0.0f) return 0;
+			}
+			if (Milliseconds == 0 || Now >= Deadline) return 0;
+		}
+		const double SleepTime = WakeTime - FPlatformTime::Seconds();
+		if (SleepTime > 0.0) FPlatformProcess::Sleep(static_cast<float>(SleepTime));
+	}
+}
+
+int32 FJoyConReplayDevice::Write(const uint8* Data, const size_t Length) {
+	if (Data == nullptr || Length == 0) return -1;
+	if (Data[0] != 0x01 || Length < 11) return static_cast<int32>(Length);
+
+	FScopeLock Lock(&Mutex);
+	const uint8 SubCommand = Data[10];
+	const uint8* Args = Data + 11;
+	const size_t ArgsLen = Length - 11;
+
+	FPendingReport Reply;
+	FMemory::Memzero(Reply.Data, ReportLen);
+	Reply.Data[0] = 0x21;
+	Reply.Data[13] = 0x80;
+	Reply.Data[14] = SubCommand;
+	if (SubCommand == 0x03 && ArgsLen > 0) {
+		InputMode = Args[0];
+	} else if (SubCommand == 0x10 && ArgsLen >= 5) {
+		Reply.Data[13] = 0x90;
+		const uint32 Address = Args[0] | (Args[1] << 8) | (Args[2] << 16) | (Args[3] << 24);
+		const uint32 Len = FMath::Min<uint32>(Args[4], 0x1d);
+		FMemory::Memcpy(&Reply.Data[15], Args, 5);
+		for (uint32 i = 0; i < Len; ++i) {
+			const uint32 Offset = Address + i;
+			Reply.Data[20 + i] = Offset < static_cast<uint32>(Flash.Num()) ? Flash[Offset] : 0xff;
+		}
+	}
+	PendingReplies.Add(Reply);
+	return static_cast<int32>(Length);
+}
+
+intptr_t FJoyConReplayDevice::GetPollHandle() {
+	return -1;
+}
+
+bool FJoyConReplayDevice::IsLeft() const {
+	return Log->IsLeft();
+}
+
+bool FJoyConReplayDevice::IsFinished() const {
+	return bFinished;
+}
+
+uint64 FJoyConReplayDevice::GetReportsDelivered() const {
+	return ReportsDelivered;
+}
+
+void FJoyConReplayDevice::BuildFlashImage() {
+	// Start from plausible defaults and overlay every SPI read reply the capture saw
+	Flash = FJoyConSimulatedDevice::DefaultFlashImage(Log->IsLeft());
+	int32 Recovered = 0;
+	for (int32 i = 0; i < Log->Num(); ++i) {
+		const FJoyConReportLogRecord& Record = (*Log)[i];
+		if (Record.Length < 20 || Record.Data[0] != 0x21 || Record.Data[14] != 0x10) continue;
+		const uint32 Address = Record.Data[15] | (Record.Data[16] << 8) | (Record.Data[17] << 16) | (Record.Data[18] << 24);
+		const uint32 Len = FMath::Min<uint32>(Record.Data[19], Record.Length - 20);
+		for (uint32 j = 0; j < Len; ++j) {
+			if (Address + j < static_cast<uint32>(Flash.Num())) Flash[Address + j] = Record.Data[20 + j];
+		}
+		Recovered++;
+	}
+	if (Recovered == 0) {
+		UE_LOG(LogTemp, Warning, TEXT("JoyCon report log %s has no calibration, using default calibration."), *Settings.Filename);
+	}
+}
+
+int32 FJoyConReplayDevice::NextStreamRecord(const int32 From) const {
+	for (int32 i = From; i < Log->Num(); ++i) {
+		if ((*Log)[i].Data[0] == 0x30) return i;
+	}
+	return INDEX_NONE;
+}
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JoyConDevice.h"
+#include "JoyConReportLog.h"
+
+struct FJoyConReplayDeviceSettings {
+	FString Filename;
+
+	/** Playback rate relative to the capture, 0 or less replays as fast as the reports are read */
+	float Speed;
+
+	/** Start over at the end of the log instead of going silent */
+	bool bLoop;
+
+	FJoyConReplayDeviceSettings() :
+		Speed(1.0f),
+		bLoop(false) {
+	}
+};
+
+/**
+ * Feeds the 0x30 reports of a capture back through the IJoyConDevice contract. Subcommands are acknowledged, and SPI
+ * reads are answered from the replies recorded in the log, so calibration matches the captured controller as long as
+ * the capture started before it was attached.
+ */
+class FJoyConReplayDevice : public IJoyConDevice {
+
+public:
+	/** Returns null if the log cannot be opened */
+	static FJoyConReplayDevice* Open(const FJoyConReplayDeviceSettings& Settings);
+
+	virtual int32 Read(uint8* Data, size_t Length, int32 Milliseconds) override;
+	virtual int32 Write(const uint8* Data, size_t Length) override;
+	virtual intptr_t GetPollHandle() override;
+
+	bool IsLeft() const;
+
+	/** True once every report was delivered, never true when looping */
+	bool IsFinished() const;
+
+	uint64 GetReportsDelivered() const;
+
+private:
+	FJoyConReplayDevice(const FJoyConReplayDeviceSettings& InSettings, TUniquePtr<FJoyConReportLog> InLog);
+
+	void BuildFlashImage();
+	int32 NextStreamRecord(int32 From) const;
+
+private:
+	static const uint32 ReportLen = 49;
+
+	struct FPendingReport {
+		uint8 Data[ReportLen];
+	};
+
+	FJoyConReplayDeviceSettings Settings;
+	TUniquePtr<FJoyConReportLog> Log;
+	FCriticalSection Mutex;
+
+	TArray<FPendingReport> PendingReplies;
+	TArray<uint8> Flash;
+
+	uint8 InputMode;
+	int32 Cursor;
+	int32 BurstCount;
+	double ReplayStartTime;
+	uint64 LogStartTimestampNs;
+	TAtomic<uint64> ReportsDelivered;
+	TAtomic<bool> bFinished;
+};
@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConReportLog.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+
+FJoyConReportLogWriter::FJoyConReportLogWriter(IFileHandle* InFile) :
+	File(InFile),
+	Batch{},
+	BatchCount(0),
+	NumRecords(0) {
+}
+
+FJoyConReportLogWriter::~FJoyConReportLogWriter() {
+	Flush();
+}
+
+TUniquePtr<FJoyConReportLogWriter> FJoyConReportLogWriter::Open(const FString& Filename, const bool bIsLeft) {
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const int64 ExistingSize = PlatformFile.FileSize(*Filename);
+	if (ExistingSize > 0) {
+		// Only append to a well-formed log of the same side, a torn record would misalign everything after it
+		FJoyConReportLogHeader Header;
+		TUniquePtr<IFileHandle> Existing(PlatformFile.OpenRead(*Filename));
+		const bool bValid = Existing.IsValid()
+			&& ExistingSize >= static_cast<int64>(sizeof(Header))
+			&& Existing->Read(reinterpret_cast<uint8*>(&Header), sizeof(Header))
+			&& Header.Magic == FJoyConReportLogHeader::MagicValue
+			&& Header.Version == FJoyConReportLogHeader::CurrentVersion
+			&& Header.RecordSize == sizeof(FJoyConReportLogRecord)
+			&& ((Header.Flags & 0x1) != 0) == bIsLeft
+			&& (ExistingSize - sizeof(Header)) % sizeof(FJoyConReportLogRecord) == 0;
+		if (!bValid) {
+			UE_LOG(LogTemp, Warning, TEXT("Cannot append to JoyCon report log %s, it is not a compatible log."), *Filename);
+			return nullptr;
+		}
+	}
+
+	IFileHandle* Handle = PlatformFile.OpenWrite(*Filename, true);
+	if (Handle == nullptr) {
+		UE_LOG(LogTemp, Warning, TEXT("Failed to open JoyCon report log %s for writing."), *Filename);
+		return nullptr;
+	}
+	TUniquePtr<FJoyConReportLogWriter> Writer(new FJoyConReportLogWriter(Handle));
+	if (ExistingSize <= 0) {
+		FJoyConReportLogHeader Header = {};
+		Header.Magic = FJoyConReportLogHeader::MagicValue;
+		Header.Version = FJoyConReportLogHeader::CurrentVersion;
+		Header.RecordSize = sizeof(FJoyConReportLogRecord);
+		Header.Flags = bIsLeft ? 0x1 : 0x0;
+		Header.StartTimestampNs = NowNs();
+		if (!Handle->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header))) return nullptr;
+	}
+	return Writer;
+}
+
+void FJoyConReportLogWriter::Append(const uint8* Data, const int32 Length, const uint64 TimestampNs) {
+	FJoyConReportLogRecord& Record = Batch[BatchCount++];
+	FMemory::Memzero(Record);
+	Record.TimestampNs = TimestampNs;
+	Record.Length = static_cast<uint8>(FMath::Clamp<int32>(Length, 0, sizeof(Record.Data)));
+	FMemory::Memcpy(Record.Data, Data, Record.Length);
+	++NumRecords;
+	if (BatchCount == BatchSize) Flush();
+}
+
+bool FJoyConReportLogWriter::Flush() {
+	if (!File.IsValid()) return false;
+	bool bSuccess = true;
+	if (BatchCount > 0) {
+		bSuccess = File->Write(reinterpret_cast<const uint8*>(Batch), BatchCount * sizeof(FJoyConReportLogRecord));
+		BatchCount = 0;
+	}
+	return File->Flush() && bSuccess;
+}
+
+uint64 FJoyConReportLogWriter::NowNs() {
+	return static_cast<uint64>(FPlatformTime::Cycles64() * FPlatformTime::GetSecondsPerCycle64() * 1e9);
+}
+
+FJoyConReportLog::FJoyConReportLog() :
+	Data(nullptr),
+	Records(nullptr),
+	NumRecords(0) {
+}
+
+FJoyConReportLog::~FJoyConReportLog() {
+	// The region has to be released before the file it maps
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+}
+
+TUniquePtr<FJoyConReportLog> FJoyConReportLog::Open(const FString& Filename) {
+	TUniquePtr<FJoyConReportLog> Log(new FJoyConReportLog());
+	int64 Size = 0;
+
+	Log->MappedHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+	if (Log->MappedHandle.IsValid()) {
+		Log->MappedRegion.Reset(Log->MappedHandle->MapRegion());
+	}
+	if (Log->MappedRegion.IsValid()) {
+		Log->Data = Log->MappedRegion->GetMappedPtr();
+		Size = Log->MappedRegion->GetMappedSize();
+	} else if (FFileHelper::LoadFileToArray(Log->FileData, *Filename)) {
+		Log->Data = Log->FileData.GetData();
+		Size = Log->FileData.Num();
+	} else {
+		UE_LOG(LogTemp, Warning, TEXT("Failed to open JoyCon report log %s."), *Filename);
+		return nullptr;
+	}
+
+	if (Size < static_cast<int64>(sizeof(FJoyConReportLogHeader))) return nullptr;
+	const FJoyConReportLogHeader& Header = Log->GetHeader();
+	if (Header.Magic != FJoyConReportLogHeader::MagicValue || Header.Version != FJoyConReportLogHeader::CurrentVersion || Header.RecordSize != sizeof(FJoyConReportLogRecord)) {
+		UE_LOG(LogTemp, Warning, TEXT("%s is not a JoyCon report log."), *Filename);
+		return nullptr;
+	}
+	Log->Records = reinterpret_cast<const FJoyConReportLogRecord*>(Log->Data + sizeof(FJoyConReportLogHeader));
+	Log->NumRecords = static_cast<int32>((Size - sizeof(FJoyConReportLogHeader)) / sizeof(FJoyConReportLogRecord));
+	return Log;
+}
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/UniquePtr.h"
+
+class IFileHandle;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * On-disk layout of a JoyCon report log (.jcrl). The file is a fixed header followed by fixed-size records, so it
+ * can be appended to while capturing and indexed directly once memory-mapped. A truncated last record is ignored.
+ */
+struct FJoyConReportLogHeader {
+	static constexpr uint32 MagicValue = 0x4c52434a; // "JCRL"
+	static constexpr uint16 CurrentVersion = 1;
+
+	uint32 Magic;
+	uint16 Version;
+	uint16 RecordSize;
+	/** Bit 0 set for a left Joy-Con */
+	uint32 Flags;
+	uint32 Reserved;
+	/** Monotonic host time of the capture start, in nanoseconds */
+	uint64 StartTimestampNs;
+	uint64 Reserved2;
+};
+
+struct FJoyConReportLogRecord {
+	/** Monotonic host time at which the report was read, in nanoseconds */
+	uint64 TimestampNs;
+	uint8 Data[49];
+	uint8 Length;
+	uint8 Reserved[6];
+};
+
+static_assert(sizeof(FJoyConReportLogHeader) == 32, "JoyCon report log header layout changed");
+static_assert(sizeof(FJoyConReportLogRecord) == 64, "JoyCon report log record layout changed");
+
+/** Appends reports to a log file, records are batched and written out when the batch fills up or on Flush() */
+class FJoyConReportLogWriter {
+
+public:
+	~FJoyConReportLogWriter();
+
+	/** Creates the file, or appends to it if it already holds a log for the same side */
+	static TUniquePtr<FJoyConReportLogWriter> Open(const FString& Filename, bool bIsLeft);
+
+	void Append(const uint8* Data, int32 Length, uint64 TimestampNs);
+	bool Flush();
+
+	uint64 Num() const { return NumRecords; }
+
+	/** Monotonic host clock used for the record timestamps */
+	static uint64 NowNs();
+
+private:
+	explicit FJoyConReportLogWriter(IFileHandle* InFile);
+
+	static constexpr int32 BatchSize = 64;
+
+	TUniquePtr<IFileHandle> File;
+	FJoyConReportLogRecord Batch[BatchSize];
+	int32 BatchCount;
+	uint64 NumRecords;
+};
+
+/** Read-only view of a log file, memory-mapped when the platform supports it */
+class FJoyConReportLog {
+
+public:
+	~FJoyConReportLog();
+
+	static TUniquePtr<FJoyConReportLog> Open(const FString& Filename);
+
+	const FJoyConReportLogHeader& GetHeader() const { return *reinterpret_cast<const FJoyConReportLogHeader*>(Data); }
+	int32 Num() const { return NumRecords; }
+	const FJoyConReportLogRecord& operator[](const int32 Index) const { return Records[Index]; }
+	bool IsLeft() const { return (GetHeader().Flags & 0x1) != 0; }
+
+private:
+	FJoyConReportLog();
+
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	/** Used when the file could not be mapped */
+	TArray<uint8> FileData;
+
+	const uint8* Data;
+	const FJoyConReportLogRecord* Records;
+	int32 NumRecords;
+};
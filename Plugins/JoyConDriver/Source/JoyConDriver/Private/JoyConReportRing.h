@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Atomic.h"
+
+/** What the producer does when the ring is full */
+enum class EJoyConRingOverflow : uint8 {
+	/** Discard the oldest queued element, the consumer always sees the freshest data */
+	OverwriteOldest,
+	/** Discard the element being enqueued */
+	DropNewest,
+};
+
+/**
+ * Fixed capacity, lock-free single-producer/single-consumer ring.
+ * Elements are stored inline and copied in and out, so once constructed the ring never allocates.
+ * The producer and consumer indices live on separate cache lines to avoid false sharing between the
+ * listen thread and the game thread.
+ *
+ * With OverwriteOldest the producer may advance the consumer index itself, both sides then claim the
+ * tail with a compare-exchange and the consumer discards a copy if the producer claimed it first.
+ */
+template <typename ElementType, uint32 Capacity>
+class TJoyConSpscRing {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "TJoyConSpscRing capacity must be a power of two.");
+
+public:
+	explicit TJoyConSpscRing(const EJoyConRingOverflow InPolicy = EJoyConRingOverflow::OverwriteOldest) :
+		Head(0),
+		Tail(0),
+		Policy(InPolicy),
+		HighWaterMark(0),
+		Overflows(0) {
+	}
+
+	/** Producer side. Returns false if the element was dropped */
+	bool Enqueue(const ElementType& Element) {
+		const uint32 CurrentHead = Head.Load(EMemoryOrder::Relaxed);
+		uint32 CurrentTail = Tail.Load();
+		if (CurrentHead - CurrentTail >= Capacity) {
+			Overflows.IncrementExchange();
+			if (Policy == EJoyConRingOverflow::DropNewest) return false;
+			// Claim the oldest slot before overwriting it, if the consumer got there first it is free already
+			Tail.CompareExchange(CurrentTail, CurrentTail + 1);
+		}
+		Slots[CurrentHead & (Capacity - 1)] = Element;
+		Head.Store(CurrentHead + 1);
+
+		const uint32 Count = CurrentHead + 1 - Tail.Load(EMemoryOrder::Relaxed);
+		if (Count > HighWaterMark.Load(EMemoryOrder::Relaxed)) HighWaterMark.Store(Count, EMemoryOrder::Relaxed);
+		return true;
+	}
+
+	/** Consumer side. Returns false if the ring is empty */
+	bool Dequeue(ElementType& OutElement) {
+		for (;;) {
+			uint32 CurrentTail = Tail.Load();
+			if (CurrentTail == Head.Load()) return false;
+			const ElementType Element = Slots[CurrentTail & (Capacity - 1)];
+			// Fails only if the producer overwrote this slot while we were copying it
+			if (Tail.CompareExchange(CurrentTail, CurrentTail + 1)) {
+				OutElement = Element;
+				return true;
+			}
+		}
+	}
+
+	bool IsEmpty() const {
+		return Tail.Load() == Head.Load();
+	}
+
+	uint32 Num() const {
+		return Head.Load() - Tail.Load();
+	}
+
+	static constexpr uint32 GetCapacity() {
+		return Capacity;
+	}
+
+	/** Largest number of queued elements seen since construction or the last reset */
+	uint32 GetHighWaterMark() const {
+		return HighWaterMark.Load(EMemoryOrder::Relaxed);
+	}
+
+	void ResetHighWaterMark() {
+		HighWaterMark.Store(0, EMemoryOrder::Relaxed);
+	}
+
+	/** Number of times the ring was full, regardless of the policy */
+	uint64 GetOverflowCount() const {
+		return Overflows.Load(EMemoryOrder::Relaxed);
+	}
+
+private:
+	alignas(PLATFORM_CACHE_LINE_SIZE) TAtomic<uint32> Head;
+	alignas(PLATFORM_CACHE_LINE_SIZE) TAtomic<uint32> Tail;
+	alignas(PLATFORM_CACHE_LINE_SIZE) EJoyConRingOverflow Policy;
+	TAtomic<uint32> HighWaterMark;
+	TAtomic<uint64> Overflows;
+	alignas(PLATFORM_CACHE_LINE_SIZE) ElementType Slots[Capacity];
+};
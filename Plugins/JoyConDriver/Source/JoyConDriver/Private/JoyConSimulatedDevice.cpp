@@ -0,0 +1,238 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConSimulatedDevice.h"
+
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+
+// The device timer in report byte 1 ticks every 5 ms, once per IMU sample
+static constexpr double DeviceTimerPeriod = 0.005;
+// Like the kernel hidraw buffer, reports that are not read in time are discarded
+static constexpr int32 MaxQueuedReports = 64;
+// Granularity of blocking reads while waiting for subcommand replies
+static constexpr float IdleSleepSeconds = 0.002f;
+
+static void PackStick(uint8* Out, const uint16 X, const uint16 Y) {
+	Out[0] = static_cast<uint8>(X & 0xff);
+	Out[1] = static_cast<uint8>(((X >> 8) & 0xf) | ((Y & 0xf) << 4));
+	Out[2] = static_cast<uint8>(Y >> 4);
+}
+
+static void PackInt16(uint8* Out, const int16 Value) {
+	Out[0] = static_cast<uint8>(Value & 0xff);
+	Out[1] = static_cast<uint8>((Value >> 8) & 0xff);
+}
+
+FJoyConSimulatedDevice::FJoyConSimulatedDevice(const FJoyConSimulatedDeviceSettings& InSettings) :
+	Settings(InSettings),
+	Random(InSettings.RandomSeed),
+	LastReport{},
+	bRepeatLastReport(false),
+	InputMode(0x3f),
+	PlayerLights(0),
+	bImuEnabled(false),
+	bVibrationEnabled(false) {
+	Flash = Settings.FlashImage.Num() > 0 ? Settings.FlashImage : DefaultFlashImage(Settings.bIsLeft);
+	if (Flash.Num() < static_cast<int32>(FlashSize)) {
+		const int32 OldSize = Flash.Num();
+		Flash.SetNumUninitialized(FlashSize);
+		FMemory::Memset(Flash.GetData() + OldSize, 0xff, FlashSize - OldSize);
+	}
+	if (Settings.ReportRateHz <= 0.0f) Settings.ReportRateHz = 66.67f;
+	StartTime = FPlatformTime::Seconds();
+	NextReportTime = StartTime;
+	NextReportJitter = 0.0;
+}
+
+int32 FJoyConSimulatedDevice::Read(uint8* Data, const size_t Length, const int32 Milliseconds) {
+	const double Period = 1.0 / Settings.ReportRateHz;
+	const double Deadline = Milliseconds < 0 ? TNumericLimits<double>::Max() : FPlatformTime::Seconds() + Milliseconds / 1000.0;
+	const int32 CopyLen = static_cast<int32>(FMath::Min<size_t>(Length, ReportLen));
+
+	for (;;) {
+		double WakeTime;
+		{
+			FScopeLock Lock(&Mutex);
+			if (PopPending(Data, Length)) return CopyLen;
+
+			const double Now = FPlatformTime::Seconds();
+			if (InputMode == 0x30) {
+				if (bRepeatLastReport) {
+					bRepeatLastReport = false;
+					FMemory::Memcpy(Data, LastReport.Data, CopyLen);
+					return CopyLen;
+				}
+				if (Now - NextReportTime > MaxQueuedReports * Period) {
+					NextReportTime = Now - MaxQueuedReports * Period;
+				}
+				while (Now >= NextReportTime + NextReportJitter) {
+					const double ReportTime = NextReportTime;
+					NextReportTime += Period;
+					// Jitter delays delivery of a report without moving its device timestamp
+					NextReportJitter = Settings.JitterMs > 0.0f ? Random.GetFraction() * Settings.JitterMs / 1000.0 : 0.0;
+					if (Settings.LossProbability > 0.0f && Random.GetFraction() < Settings.LossProbability) continue;
+
+					FPendingReport& Report = LastReport;
+					FMemory::Memzero(Report.Data, ReportLen);
+					Report.Data[0] = 0x30;
+					Report.Data[1] = DeviceTimer(ReportTime);
+					WriteStandardHeader(Report.Data);
+					if (bImuEnabled) WriteImuSamples(Report.Data, ReportTime);
+
+					if (Settings.DuplicateProbability > 0.0f && Random.GetFraction() < Settings.DuplicateProbability) {
+						bRepeatLastReport = true;
+					}
+					FMemory::Memcpy(Data, Report.Data, CopyLen);
+					return CopyLen;
+				}
+				WakeTime = FMath::Min(NextReportTime + NextReportJitter, Deadline);
+			} else {
+				WakeTime = FMath::Min(Now + IdleSleepSeconds, Deadline);
+			}
+			if (Milliseconds == 0 || Now >= Deadline) return 0;
+		}
+		const double SleepTime = WakeTime - FPlatformTime::Seconds();
+		if (SleepTime > 0.0) FPlatformProcess::Sleep(static_cast<float>(SleepTime));
+	}
+}
+
+int32 FJoyConSimulatedDevice::Write(const uint8* Data, const size_t Length) {
+	if (Data == nullptr || Length == 0) return -1;
+	// 0x01 carries rumble and a subcommand, 0x10 only rumble which needs no reply
+	if (Data[0] == 0x01 && Length >= 11) {
+		FScopeLock Lock(&Mutex);
+		HandleSubCommand(Data, Length);
+	}
+	return static_cast<int32>(Length);
+}
+
+intptr_t FJoyConSimulatedDevice::GetPollHandle() {
+	return -1;
+}
+
+TArray<uint8> FJoyConSimulatedDevice::DefaultFlashImage(const bool bIsLeft) {
+	TArray<uint8> Image;
+	Image.Init(0xff, FlashSize);
+
+	// Factory IMU calibration: accelerometer origin and sensitivity, gyroscope origin and sensitivity
+	const int16 ImuCalibration[12] = { 0, 0, 0, 0x4000, 0x4000, 0x4000, 12, -7, 4, 0x343b, 0x343b, 0x343b };
+	for (int32 i = 0; i < 12; ++i) {
+		PackInt16(&Image[0x6020 + i * 2], ImuCalibration[i]);
+	}
+
+	// Factory stick calibration, the left stick stores max/center/min and the right one center/min/max
+	const uint16 Center = 0x800;
+	const uint16 Range = 0x5a0;
+	if (bIsLeft) {
+		PackStick(&Image[0x603d], Range, Range);
+		PackStick(&Image[0x6040], Center, Center);
+		PackStick(&Image[0x6043], Range, Range);
+	} else {
+		PackStick(&Image[0x6046], Center, Center);
+		PackStick(&Image[0x6049], Range, Range);
+		PackStick(&Image[0x604c], Range, Range);
+	}
+
+	// Stick parameters as found on retail units, bytes 3 and 4 hold the dead zone
+	const uint8 StickParameters[18] = { 0x0f, 0x30, 0x61, 0xae, 0x90, 0xd9, 0xd4, 0x14, 0x54, 0x41, 0x15, 0x54, 0xc7, 0x79, 0x9c, 0x33, 0x36, 0x63 };
+	FMemory::Memcpy(&Image[0x6086], StickParameters, sizeof(StickParameters));
+	FMemory::Memcpy(&Image[0x6098], StickParameters, sizeof(StickParameters));
+	return Image;
+}
+
+void FJoyConSimulatedDevice::HandleSubCommand(const uint8* Data, const size_t Length) {
+	const uint8 SubCommand = Data[10];
+	const uint8* Args = Data + 11;
+	const size_t ArgsLen = Length - 11;
+
+	FPendingReport Reply;
+	FMemory::Memzero(Reply.Data, ReportLen);
+	Reply.Data[0] = 0x21;
+	Reply.Data[1] = DeviceTimer(FPlatformTime::Seconds());
+	WriteStandardHeader(Reply.Data);
+	Reply.Data[13] = 0x80;
+	Reply.Data[14] = SubCommand;
+
+	switch (SubCommand) {
+	case 0x01:
+		// Bluetooth manual pairing, reply with the pairing step that was requested
+		Reply.Data[13] = 0x81;
+		Reply.Data[15] = ArgsLen > 0 ? Args[0] : 0;
+		break;
+	case 0x03:
+		if (ArgsLen > 0) InputMode = Args[0];
+		if (InputMode == 0x30) NextReportTime = FPlatformTime::Seconds();
+		break;
+	case 0x10: {
+		// SPI flash read: 4 byte little endian address followed by the length
+		Reply.Data[13] = 0x90;
+		if (ArgsLen < 5) break;
+		const uint32 Address = Args[0] | (Args[1] << 8) | (Args[2] << 16) | (Args[3] << 24);
+		const uint32 Len = FMath::Min<uint32>(Args[4], 0x1d);
+		FMemory::Memcpy(&Reply.Data[15], Args, 5);
+		for (uint32 i = 0; i < Len; ++i) {
+			const uint32 Offset = Address + i;
+			Reply.Data[20 + i] = Offset < FlashSize ? Flash[Offset] : 0xff;
+		}
+		break;
+	}
+	case 0x30:
+		if (ArgsLen > 0) PlayerLights = Args[0];
+		break;
+	case 0x40:
+		if (ArgsLen > 0) bImuEnabled = Args[0] != 0;
+		break;
+	case 0x48:
+		if (ArgsLen > 0) bVibrationEnabled = Args[0] != 0;
+		break;
+	default:
+		break;
+	}
+	PendingReplies.Add(Reply);
+}
+
+void FJoyConSimulatedDevice::WriteStandardHeader(uint8* Report) {
+	// Battery full and charging, connection info Joy-Con
+	Report[2] = 0x8e;
+	Report[3] = 0x00;
+	Report[4] = 0x00;
+	Report[5] = 0x00;
+	PackStick(&Report[6], 0x800, 0x800);
+	PackStick(&Report[9], 0x800, 0x800);
+	Report[12] = bVibrationEnabled ? 0x0c : 0x00;
+}
+
+void FJoyConSimulatedDevice::WriteImuSamples(uint8* Report, const double Time) const {
+	// Joy-Con lying flat and slowly rocking around its vertical axis, oldest sample first
+	static constexpr float GyroRadiansPerCount = 0.00122187695f;
+	static constexpr float AmplitudeRadians = 0.5f;
+	static constexpr float FrequencyHz = 0.5f;
+	int16 GyroOrigin[3];
+	for (int32 i = 0; i < 3; ++i) {
+		GyroOrigin[i] = static_cast<int16>(Flash[0x602c + i * 2] | (Flash[0x602d + i * 2] << 8));
+	}
+	for (int32 n = 0; n < 3; ++n) {
+		const double SampleTime = Time - (2 - n) * DeviceTimerPeriod - StartTime;
+		const float Rate = AmplitudeRadians * FMath::Sin(2.0f * PI * FrequencyHz * static_cast<float>(SampleTime));
+		uint8* Sample = &Report[13 + n * 12];
+		PackInt16(&Sample[0], 0);
+		PackInt16(&Sample[2], 0);
+		PackInt16(&Sample[4], 4096);
+		PackInt16(&Sample[6], GyroOrigin[0]);
+		PackInt16(&Sample[8], GyroOrigin[1]);
+		PackInt16(&Sample[10], static_cast<int16>(GyroOrigin[2] + FMath::RoundToInt(Rate / GyroRadiansPerCount)));
+	}
+}
+
+bool FJoyConSimulatedDevice::PopPending(uint8* Data, const size_t Length) {
+	if (PendingReplies.Num() == 0) return false;
+	FMemory::Memcpy(Data, PendingReplies[0].Data, FMath::Min<size_t>(Length, ReportLen));
+	PendingReplies.RemoveAt(0, 1, false);
+	return true;
+}
+
+uint8 FJoyConSimulatedDevice::DeviceTimer(const double Time) const {
+	return static_cast<uint8>(static_cast<int64>((Time - StartTime) / DeviceTimerPeriod) & 0xff);
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JoyConDevice.h"
+#include "Math/RandomStream.h"
+
+struct FJoyConSimulatedDeviceSettings {
+	bool bIsLeft;
+
+	/** Rate of the 0x30 full input reports, a real Joy-Con sends one every ~15 ms */
+	float ReportRateHz;
+
+	/** Probability of a report never being delivered */
+	float LossProbability;
+
+	/** Probability of a report being delivered twice */
+	float DuplicateProbability;
+
+	/** Maximum random delay added to each report, in milliseconds */
+	float JitterMs;
+
+	int32 RandomSeed;
+
+	/** SPI flash contents served by subcommand 0x10, left empty to use DefaultFlashImage() */
+	TArray<uint8> FlashImage;
+
+	FJoyConSimulatedDeviceSettings() :
+		bIsLeft(true),
+		ReportRateHz(66.67f),
+		LossProbability(0.0f),
+		DuplicateProbability(0.0f),
+		JitterMs(0.0f),
+		RandomSeed(0) {
+	}
+};
+
+/**
+ * In-process Joy-Con that implements the hidapi contract without any hardware. It answers the subcommands used by
+ * FJoyConController (input mode, pairing, player lights, IMU, vibration and SPI flash reads) with 0x21 replies and,
+ * once switched to mode 0x30, streams full input reports with a 5 ms device timer and three IMU samples each.
+ * Reports are generated lazily when read, so any number of simulated devices can run without extra threads.
+ */
+class FJoyConSimulatedDevice : public IJoyConDevice {
+
+public:
+	explicit FJoyConSimulatedDevice(const FJoyConSimulatedDeviceSettings& InSettings);
+
+	virtual int32 Read(uint8* Data, size_t Length, int32 Milliseconds) override;
+	virtual int32 Write(const uint8* Data, size_t Length) override;
+	virtual intptr_t GetPollHandle() override;
+
+	/** Size of the SPI flash address space that is simulated (covers factory and user calibration) */
+	static constexpr uint32 FlashSize = 0x10000;
+
+	/** Flash image with blank user calibration and plausible factory stick and IMU calibration */
+	static TArray<uint8> DefaultFlashImage(bool bIsLeft);
+
+	static const uint32 ReportLen = 49;
+
+private:
+	struct FPendingReport {
+		uint8 Data[ReportLen];
+	};
+
+	void HandleSubCommand(const uint8* Data, size_t Length);
+	void WriteStandardHeader(uint8* Report);
+	void WriteImuSamples(uint8* Report, double Time) const;
+	bool PopPending(uint8* Data, size_t Length);
+	uint8 DeviceTimer(double Time) const;
+
+private:
+	FJoyConSimulatedDeviceSettings Settings;
+	FRandomStream Random;
+	FCriticalSection Mutex;
+
+	TArray<FPendingReport> PendingReplies;
+	TArray<uint8> Flash;
+
+	double StartTime;
+	double NextReportTime;
+	double NextReportJitter;
+	FPendingReport LastReport;
+	bool bRepeatLastReport;
+
+	uint8 InputMode;
+	uint8 PlayerLights;
+	bool bImuEnabled;
+	bool bVibrationEnabled;
+};
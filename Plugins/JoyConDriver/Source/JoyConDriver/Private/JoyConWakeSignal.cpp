@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "JoyConWakeSignal.h"
+
+#if PLATFORM_LINUX
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+FJoyConWakeSignal::FJoyConWakeSignal() {
+#if PLATFORM_LINUX
+	Fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif PLATFORM_WINDOWS
+	Event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+#endif
+}
+
+FJoyConWakeSignal::~FJoyConWakeSignal() {
+#if PLATFORM_LINUX
+	if (Fd >= 0) close(Fd);
+#elif PLATFORM_WINDOWS
+	if (Event != nullptr) CloseHandle(Event);
+#endif
+}
+
+intptr_t FJoyConWakeSignal::GetWaitHandle() const {
+#if PLATFORM_LINUX
+	return Fd >= 0 ? Fd : -1;
+#elif PLATFORM_WINDOWS
+	return Event != nullptr ? reinterpret_cast<intptr_t>(Event) : -1;
+#else
+	return -1;
+#endif
+}
+
+void FJoyConWakeSignal::Trigger() const {
+#if PLATFORM_LINUX
+	if (Fd < 0) return;
+	const uint64 Value = 1;
+	// EAGAIN only means the counter is saturated, the waiting thread is woken up anyway then
+	if (write(Fd, &Value, sizeof(Value)) < 0 && errno != EAGAIN) {
+		UE_LOG(LogTemp, Warning, TEXT("Failed to wake JoyCon thread (%d)."), errno);
+	}
+#elif PLATFORM_WINDOWS
+	if (Event != nullptr) SetEvent(Event);
+#endif
+}
+
+void FJoyConWakeSignal::Drain() const {
+#if PLATFORM_LINUX
+	if (Fd < 0) return;
+	uint64 Value;
+	while (read(Fd, &Value, sizeof(Value)) > 0) {}
+#endif
+}
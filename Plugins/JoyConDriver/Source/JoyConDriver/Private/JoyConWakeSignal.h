@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Wakes a thread blocked waiting on device handles, an eventfd on Linux and an auto-reset event on Windows. Shared by
+ * FJoyConReactor and FJoyConDeviceMonitor, which add GetWaitHandle() to the handles they wait on.
+ */
+class FJoyConWakeSignal {
+
+public:
+	FJoyConWakeSignal();
+	~FJoyConWakeSignal();
+
+	FJoyConWakeSignal(const FJoyConWakeSignal&) = delete;
+	FJoyConWakeSignal& operator=(const FJoyConWakeSignal&) = delete;
+
+	bool IsValid() const { return GetWaitHandle() != -1; }
+
+	/** The eventfd or event HANDLE, -1 on platforms without one */
+	intptr_t GetWaitHandle() const;
+
+	/** Makes the wait handle signaled until Drain() */
+	void Trigger() const;
+
+	/** Resets the signal after the waiting thread woke up, the Windows event resets itself */
+	void Drain() const;
+
+private:
+#if PLATFORM_LINUX
+	int Fd;
+#elif PLATFORM_WINDOWS
+	void* Event;
+#endif
+};
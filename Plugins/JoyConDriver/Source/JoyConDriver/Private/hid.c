@@ -19,6 +19,8 @@
  code repository located at:
         http://github.com/signal11/hidapi .
 ********************************************************/
+#ifdef _WIN32
+
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
@@ -140,6 +142,7 @@ struct hid_device_ {
 		DWORD last_error_num;
 		BOOL read_pending;
 		char *read_buf;
+		unsigned char *write_buf;
 		OVERLAPPED ol;
 };
 
@@ -154,8 +157,12 @@ static hid_device *new_hid_device()
 	dev->last_error_num = 0;
 	dev->read_pending = FALSE;
 	dev->read_buf = NULL;
+	dev->write_buf = NULL;
 	memset(&dev->ol, 0, sizeof(dev->ol));
-	dev->ol.hEvent = CreateEvent(NULL, FALSE, FALSE /*initial state f=nonsignaled*/, NULL);
+	/* Manual reset, so the event stays signaled after a wait in
+	   hid_get_poll_handle() users until the report is collected. It is
+	   reset explicitly before every ReadFile(). */
+	dev->ol.hEvent = CreateEvent(NULL, TRUE, FALSE /*initial state f=nonsignaled*/, NULL);
 
 	return dev;
 }
@@ -166,6 +173,7 @@ static void free_hid_device(hid_device *dev)
 	CloseHandle(dev->device_handle);
 	LocalFree(dev->last_error_str);
 	free(dev->read_buf);
+	free(dev->write_buf);
 	free(dev);
 }
 
@@ -611,6 +619,7 @@ HID_API_EXPORT hid_device * HID_API_CALL hid_open_path(const char *path)
 	HidD_FreePreparsedData(pp_data);
 
 	dev->read_buf = (char*) malloc(dev->input_report_length);
+	dev->write_buf = (unsigned char*) malloc(dev->output_report_length);
 
 	return dev;
 
@@ -635,14 +644,15 @@ int HID_API_EXPORT HID_API_CALL hid_write(hid_device *dev, const unsigned char *
 	   one for the report number) bytes even if the data is a report
 	   which is shorter than that. Windows gives us this value in
 	   caps.OutputReportByteLength. If a user passes in fewer bytes than this,
-	   create a temporary buffer which is the proper size. */
+	   pad the data into the write buffer allocated when the device was
+	   opened instead of allocating a temporary one on every call. */
 	if (length >= dev->output_report_length) {
 		/* The user passed the right number of bytes. Use the buffer as-is. */
 		buf = (unsigned char *) data;
 	} else {
-		/* Create a temporary buffer and copy the user's data
-		   into it, padding the rest with zeros. */
-		buf = (unsigned char *) malloc(dev->output_report_length);
+		/* Copy the user's data into the write buffer,
+		   padding the rest with zeros. */
+		buf = dev->write_buf;
 		memcpy(buf, data, length);
 		memset(buf + length, 0, dev->output_report_length - length);
 		length = dev->output_report_length;
@@ -670,9 +680,6 @@ int HID_API_EXPORT HID_API_CALL hid_write(hid_device *dev, const unsigned char *
 	}
 
 end_of_function:
-	if (buf != data)
-		free(buf);
-
 	return bytes_written;
 }
 
@@ -748,6 +755,29 @@ end_of_function:
 	return copy_len;
 }
 
+intptr_t HID_API_EXPORT HID_API_CALL hid_get_poll_handle(hid_device *dev)
+{
+	DWORD bytes_read = 0;
+	BOOL res;
+
+	if (!dev->read_pending) {
+		/* Arm an Overlapped I/O read so the event gets signaled when
+		   the next report arrives. hid_read_timeout() picks it up. */
+		dev->read_pending = TRUE;
+		memset(dev->read_buf, 0, dev->input_report_length);
+		ResetEvent(dev->ol.hEvent);
+		res = ReadFile(dev->device_handle, dev->read_buf, dev->input_report_length, &bytes_read, &dev->ol);
+		if (!res && GetLastError() != ERROR_IO_PENDING) {
+			CancelIo(dev->device_handle);
+			dev->read_pending = FALSE;
+			register_error(dev, "ReadFile");
+			return -1;
+		}
+	}
+
+	return (intptr_t) dev->ol.hEvent;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length)
 {
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
@@ -955,3 +985,5 @@ int __cdecl main(int argc, char* argv[])
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
+
+#endif /* _WIN32 */
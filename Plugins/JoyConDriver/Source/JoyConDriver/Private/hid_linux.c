@@ -0,0 +1,579 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ Linux hidraw backend.
+
+ Enumeration is done by walking /sys/class/hidraw instead of going
+ through libudev, so the plugin does not pick up an extra runtime
+ dependency. Devices are always opened with O_NONBLOCK and every
+ blocking or timed read is implemented with poll(), which means the
+ same code path also works for any file descriptor that behaves like
+ a hidraw node (pty, FIFO, socketpair...), see hid_open_fd().
+********************************************************/
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <linux/hidraw.h>
+
+#include "hidapi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HIDRAW_SYSFS_CLASS "/sys/class/hidraw"
+#define UEVENT_MAX_LEN 4096
+
+struct hid_device_ {
+	int device_handle;
+	int blocking;
+	wchar_t *last_error_str;
+};
+
+static hid_device *new_hid_device(void)
+{
+	hid_device *dev = (hid_device*) calloc(1, sizeof(hid_device));
+	if (!dev)
+		return NULL;
+	dev->device_handle = -1;
+	dev->blocking = 1;
+	dev->last_error_str = NULL;
+	return dev;
+}
+
+static void free_hid_device(hid_device *dev)
+{
+	free(dev->last_error_str);
+	free(dev);
+}
+
+/* Decode a UTF-8 string into a newly allocated wide string. This is
+   done by hand rather than with mbstowcs() so we don't have to call
+   setlocale() inside the host process. */
+static wchar_t *utf8_to_wchar(const char *utf8)
+{
+	const unsigned char *s = (const unsigned char*) utf8;
+	size_t len = strlen(utf8);
+	wchar_t *ret = (wchar_t*) calloc(len + 1, sizeof(wchar_t));
+	size_t i = 0;
+
+	if (!ret)
+		return NULL;
+
+	while (*s) {
+		unsigned int c = *s++;
+		int extra = 0;
+		if (c >= 0xf0) { c &= 0x07; extra = 3; }
+		else if (c >= 0xe0) { c &= 0x0f; extra = 2; }
+		else if (c >= 0xc0) { c &= 0x1f; extra = 1; }
+		while (extra-- > 0 && (*s & 0xc0) == 0x80)
+			c = (c << 6) | (*s++ & 0x3f);
+		ret[i++] = (wchar_t) c;
+	}
+	ret[i] = 0;
+	return ret;
+}
+
+static void register_error(hid_device *dev, const char *op)
+{
+	char msg[256];
+
+	if (!dev)
+		return;
+	snprintf(msg, sizeof(msg), "%s: %s", op, strerror(errno));
+	free(dev->last_error_str);
+	dev->last_error_str = utf8_to_wchar(msg);
+}
+
+/* Read a whole sysfs attribute into buf. Returns the number of bytes
+   read or -1 on error. */
+static ssize_t read_sysfs_file(const char *path, char *buf, size_t size)
+{
+	ssize_t res;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	res = read(fd, buf, size - 1);
+	close(fd);
+	if (res < 0)
+		return -1;
+	buf[res] = '\0';
+	return res;
+}
+
+/* Find KEY=value in the contents of a uevent file and copy value into
+   out. Returns 0 on success and -1 if the key is not present. */
+static int uevent_value(const char *uevent, const char *key, char *out, size_t out_len)
+{
+	size_t key_len = strlen(key);
+	const char *line = uevent;
+
+	while (line && *line) {
+		const char *end = strchr(line, '\n');
+		size_t line_len = end ? (size_t)(end - line) : strlen(line);
+		if (line_len > key_len && strncmp(line, key, key_len) == 0 && line[key_len] == '=') {
+			size_t value_len = line_len - key_len - 1;
+			if (value_len >= out_len)
+				value_len = out_len - 1;
+			memcpy(out, line + key_len + 1, value_len);
+			out[value_len] = '\0';
+			return 0;
+		}
+		line = end ? end + 1 : NULL;
+	}
+	return -1;
+}
+
+/* HID_ID has the form "bus:vendor:product", all in hex. */
+static int parse_hid_id(const char *uevent, unsigned *bus_type, unsigned short *vendor_id, unsigned short *product_id)
+{
+	char value[64];
+	unsigned int bus, vendor, product;
+
+	if (uevent_value(uevent, "HID_ID", value, sizeof(value)) < 0)
+		return -1;
+	if (sscanf(value, "%x:%x:%x", &bus, &vendor, &product) != 3)
+		return -1;
+	*bus_type = bus;
+	*vendor_id = (unsigned short) vendor;
+	*product_id = (unsigned short) product;
+	return 0;
+}
+
+/* Walk the report descriptor and return the first top level Usage Page
+   and Usage, which is what the Windows backend reports from HidP_GetCaps. */
+static void parse_usage(const unsigned char *desc, size_t size, unsigned short *usage_page, unsigned short *usage)
+{
+	size_t i = 0;
+	int found_page = 0, found_usage = 0;
+
+	while (i < size && !(found_page && found_usage)) {
+		unsigned char key = desc[i];
+		size_t data_len, key_size;
+		unsigned int value = 0;
+		size_t j;
+
+		if ((key & 0xf0) == 0xf0) {
+			/* Long item, skip it. */
+			data_len = (i + 1 < size) ? desc[i + 1] : 0;
+			key_size = 3;
+			i += data_len + key_size;
+			continue;
+		}
+
+		data_len = key & 0x3;
+		if (data_len == 3)
+			data_len = 4;
+		key_size = 1;
+		if (i + key_size + data_len > size)
+			break;
+		for (j = 0; j < data_len; j++)
+			value |= (unsigned int) desc[i + key_size + j] << (8 * j);
+
+		switch (key & 0xfc) {
+		case 0x04: /* Usage Page */
+			if (!found_page) {
+				*usage_page = (unsigned short) value;
+				found_page = 1;
+			}
+			break;
+		case 0x08: /* Usage */
+			if (!found_usage) {
+				*usage = (unsigned short) value;
+				found_usage = 1;
+			}
+			break;
+		default:
+			break;
+		}
+		i += data_len + key_size;
+	}
+}
+
+/* Fill in the device strings and ids of info from the sysfs entry of
+   the hidraw node called name. Returns 0 on success. */
+static int read_device_info(const char *name, unsigned short vendor_id, unsigned short product_id, struct hid_device_info *info)
+{
+	char path[512];
+	char uevent[UEVENT_MAX_LEN];
+	char value[256];
+	unsigned char desc[HID_MAX_DESCRIPTOR_SIZE];
+	unsigned bus_type;
+	ssize_t desc_size;
+
+	snprintf(path, sizeof(path), HIDRAW_SYSFS_CLASS "/%s/device/uevent", name);
+	if (read_sysfs_file(path, uevent, sizeof(uevent)) < 0)
+		return -1;
+	if (parse_hid_id(uevent, &bus_type, &info->vendor_id, &info->product_id) < 0)
+		return -1;
+	if ((vendor_id != 0x0 && info->vendor_id != vendor_id) ||
+	    (product_id != 0x0 && info->product_id != product_id))
+		return -1;
+
+	snprintf(path, sizeof(path), "/dev/%s", name);
+	info->path = strdup(path);
+
+	/* HID_UNIQ holds the serial number on USB and the controller's
+	   MAC address on Bluetooth, which is what Windows reports too. */
+	if (uevent_value(uevent, "HID_UNIQ", value, sizeof(value)) < 0)
+		value[0] = '\0';
+	info->serial_number = utf8_to_wchar(value);
+
+	/* The kernel only exposes a single name for the device. Windows
+	   reports "Nintendo" as the manufacturer for every Joy-Con, so
+	   keep the manufacturer empty rather than guessing. */
+	if (uevent_value(uevent, "HID_NAME", value, sizeof(value)) < 0)
+		value[0] = '\0';
+	info->product_string = utf8_to_wchar(value);
+	info->manufacturer_string = utf8_to_wchar("");
+
+	info->release_number = 0;
+	info->interface_number = -1;
+
+	snprintf(path, sizeof(path), HIDRAW_SYSFS_CLASS "/%s/device/report_descriptor", name);
+	desc_size = read_sysfs_file(path, (char*) desc, sizeof(desc));
+	if (desc_size > 0)
+		parse_usage(desc, (size_t) desc_size, &info->usage_page, &info->usage);
+
+	return 0;
+}
+
+/* Locate the sysfs uevent file of an open hidraw descriptor. */
+static int device_uevent(hid_device *dev, char *uevent, size_t size)
+{
+	struct stat st;
+	char path[128];
+
+	if (fstat(dev->device_handle, &st) < 0 || !S_ISCHR(st.st_mode))
+		return -1;
+	snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/device/uevent", major(st.st_rdev), minor(st.st_rdev));
+	return read_sysfs_file(path, uevent, size) < 0 ? -1 : 0;
+}
+
+static int copy_uevent_string(hid_device *dev, const char *key, wchar_t *string, size_t maxlen)
+{
+	char uevent[UEVENT_MAX_LEN];
+	char value[256];
+	wchar_t *wide;
+
+	if (maxlen == 0)
+		return -1;
+	if (device_uevent(dev, uevent, sizeof(uevent)) < 0) {
+		register_error(dev, "device_uevent");
+		return -1;
+	}
+	if (uevent_value(uevent, key, value, sizeof(value)) < 0)
+		return -1;
+	wide = utf8_to_wchar(value);
+	if (!wide)
+		return -1;
+	wcsncpy(string, wide, maxlen);
+	string[maxlen - 1] = 0;
+	free(wide);
+	return 0;
+}
+
+int HID_API_EXPORT hid_init(void)
+{
+	return 0;
+}
+
+int HID_API_EXPORT hid_exit(void)
+{
+	return 0;
+}
+
+struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_device_info *root = NULL;
+	struct hid_device_info *cur_dev = NULL;
+	struct dirent *entry;
+	DIR *dir;
+
+	dir = opendir(HIDRAW_SYSFS_CLASS);
+	if (!dir)
+		return NULL;
+
+	while ((entry = readdir(dir)) != NULL) {
+		struct hid_device_info *tmp;
+
+		if (strncmp(entry->d_name, "hidraw", 6) != 0)
+			continue;
+
+		tmp = (struct hid_device_info*) calloc(1, sizeof(struct hid_device_info));
+		if (!tmp)
+			break;
+		if (read_device_info(entry->d_name, vendor_id, product_id, tmp) < 0) {
+			hid_free_enumeration(tmp);
+			continue;
+		}
+
+		if (cur_dev)
+			cur_dev->next = tmp;
+		else
+			root = tmp;
+		cur_dev = tmp;
+	}
+
+	closedir(dir);
+	return root;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_free_enumeration(struct hid_device_info *devs)
+{
+	struct hid_device_info *d = devs;
+	while (d) {
+		struct hid_device_info *next = d->next;
+		free(d->path);
+		free(d->serial_number);
+		free(d->manufacturer_string);
+		free(d->product_string);
+		free(d);
+		d = next;
+	}
+}
+
+HID_API_EXPORT hid_device * HID_API_CALL hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+{
+	struct hid_device_info *devs, *cur_dev;
+	const char *path_to_open = NULL;
+	hid_device *handle = NULL;
+
+	devs = hid_enumerate(vendor_id, product_id);
+	cur_dev = devs;
+	while (cur_dev) {
+		if (cur_dev->vendor_id == vendor_id &&
+		    cur_dev->product_id == product_id) {
+			if (serial_number) {
+				if (cur_dev->serial_number && wcscmp(serial_number, cur_dev->serial_number) == 0) {
+					path_to_open = cur_dev->path;
+					break;
+				}
+			}
+			else {
+				path_to_open = cur_dev->path;
+				break;
+			}
+		}
+		cur_dev = cur_dev->next;
+	}
+
+	if (path_to_open)
+		handle = hid_open_path(path_to_open);
+
+	hid_free_enumeration(devs);
+	return handle;
+}
+
+HID_API_EXPORT hid_device * HID_API_CALL hid_open_path(const char *path)
+{
+	int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	return hid_open_fd(fd);
+}
+
+HID_API_EXPORT hid_device * HID_API_CALL hid_open_fd(int fd)
+{
+	hid_device *dev;
+	int flags;
+
+	if (fd < 0)
+		return NULL;
+
+	/* The descriptor stays non-blocking for its whole life, blocking
+	   semantics are provided by poll() in hid_read_timeout(). */
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	dev = new_hid_device();
+	if (!dev) {
+		close(fd);
+		return NULL;
+	}
+	dev->device_handle = fd;
+	return dev;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_write(hid_device *dev, const unsigned char *data, size_t length)
+{
+	/* hidraw takes the report as-is, report ID first, so unlike the
+	   Windows backend there is no need to pad it to the longest output
+	   report. */
+	for (;;) {
+		ssize_t res = write(dev->device_handle, data, length);
+		if (res >= 0)
+			return (int) res;
+
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			/* hid_write() is synchronous, wait until the output
+			   queue has room for the report. */
+			struct pollfd fds;
+			fds.fd = dev->device_handle;
+			fds.events = POLLOUT;
+			fds.revents = 0;
+			if (poll(&fds, 1, -1) < 0 && errno != EINTR) {
+				register_error(dev, "poll");
+				return -1;
+			}
+			if (fds.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				errno = EIO;
+				register_error(dev, "write");
+				return -1;
+			}
+			continue;
+		}
+
+		register_error(dev, "write");
+		return -1;
+	}
+}
+
+int HID_API_EXPORT HID_API_CALL hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	ssize_t bytes_read;
+
+	if (milliseconds != 0) {
+		struct pollfd fds;
+		int res;
+
+		fds.fd = dev->device_handle;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		do {
+			res = poll(&fds, 1, milliseconds);
+		} while (res < 0 && errno == EINTR);
+
+		if (res < 0) {
+			register_error(dev, "poll");
+			return -1;
+		}
+		if (res == 0) {
+			/* Timeout. */
+			return 0;
+		}
+		if (fds.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			/* The device has been unplugged or the descriptor
+			   was closed under us. */
+			if (!(fds.revents & POLLIN)) {
+				errno = ENODEV;
+				register_error(dev, "poll");
+				return -1;
+			}
+		}
+	}
+
+	bytes_read = read(dev->device_handle, data, length);
+	if (bytes_read < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == EINPROGRESS)
+			return 0;
+		register_error(dev, "read");
+		return -1;
+	}
+	if (bytes_read == 0 && length > 0) {
+		/* hidraw never delivers empty reports, end of file means the
+		   other side hung up (a stand-in descriptor, see hid_open_fd()). */
+		errno = ENODEV;
+		register_error(dev, "read");
+		return -1;
+	}
+	return (int) bytes_read;
+}
+
+intptr_t HID_API_EXPORT HID_API_CALL hid_get_poll_handle(hid_device *dev)
+{
+	return dev->device_handle;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length)
+{
+	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
+}
+
+int HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonblock)
+{
+	dev->blocking = !nonblock;
+	return 0; /* Success */
+}
+
+int HID_API_EXPORT HID_API_CALL hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
+{
+	int res = ioctl(dev->device_handle, HIDIOCSFEATURE(length), data);
+	if (res < 0)
+		register_error(dev, "ioctl (SFEATURE)");
+	return res;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_get_feature_report(hid_device *dev, unsigned char *data, size_t length)
+{
+	int res = ioctl(dev->device_handle, HIDIOCGFEATURE(length), data);
+	if (res < 0)
+		register_error(dev, "ioctl (GFEATURE)");
+	return res;
+}
+
+void HID_API_EXPORT HID_API_CALL hid_close(hid_device *dev)
+{
+	if (!dev)
+		return;
+	close(dev->device_handle);
+	free_hid_device(dev);
+}
+
+int HID_API_EXPORT_CALL HID_API_CALL hid_get_manufacturer_string(hid_device *dev, wchar_t *string, size_t maxlen)
+{
+	(void) dev;
+	if (maxlen == 0)
+		return -1;
+	string[0] = 0;
+	return 0;
+}
+
+int HID_API_EXPORT_CALL HID_API_CALL hid_get_product_string(hid_device *dev, wchar_t *string, size_t maxlen)
+{
+	return copy_uevent_string(dev, "HID_NAME", string, maxlen);
+}
+
+int HID_API_EXPORT_CALL HID_API_CALL hid_get_serial_number_string(hid_device *dev, wchar_t *string, size_t maxlen)
+{
+	return copy_uevent_string(dev, "HID_UNIQ", string, maxlen);
+}
+
+int HID_API_EXPORT_CALL HID_API_CALL hid_get_indexed_string(hid_device *dev, int string_index, wchar_t *string, size_t maxlen)
+{
+	/* hidraw gives no access to the USB string descriptors. */
+	(void) dev;
+	(void) string_index;
+	(void) string;
+	(void) maxlen;
+	return -1;
+}
+
+HID_API_EXPORT const wchar_t * HID_API_CALL hid_error(hid_device *dev)
+{
+	return dev->last_error_str;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __linux__ */
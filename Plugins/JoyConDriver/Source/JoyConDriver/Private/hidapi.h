@@ -27,6 +27,7 @@
 #ifndef HIDAPI_H__
 #define HIDAPI_H__
 
+#include <stdint.h>
 #include <wchar.h>
 
 #ifdef _WIN32
@@ -178,6 +179,25 @@ extern "C" {
 		*/
 		HID_API_EXPORT hid_device * HID_API_CALL hid_open_path(const char *path);
 
+#if defined(__linux__)
+		/** @brief Open a HID device from an already open file descriptor.
+
+			Linux only. Any descriptor that delivers one report per
+			read() and accepts one report per write() can be used, which
+			allows a pty or one end of a socketpair to stand in for a
+			/dev/hidraw node. The descriptor is switched to non-blocking
+			mode and is owned by the returned device, hid_close() closes it.
+
+			@ingroup API
+			@param fd The file descriptor to wrap.
+
+			@returns
+				This function returns a pointer to a #hid_device object on
+				success or NULL on failure.
+		*/
+		HID_API_EXPORT hid_device * HID_API_CALL hid_open_fd(int fd);
+#endif
+
 		/** @brief Write an Output report to a HID device.
 
 			The first byte of @p data[] must contain the Report ID. For
@@ -247,6 +267,25 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length);
 
+		/** @brief Get a handle that can be waited on for input reports.
+
+			This lets a single thread wait on many devices at once instead
+			of blocking in hid_read() on each of them. On Linux this is the
+			hidraw file descriptor, which becomes readable (epoll/poll) when
+			a report is available. On Windows it is the event of the
+			overlapped read, a read is started if none is pending and the
+			event is signaled once it completes. In both cases the report
+			itself is then collected with hid_read_timeout().
+
+			@ingroup API
+			@param dev A device handle returned from hid_open().
+
+			@returns
+				This function returns the file descriptor or the event
+				HANDLE cast to intptr_t, or -1 on error.
+		*/
+		intptr_t HID_API_EXPORT HID_API_CALL hid_get_poll_handle(hid_device *dev);
+
 		/** @brief Set the device handle to be non-blocking.
 
 			In non-blocking mode calls to hid_read() will return
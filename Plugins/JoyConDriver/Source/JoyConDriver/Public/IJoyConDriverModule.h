@@ -4,8 +4,15 @@
 
 #include "Modules/ModuleManager.h"
 #include "IInputDeviceModule.h"
+#include "JoyConImuSample.h"
 #include "JoyConInformation.h"
 
+/** Fired on the game thread when an asynchronous attach finished, with the time the handshake took in seconds */
+DECLARE_DELEGATE_ThreeParams(FOnJoyConAttachComplete, int /*ControllerId*/, bool /*bSuccess*/, float /*AttachSeconds*/);
+
+/** Fired on the game thread when a Joy-Con appears on or disappears from the system, needs bUseDeviceMonitor */
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnJoyConDeviceChanged, const FJoyConInformation& /*Information*/, bool /*bArrived*/);
+
 /**
  * The public interface to this module.  In most cases, this interface is only public to sibling modules
  * within this plugin.
@@ -38,16 +45,23 @@ public:
 	 *
 	 * @return The number of Touch controllers that are active (but not necessarily tracked)
 	 */
-	virtual TArray<FJoyConInformation>* SearchForJoyCons() const = 0;
-	virtual TArray<FJoyConInformation>* GetAttachedJoyCons() const = 0;
-	virtual TArray<FJoyConInformation>* GetConnectedJoyCons() const = 0;
+	virtual void SearchForJoyCons(TArray<FJoyConInformation>& Out) const = 0;
+	virtual void GetAttachedJoyCons(TArray<FJoyConInformation>& Out) const = 0;
+	virtual void GetConnectedJoyCons(TArray<FJoyConInformation>& Out) const = 0;
+	virtual uint32 GetJoyConListVersion() const = 0;
 	virtual bool ResumeJoyConConnection() const = 0;
+	virtual FOnJoyConDeviceChanged& OnJoyConDeviceChanged() const = 0;
 	virtual bool ConnectJoyCon(FJoyConInformation JoyConInformation, bool UseImu, bool UseLocalize, float Alpha, int& ControllerId) const = 0;
 	virtual bool AttachJoyCon(int ControllerId, int GripIndex) const = 0;
+	virtual bool AttachJoyConAsync(int ControllerId, int GripIndex, FOnJoyConAttachComplete OnComplete) const = 0;
 	virtual bool DisconnectJoyCon(int ControllerId) const = 0;
 	virtual bool DetachJoyCon(int ControllerId) const = 0;
+	virtual bool GetJoyConRecoveryStats(int ControllerId, int& RecoveryCount, float& LastRecoverySeconds) const = 0;
+	virtual bool GetJoyConClockStats(int ControllerId, int& LostReports, int& DuplicateReports, float& TickPeriod) const = 0;
 	virtual bool GetJoyConAccelerometer(int ControllerId, FVector& Out) const = 0;
 	virtual bool GetJoyConGyroscope(int ControllerId, FVector& Out) const = 0;
+	virtual bool GetJoyConGyroBias(int ControllerId, FVector& Bias, float& Confidence) const = 0;
+	virtual bool DrainJoyConImuSamples(int ControllerId, TArray<FJoyConImuSample>& Out) const = 0;
 	virtual bool GetJoyConVector(int ControllerId, FRotator& Out) const = 0;
 	virtual bool ReCenterJoyCon(int ControllerId) const = 0;
 	virtual bool SetJoyConFilterCoefficient(int ControllerId, float Coefficient) const = 0;
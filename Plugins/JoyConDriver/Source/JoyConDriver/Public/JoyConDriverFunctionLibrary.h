@@ -4,10 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "JoyConGrip.h"
+#include "JoyConImuSample.h"
 #include "JoyConInformation.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "JoyConDriverFunctionLibrary.generated.h"
 
+DECLARE_DYNAMIC_DELEGATE_ThreeParams(FJoyConAttachCompleteDynamic, int, ControllerId, bool, Success, float, AttachSeconds);
+
 	/**
 	 *
 	 */
@@ -25,11 +28,23 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Attach"))
 		static void AttachJoyCon(int ControllerId, int GripIndex, bool& Success);
 
+	/** Runs the attach handshake on a worker thread, Success tells whether it was started and OnComplete fires when it finished */
+	UFUNCTION(BlueprintCallable, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Attach Async"))
+		static void AttachJoyConAsync(int ControllerId, int GripIndex, const FJoyConAttachCompleteDynamic& OnComplete, bool& Success);
+
 	UFUNCTION(BlueprintCallable, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Disconnect"))
 		static void DisconnectJoyCon(int ControllerId, bool& Success);
 	
 	UFUNCTION(BlueprintCallable, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Detach"))
 		static void DetachJoyCon(int ControllerId, bool& Success);
+
+	/** How often the controller was reconnected after a drop and how long the last reconnect took */
+	UFUNCTION(BlueprintPure, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Reconnect Recovery"))
+		static void GetJoyConRecoveryStats(int ControllerId, bool& Success, int& RecoveryCount, float& LastRecoverySeconds);
+
+	/** IMU reports the controller's timer shows as lost or repeated, and the fitted seconds per tick of that timer (nominally 0.005) */
+	UFUNCTION(BlueprintPure, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Clock Timer Lost Reports"))
+		static void GetJoyConClockStats(int ControllerId, bool& Success, int& LostReports, int& DuplicateReports, float& TickPeriod);
 	
 	UFUNCTION(BlueprintCallable, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Search"))
 		static void SearchForJoyCons(TArray<FJoyConInformation>& JoyCons);
@@ -40,12 +55,24 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Get Attached"))
 		static void GetConnectedJoyCons(TArray<FJoyConInformation>& JoyCons);
 
+	/** Changes whenever the lists above may have changed, poll this and only fetch a list when it differs */
+	UFUNCTION(BlueprintPure, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons List Version"))
+		static void GetJoyConListVersion(int& Version);
+
 	UFUNCTION(BlueprintPure, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Accelerometer"))
 		static void GetJoyConAccelerometer(int ControllerId, bool& Success, FVector& Accelerometer);
 
 	UFUNCTION(BlueprintPure, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Gyroscope"))
 		static void GetJoyConGyroscope(int ControllerId, bool& Success, FVector& Gyroscope);
 
+	/** Gyroscope bias in rad/s learned while the controller rested, already removed from the rates, and its confidence from 0 to 1 */
+	UFUNCTION(BlueprintPure, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons Gyroscope Bias Drift"))
+		static void GetJoyConGyroBias(int ControllerId, bool& Success, FVector& Bias, float& Confidence);
+
+	/** Every IMU sample received since the last call, at the full 200 Hz rate instead of one per frame */
+	UFUNCTION(BlueprintCallable, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons IMU Samples Gyroscope Accelerometer"))
+		static void DrainJoyConImuSamples(int ControllerId, bool& Success, TArray<FJoyConImuSample>& Samples);
+
 	UFUNCTION(BlueprintPure, Category = "JoyCon", meta = (Keywords = "Nintendo Switch Joy Con Cons JoyCon JoyCons IMU Vector"))
 		static void GetJoyConVector(int ControllerId, bool& Success, FRotator& Vector);
 	
@@ -21,7 +21,8 @@ struct FJoyConGrip {
 public:
 	FJoyConGrip();
 
-	bool ContainsController(FJoyConInformation JoyConInformation);
+	/** Controller ids are unique among connected controllers, so this compares ids only */
+	bool ContainsController(const FJoyConInformation& JoyConInformation) const;
 
 	/*
 	 * Device Info
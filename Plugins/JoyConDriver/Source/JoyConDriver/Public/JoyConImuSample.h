@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JoyConImuSample.generated.h"
+
+USTRUCT(BlueprintType)
+struct FJoyConImuSample {
+	GENERATED_USTRUCT_BODY()
+
+public:
+	FJoyConImuSample() : Timestamp(0.0f), HostTime(0.0f), Accelerometer(FVector::ZeroVector), Gyroscope(FVector::ZeroVector) {}
+
+	/** Device time in seconds since the controller's first report, consecutive samples are 5 ms apart */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		float Timestamp;
+
+	/** Host time the sample was taken at in seconds since engine start, fitted from the report arrival times */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		float HostTime;
+
+	/** Acceleration in g */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		FVector Accelerometer;
+
+	/** Angular velocity in rad/s */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		FVector Gyroscope;
+};
@@ -90,6 +90,15 @@ struct FJoyConKey {
 	static const FKey JoyCon_Left_ThumbStick_Y;
 	static const FKey JoyCon_Right_ThumbStick_X;
 	static const FKey JoyCon_Right_ThumbStick_Y;
+
+	/** Motion gesture keys, pressed and released on the frame the gesture is recognized */
+	static const FKey JoyCon_Swing;
+	static const FKey JoyCon_Shake;
+	static const FKey JoyCon_Flick_Up;
+	static const FKey JoyCon_Flick_Down;
+	static const FKey JoyCon_Flick_Left;
+	static const FKey JoyCon_Flick_Right;
+	static const FKey JoyCon_Gesture_Magnitude;
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -133,6 +142,15 @@ struct FJoyConKeyNames {
 	static const FName JoyCon_Left_ThumbStick_Y;
 	static const FName JoyCon_Right_ThumbStick_X;
 	static const FName JoyCon_Right_ThumbStick_Y;
+
+	/** Motion gesture keys, pressed and released on the frame the gesture is recognized */
+	static const FName JoyCon_Swing;
+	static const FName JoyCon_Shake;
+	static const FName JoyCon_Flick_Up;
+	static const FName JoyCon_Flick_Down;
+	static const FName JoyCon_Flick_Left;
+	static const FName JoyCon_Flick_Right;
+	static const FName JoyCon_Gesture_Magnitude;
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -175,8 +193,10 @@ struct FJoyConControllerState {
 	FJoyConButtonState Buttons[static_cast<int32>(EJoyConControllerButton::TotalButtonCount)];
 	/** Analog stick state */
 	FJoyConAnalogState Stick;
+	/** Value last sent on JoyCon_Gesture_Magnitude */
+	float GestureMagnitude;
 
-	FJoyConControllerState() {
+	FJoyConControllerState() : GestureMagnitude(0.0f) {
 		for (FJoyConButtonState& Button : Buttons) {
 			Button.bIsPressed = false;
 			Button.NextRepeatTime = 0.0;